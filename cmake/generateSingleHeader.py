@@ -136,13 +136,28 @@ if __name__ == "__main__":
 
     includes = [
       "FileTypes"
+    , "Parallel"
+    , "Validation"
+    , "FacetRepair"
     , "Mesh"
+    , "MeshSink"
+    , "MeshBuilder"
     , "Reader"
+    , "NumberParser"
+    , "StructuralIndex"
+    , "MappedFile"
+    , "FileStream"
+    , "Items"
     , "Lexer"
     , "ASSIMPReader"
     , "BuiltInReader"
     , "CADMeshTemplate"
     , "Exceptions"
+    , "BoundingVolumeHierarchy"
+    , "Decimation"
+    , "DistanceField"
+    , "BVHSolid"
+    , "CoplanarMerge"
     , "TessellatedMesh"
     , "TetrahedralMesh"
     ]
@@ -154,11 +169,23 @@ if __name__ == "__main__":
 
     sources = [
       "FileTypes"
+    , "FacetRepair"
     , "Mesh"
+    , "MeshBuilder"
     , "Reader"
+    , "NumberParser"
+    , "StructuralIndex"
+    , "MappedFile"
+    , "FileStream"
+    , "Items"
     , "Lexer"
     , "CADMeshTemplate"
     , "Exceptions"
+    , "BoundingVolumeHierarchy"
+    , "Decimation"
+    , "DistanceField"
+    , "BVHSolid"
+    , "CoplanarMerge"
     , "TessellatedMesh"
     , "TetrahedralMesh"
     ]
@@ -200,7 +227,7 @@ if __name__ == "__main__":
     header = stripComments(header)
     header = stripMacros(header)
 
-    header = stripLocalIncludes(header, sources + readers + excludes)
+    header = stripLocalIncludes(header, includes + sources + readers + excludes)
     
     header = gatherIncludes(header)
   
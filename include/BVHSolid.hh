@@ -0,0 +1,140 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2011-2020 Christopher M. Poole <mail@christopherpoole.net>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+// CADMesh //
+#include "BoundingVolumeHierarchy.hh"
+#include "DistanceField.hh"
+
+// GEANT4 //
+#include "G4VSolid.hh"
+#include "G4String.hh"
+#include "G4ThreeVector.hh"
+
+// STL //
+#include <atomic>
+#include <memory>
+#include <vector>
+
+
+namespace CADMesh
+{
+
+// A closed triangle mesh as a solid, navigated through a bounding volume
+// hierarchy over its triangles rather than voxels of G4VFacets. It answers
+// the same questions as a G4TessellatedSolid of the same triangles, within
+// kCarTolerance, with the triangles facing out.
+class BVHSolid : public G4VSolid
+{
+  public:
+    BVHSolid( G4String name
+            , const Points& points
+            , const Indices& indices
+            , size_t threads = 1);
+
+    // The hierarchy should be padded by kCarTolerance.
+    BVHSolid( G4String name
+            , std::shared_ptr<const BoundingVolumeHierarchy> hierarchy);
+
+    // Copies share the hierarchy.
+    BVHSolid(const BVHSolid& other) = default;
+
+  public:
+    EInside Inside(const G4ThreeVector& p) const;
+
+    G4ThreeVector SurfaceNormal(const G4ThreeVector& p) const;
+
+    G4double DistanceToIn(const G4ThreeVector& p, const G4ThreeVector& v) const;
+    G4double DistanceToIn(const G4ThreeVector& p) const;
+
+    G4double DistanceToOut( const G4ThreeVector& p
+                          , const G4ThreeVector& v
+                          , const G4bool calcNorm = false
+                          , G4bool* validNorm = 0
+                          , G4ThreeVector* n = 0) const;
+
+    G4double DistanceToOut(const G4ThreeVector& p) const;
+
+    void BoundingLimits(G4ThreeVector& pMin, G4ThreeVector& pMax) const;
+
+    G4bool CalculateExtent( const EAxis pAxis
+                          , const G4VoxelLimits& pVoxelLimit
+                          , const G4AffineTransform& pTransform
+                          , G4double& pMin
+                          , G4double& pMax) const;
+
+    G4String GetEntityType() const;
+    std::ostream& StreamInfo(std::ostream& os) const;
+
+    void DescribeYourselfTo(G4VGraphicsScene& scene) const;
+    G4Polyhedron* CreatePolyhedron() const;
+
+    G4VSolid* Clone() const;
+
+    G4double GetCubicVolume();
+    G4double GetSurfaceArea();
+    G4ThreeVector GetPointOnSurface() const;
+
+  public:
+    std::shared_ptr<const BoundingVolumeHierarchy> GetHierarchy() const {
+        return this->hierarchy_;
+    };
+
+    // With a distance field, safety distances away from the surface are
+    // looked up rather than searched for, and so is which side of it a
+    // point is on. Set it before navigating. The field must have been built
+    // around this solid's triangles.
+    void SetDistanceField(std::shared_ptr<const DistanceField> distance_field);
+
+    std::shared_ptr<const DistanceField> GetDistanceField() const {
+        return this->distance_field_;
+    };
+
+    // How many safety distances, from this solid and its copies, could not
+    // be looked up in the distance field and were searched for, to judge
+    // the cell size by.
+    size_t GetNumberOfSearches() const {
+        return this->searches_->load(std::memory_order_relaxed);
+    };
+
+  private:
+    // The distance from p to the surface, or zero within half of
+    // kCarTolerance of it, and which side of the surface p is on, from at
+    // most one search for the nearest triangle.
+    G4double Safety(const G4ThreeVector& p, EInside& side) const;
+
+  private:
+    std::shared_ptr<const BoundingVolumeHierarchy> hierarchy_;
+    std::shared_ptr<const DistanceField> distance_field_;
+
+    G4double cubic_volume_ = 0;
+    G4double surface_area_ = 0;
+
+    // The running total of the triangle areas, to pick surface points by.
+    std::shared_ptr<const std::vector<G4double> > areas_;
+
+    std::shared_ptr<std::atomic<size_t> > searches_ = std::make_shared<std::atomic<size_t> >(0);
+};
+
+} // CADMesh namespace
+
@@ -0,0 +1,225 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2011-2020 Christopher M. Poole <mail@christopherpoole.net>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+// CADMesh //
+#include "Mesh.hh"
+
+// GEANT4 //
+#include "globals.hh"
+#include "geomdefs.hh"
+#include "G4ThreeVector.hh"
+
+// STL //
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+
+namespace CADMesh
+{
+
+// A bounding volume hierarchy over the triangles of a mesh, split by the
+// surface area heuristic and built on several threads. The triangles are
+// kept as shared points and indices, in the order of the leaves, and again
+// as a corner and two edges each, so the ray test can take four triangles
+// at a time with AVX when the processor has it, chosen at runtime.
+class BoundingVolumeHierarchy
+{
+  public:
+    enum Kernel
+    {
+        Scalar,
+        AVX
+    };
+
+    // Which way round a triangle must be to a ray to be hit. A triangle
+    // faces the way its corners turn anticlockwise.
+    enum Facing
+    {
+        Either,
+        Against,
+        Along
+    };
+
+    // Node bounds are grown by the padding, so that rays and points within
+    // it of a triangle are not missed by rounding.
+    BoundingVolumeHierarchy( const Points& points
+                           , const Indices& indices
+                           , G4double padding = 0
+                           , size_t threads = 1
+                           , Kernel kernel = Best());
+
+  public:
+    static const size_t none = std::numeric_limits<size_t>::max();
+
+    struct Hit
+    {
+        G4double distance = kInfinity;
+        size_t triangle = none;
+    };
+
+    struct Nearest
+    {
+        G4double distance_squared = kInfinity;
+        size_t triangle = none;
+
+        // The closest point, and whether it is inside the face of the
+        // triangle rather than on one of its edges or corners.
+        G4ThreeVector point;
+        G4bool on_face = false;
+    };
+
+    // The nearest crossing of the ray at a distance of at least from, which
+    // may be negative, through a triangle facing the given way. The
+    // direction should be a unit vector.
+    Hit Intersect( const G4ThreeVector& origin
+                 , const G4ThreeVector& direction
+                 , G4double from = 0
+                 , Facing facing = Either) const;
+
+    // Counts the crossings of the ray ahead of its origin. A crossing too
+    // near an edge, or too glancing, to be sure of marks the count ambiguous.
+    size_t Crossings( const G4ThreeVector& origin
+                    , const G4ThreeVector& direction
+                    , G4bool& ambiguous) const;
+
+    // The triangle nearest the point, if any are nearer than within.
+    Nearest Closest( const G4ThreeVector& point
+                   , G4double within = kInfinity) const;
+
+    // Whether the point is inside the closed surface, given the triangle
+    // nearest to it. Only meaningful away from the surface.
+    G4bool Contains( const G4ThreeVector& point
+                   , const Nearest& nearest) const;
+
+    // The closest point to the point of the triangle with a corner at a
+    // and edges ab and ac from it, and whether it is inside its face.
+    static G4ThreeVector ClosestPoint( const G4ThreeVector& point
+                                     , const G4ThreeVector& a
+                                     , const G4ThreeVector& ab
+                                     , const G4ThreeVector& ac
+                                     , G4bool& on_face);
+
+  public:
+    size_t GetNumberOfTriangles() const;
+    size_t GetNumberOfNodes() const;
+
+    const Points& GetPoints() const;
+    const Indices& GetIndices() const;
+
+    G4ThreeVector GetCorner(size_t triangle, size_t corner) const;
+    G4ThreeVector GetNormal(size_t triangle) const;
+
+    G4ThreeVector GetMinimum() const;
+    G4ThreeVector GetMaximum() const;
+
+    // The bytes held for the points, triangles and nodes.
+    size_t GetMemoryUsed() const;
+
+    static Kernel Best();
+    static bool IsSupported(Kernel kernel);
+    static std::string KernelName(Kernel kernel);
+
+  private:
+    struct Node
+    {
+        G4double minimum[3];
+        G4double maximum[3];
+
+        // Leaves hold count triangles from first. Others have count zero,
+        // and their children are at first and first + 1.
+        uint32_t first;
+        uint32_t count;
+    };
+
+    // The bounds and centre of one triangle, while building.
+    struct Bounds
+    {
+        G4double minimum[3];
+        G4double maximum[3];
+        G4double centre[3];
+    };
+
+    void Build(size_t threads);
+
+    // Fits a node around its triangles.
+    static void Fit( Node& node
+                   , const std::vector<Bounds>& bounds
+                   , const std::vector<uint32_t>& order);
+
+    // Splits the triangles of a node in two, adding its children to nodes,
+    // or leaves it as a leaf. Returns whether it was split.
+    static G4bool Split( std::vector<Node>& nodes
+                       , size_t node
+                       , size_t depth
+                       , const std::vector<Bounds>& bounds
+                       , std::vector<uint32_t>& order);
+
+    // How far along the ray it enters the node, between from and to, or
+    // kInfinity if it misses.
+    static G4double Entry( const Node& node
+                         , const G4double origin[3]
+                         , const G4double direction[3]
+                         , const G4double inverse[3]
+                         , G4double from
+                         , G4double to);
+
+    static G4double DistanceSquared(const Node& node, const G4double point[3]);
+
+    // Tests the ray against four triangles from first, of which count are
+    // real, setting each lane of distances to the crossing or to kInfinity.
+    static void IntersectScalar( const BoundingVolumeHierarchy& tree
+                               , size_t first
+                               , size_t count
+                               , const G4double origin[3]
+                               , const G4double direction[3]
+                               , G4double distances[4]
+                               , Facing facing);
+
+    static void IntersectAVX( const BoundingVolumeHierarchy& tree
+                            , size_t first
+                            , size_t count
+                            , const G4double origin[3]
+                            , const G4double direction[3]
+                            , G4double distances[4]
+                            , Facing facing);
+
+  private:
+    Points points_;
+    Indices indices_;
+
+    // A corner and the two edges from it, for each triangle.
+    std::vector<G4double> corner_[3];
+    std::vector<G4double> first_edge_[3];
+    std::vector<G4double> second_edge_[3];
+
+    std::vector<Node> nodes_;
+
+    G4double padding_ = 0;
+    Kernel kernel_ = Scalar;
+};
+
+} // CADMesh namespace
+
@@ -41,6 +41,11 @@ class BuiltInReader : public Reader
   public:
     G4bool Read(G4String filepath);
     G4bool CanRead(File::Type file_type);
+
+    G4bool Stream(G4String filepath, MeshSink& sink);
+
+  private:
+    std::shared_ptr<Reader> ReaderFor(G4String filepath);
 };
 
 std::shared_ptr<BuiltInReader> BuiltIn();
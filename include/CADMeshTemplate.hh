@@ -41,6 +41,7 @@
 #include "G4LogicalVolume.hh"
 //#include "G4SystemOfUnits.hh"
 #include "G4UIcommand.hh"
+#include "G4ios.hh"
 
 
 namespace CADMesh
@@ -97,9 +98,32 @@ class CADMeshTemplate
 
     virtual G4AssemblyVolume* GetAssembly() = 0;
 
+    // Every mesh read is checked, not only the first.
     bool IsValidForNavigation();
     // TODO: Add method with same arguments as GetSolid.
 
+    Validations Validate();
+
+    // Sorts the triangles of every mesh read along a space filling curve,
+    // see Mesh::Reorder, so that the facets of the solids built after are
+    // added in that order.
+    void Reorder();
+
+    // Repairs the degenerate facets of every mesh read, in place, see
+    // Mesh::RepairDegenerateFacets. The minimum area is in the units of the
+    // solids, at the scale set now, and facets are held to the surface
+    // tolerance of Geant4 at that scale too. Zero is no limit. Returns how
+    // many facets could not be repaired.
+    size_t RepairDegenerateFacets( G4double minimum_area = 0
+                                 , G4double maximum_aspect_ratio = 0);
+
+    // Simplifies every mesh read, in place, see Mesh::Decimate. The target
+    // number of triangles is shared between the meshes by how many each
+    // has, and the maximum deviation is in the units of the solids, at the
+    // scale set now. Zero is no limit. Returns an upper bound on how far
+    // any surface moved, in the same units.
+    G4double Decimate(size_t target, G4double maximum_deviation = 0);
+
   public:
     G4String GetFileName();
 
@@ -115,6 +139,11 @@ class CADMeshTemplate
     void SetOffset(G4ThreeVector offset);
     G4ThreeVector GetOffset();
 
+  protected:
+    // Called when the scale or offset changes, so that anything built with
+    // the old ones can be dropped.
+    virtual void InvalidateSolids() { };
+
   protected:
     G4String file_name_;
     File::Type file_type_;
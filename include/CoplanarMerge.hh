@@ -0,0 +1,104 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2011-2020 Christopher M. Poole <mail@christopherpoole.net>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+// CADMesh //
+#include "Mesh.hh"
+
+// GEANT4 //
+#include "globals.hh"
+#include "G4ThreeVector.hh"
+
+// STL //
+#include <vector>
+
+
+namespace CADMesh
+{
+
+// Merges the coplanar triangles of a mesh into fewer facets. Points in the
+// middle of regions flat to within the tolerance are removed, and the hole
+// each leaves is triangulated again from the points around it, two
+// triangles fewer each time. Then pairs of triangles in the same plane
+// that make a convex quadrangle are paired, longest shared edge first, to
+// be built as G4QuadrangularFacets. Points on the edges of flat regions
+// are never moved or removed, so neighbouring regions still meet, and the
+// surface moves by no more than the tolerance.
+//
+// The facets left index the points given.
+class CoplanarMerge
+{
+  public:
+    CoplanarMerge( const Points& points
+                 , const Indices& indices
+                 , G4double tolerance
+                 , size_t threads = 1);
+
+  public:
+    // Three indices for each triangle left.
+    const Indices& GetTriangles() const;
+
+    // Four indices for each quadrangle, in order around it.
+    const Indices& GetQuadrangles() const;
+
+    size_t GetNumberOfFacetsBefore() const;
+    size_t GetNumberOfFacets() const;
+
+    size_t GetNumberOfTriangles() const;
+    size_t GetNumberOfQuadrangles() const;
+    size_t GetNumberOfPointsRemoved() const;
+
+  private:
+    void RemovePlanarPoints(size_t threads);
+    void PairTriangles(size_t threads);
+
+    // The points around a point, in order, if its triangles make a single
+    // fan around it that is flat to within the tolerance.
+    G4bool FlatRing(uint32_t point, std::vector<uint32_t>& ring) const;
+
+    // Triangulates the ring of points left by removing a point, if it can
+    // be done without adding an edge that is already in the mesh.
+    G4bool Triangulate( uint32_t point
+                      , const std::vector<uint32_t>& ring
+                      , Indices& triangles) const;
+
+    G4bool HasEdge(uint32_t a, uint32_t b, uint32_t removed) const;
+
+  private:
+    G4double tolerance_;
+
+    Points points_;
+    Indices triangles_;
+    Indices quadrangles_;
+
+    // The triangles each point is a corner of, and those replaced, while
+    // removing points.
+    std::vector<std::vector<uint32_t> > corners_of_;
+    std::vector<char> replaced_;
+
+    size_t number_of_facets_before_ = 0;
+    size_t number_of_points_removed_ = 0;
+};
+
+} // CADMesh namespace
+
@@ -0,0 +1,170 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2011-2020 Christopher M. Poole <mail@christopherpoole.net>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+// CADMesh //
+#include "Mesh.hh"
+#include "BoundingVolumeHierarchy.hh"
+
+// GEANT4 //
+#include "globals.hh"
+#include "G4ThreeVector.hh"
+
+// STL //
+#include <memory>
+#include <vector>
+
+
+namespace CADMesh
+{
+
+// Simplifies a closed mesh by collapsing edges, cheapest first, as costed
+// by the quadric error metric of Garland and Heckbert. Collapses that
+// would change the topology of the surface, fold it over, or leave a sliver
+// are not made, and points on boundary or non-manifold edges are kept, so
+// a mesh valid for navigation stays valid.
+//
+// The bounding box is cut into blocks of points, and the edges within each
+// block are collapsed on several threads before those between them. The
+// blocks depend only on the mesh, so the result is the same for any number
+// of threads.
+//
+// Afterwards, an upper bound on the Hausdorff distance between the two
+// surfaces is found. If it is more than the maximum deviation, edges are
+// collapsed again from the start, more carefully, until it is not.
+class Decimation
+{
+  public:
+    // Collapses edges until there are at most target triangles left, or no
+    // more can be collapsed without moving the surface further than the
+    // maximum deviation. Either being zero is no limit.
+    Decimation( const Points& points
+              , const Indices& indices
+              , size_t target
+              , G4double maximum_deviation = 0
+              , size_t threads = 1);
+
+  public:
+    // The points that are left, and three indices for each triangle.
+    const Points& GetPoints() const;
+    const Indices& GetIndices() const;
+
+    size_t GetNumberOfFacetsBefore() const;
+    size_t GetNumberOfFacets() const;
+
+    // No point of either surface is further than this from the other.
+    G4double GetHausdorffDistance() const;
+
+  private:
+    // The sum of the squared distances to the planes of a point's
+    // triangles, as the upper half of a symmetric 3 by 3 matrix, a vector
+    // and a constant.
+    struct Quadric
+    {
+        G4double xx = 0, xy = 0, xz = 0, yy = 0, yz = 0, zz = 0;
+        G4double x = 0, y = 0, z = 0;
+        G4double c = 0;
+
+        void Add(const Quadric& other);
+        G4double Error(const G4ThreeVector& point) const;
+    };
+
+    struct Candidate
+    {
+        G4double cost;
+        uint32_t from;
+        uint32_t to;
+        uint32_t from_version;
+        uint32_t to_version;
+        G4ThreeVector position;
+
+        // The cheapest is at the top of a std::priority_queue.
+        bool operator<(const Candidate& other) const;
+    };
+
+    void Start();
+
+    // Collapses the edges between the points given, cheapest first, until
+    // removed triangles have gone. Only those with every neighbour in the
+    // block are collapsed, unless it is everywhere.
+    void Collapse( const std::vector<uint32_t>& points
+                 , uint32_t block
+                 , G4bool everywhere
+                 , size_t removed
+                 , G4double limit);
+
+    G4bool Cost(uint32_t from, uint32_t to, Candidate& candidate) const;
+
+    G4bool CanCollapse( const Candidate& candidate
+                      , uint32_t block
+                      , G4bool everywhere
+                      , G4double limit) const;
+
+    void Apply(const Candidate& candidate, G4double limit);
+
+    // The points around a point, sorted.
+    void Neighbours(uint32_t point, std::vector<uint32_t>& neighbours) const;
+
+    // Whether the triangles around a point make a single fan.
+    G4bool IsDisk(uint32_t point) const;
+
+    // An upper bound on the Hausdorff distance of the surface from the one
+    // it started as.
+    G4double Bound(size_t threads) const;
+
+    void Finish();
+
+  private:
+    Points original_points_;
+    Indices original_indices_;
+
+    size_t target_;
+    G4double maximum_deviation_;
+    size_t threads_;
+
+    Points points_;
+    Indices triangles_;
+
+    std::vector<char> alive_;
+    std::vector<char> removed_;
+    std::vector<char> frozen_;
+    std::vector<uint32_t> version_;
+    std::vector<uint32_t> block_;
+    std::vector<Quadric> quadrics_;
+
+    // The triangles around each point.
+    std::vector<std::vector<uint32_t> > around_;
+
+    // The original surface, and the samples of it nearest each triangle
+    // when there is a maximum deviation to keep to.
+    std::shared_ptr<BoundingVolumeHierarchy> surface_;
+
+    Points samples_;
+    std::vector<std::vector<uint32_t> > owned_;
+
+    size_t number_of_triangles_ = 0;
+    G4double hausdorff_distance_ = 0;
+};
+
+} // CADMesh namespace
+
@@ -0,0 +1,141 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2011-2020 Christopher M. Poole <mail@christopherpoole.net>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+// CADMesh //
+#include "BoundingVolumeHierarchy.hh"
+
+// GEANT4 //
+#include "globals.hh"
+#include "G4String.hh"
+#include "G4ThreeVector.hh"
+
+// STL //
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+
+namespace CADMesh
+{
+
+// A signed distance field around a closed mesh, for answering safety
+// distances without searching its triangles.
+//
+// Space around the mesh is split into cubic cells. Each cell keeps the
+// signed distance from its centre to the surface, negative inside. Cells
+// the surface may be near also keep a brick of resolution^3 voxels, with
+// the signed distance at each of their corners. Away from the surface a
+// cell's centre gives a lower bound on the distance anywhere in it, and
+// near it the corners of a voxel do, since the distance changes no faster
+// than the point moves. A point within the bound of a corner is on the
+// same side as it. Values are rounded towards zero, so the bound never
+// overestimates. Within a voxel of the surface there is no useful bound,
+// and the distance should be found exactly.
+class DistanceField
+{
+  public:
+    DistanceField( const BoundingVolumeHierarchy& hierarchy
+                 , G4double cell_size
+                 , size_t resolution = 4
+                 , size_t threads = 1);
+
+  public:
+    // A lower bound on the distance from the point to the surface, or a
+    // negative number if the point is too near the surface for one.
+    G4double Safety(const G4ThreeVector& point) const;
+
+    // One if the point is outside the surface, minus one if it is inside,
+    // and zero if it is too near the surface to tell.
+    G4int Side(const G4ThreeVector& point) const;
+
+    // Whether the field was built around this hierarchy's triangles, by a
+    // hash of their points and indices.
+    G4bool IsFor(const BoundingVolumeHierarchy& hierarchy) const;
+
+  public:
+    // The field is written in the byte order of this machine, and can be
+    // read back on another run instead of being built again.
+    void Write(std::ostream& stream) const;
+    void Save(G4String filepath) const;
+
+    static std::shared_ptr<DistanceField> Read(std::istream& stream);
+    static std::shared_ptr<DistanceField> Load(G4String filepath);
+
+  public:
+    G4double GetCellSize() const;
+    size_t GetResolution() const;
+
+    size_t GetNumberOfCells() const;
+    size_t GetNumberOfBricks() const;
+
+    // The bytes held for the cells and bricks.
+    size_t GetMemoryUsed() const;
+
+  private:
+    DistanceField() = default;
+
+    // Finds the cell the point is in, if it is in the field.
+    G4bool Cell(const G4ThreeVector& point, size_t& cell) const;
+    G4ThreeVector Corner(size_t cell) const;
+
+    // The best lower bound the corners of the point's voxel give on its
+    // distance to the surface, in a cell with a brick, and the side of the
+    // corner that gives it.
+    G4double Bound(const G4ThreeVector& point, size_t cell, G4int& side) const;
+
+    // Starts every field written, with the version of its format.
+    static const char* Tag() {
+        return "CADMesh DistanceField 3";
+    };
+
+    // A 64 bit FNV-1a hash of the coordinates of every point and of every
+    // index of the hierarchy's triangles.
+    static uint64_t Hash(const BoundingVolumeHierarchy& hierarchy);
+
+    // Rounds towards zero, so a distance is never made larger.
+    static float Lower(G4double distance);
+
+  private:
+    static const uint32_t none = 0xffffffff;
+
+    G4ThreeVector origin_;
+    G4double cell_size_ = 0;
+
+    uint32_t dimensions_[3] = { 0, 0, 0 };
+    uint32_t resolution_ = 0;
+
+    // The mesh the field was built around.
+    uint64_t number_of_triangles_ = 0;
+    uint64_t mesh_hash_ = 0;
+    G4ThreeVector minimum_;
+    G4ThreeVector maximum_;
+
+    std::vector<float> centres_;
+    std::vector<uint32_t> bricks_;
+    std::vector<float> samples_;
+};
+
+} // CADMesh namespace
+
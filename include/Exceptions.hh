@@ -47,6 +47,10 @@ void ReaderCantReadError(G4String origin, File::Type file_type, G4String filepat
 void MeshNotFound(G4String origin, size_t index);
 void MeshNotFound(G4String origin, G4String name);
 
+void InvalidMesh(G4String origin, G4String message);
+
+void InvalidDistanceField(G4String origin, G4String message);
+
 } // Exceptions namespace
 
 } // CADMesh namespace
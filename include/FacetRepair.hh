@@ -0,0 +1,134 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2011-2020 Christopher M. Poole <mail@christopherpoole.net>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#pragma once
+
+// GEANT4 //
+#include "globals.hh"
+#include "G4ThreeVector.hh"
+
+// STL //
+#include <cstdint>
+#include <vector>
+
+
+namespace CADMesh
+{
+
+// Repairs the facets of a mesh that Geant4 would refuse, or that are too
+// small or too thin to navigate well, in place. A facet is degenerate if an
+// edge or its height is no longer than the tolerance, as G4TriangularFacet
+// tests, if its area is no more than the minimum area, or if its longest
+// edge is more than the maximum aspect ratio times its height. Zero is no
+// limit for either of the last two.
+//
+// A facet with a short edge is repaired by collapsing that edge to its
+// middle, and one with a point near its longest edge by flipping that edge
+// with the facet on the other side, so that the point splits it. Facets
+// that use a point twice are removed. Each keeps every other edge shared by
+// the same two facets, so a closed mesh stays closed. Those that can't be
+// repaired without folding the surface or joining it to itself are left.
+//
+// Finding the degenerate facets is one pass over the mesh, without
+// branches, on several threads. Only the facets found are repaired, so most
+// meshes cost that pass alone.
+class FacetRepair
+{
+  public:
+    // Three indices into the points for each triangle.
+    FacetRepair( std::vector<G4double>& x
+               , std::vector<G4double>& y
+               , std::vector<G4double>& z
+               , std::vector<uint32_t>& indices
+               , G4double tolerance
+               , G4double minimum_area = 0
+               , G4double maximum_aspect_ratio = 0
+               , size_t threads = 1);
+
+  public:
+    size_t GetNumberOfFacetsBefore() const;
+    size_t GetNumberOfFacets() const;
+
+    // Found before repairing.
+    size_t GetNumberOfDegenerateFacets() const;
+
+    size_t GetNumberOfCollapsedEdges() const;
+    size_t GetNumberOfFlippedEdges() const;
+    size_t GetNumberOfRemovedFacets() const;
+
+    // Still degenerate after repairing.
+    size_t GetNumberOfRemainingFacets() const;
+
+  private:
+    // The degenerate facets, in order.
+    std::vector<uint32_t> Find() const;
+
+    G4bool IsDegenerate(uint32_t facet) const;
+
+    // Flags each degenerate facet from begin to end, in a loop with no
+    // branches that can be vectorised.
+    void Classify(size_t begin, size_t end, unsigned char* flags) const;
+
+    G4ThreeVector GetPoint(uint32_t point) const;
+
+    // Repairs a facet, adding those changed to touched.
+    G4bool Repair(uint32_t facet, std::vector<uint32_t>& touched);
+
+    // Collapses the edge from a corner of a facet to the next.
+    G4bool Collapse(uint32_t facet, size_t corner, std::vector<uint32_t>& touched);
+
+    // Flips the edge from a corner of a facet to the next.
+    G4bool Flip(uint32_t facet, size_t corner, std::vector<uint32_t>& touched);
+
+    void Remove(uint32_t facet);
+
+    // The points joined to a point by an edge, sorted.
+    void Neighbours(uint32_t point, std::vector<uint32_t>& neighbours) const;
+
+    void Finish();
+
+  private:
+    std::vector<G4double>& x_;
+    std::vector<G4double>& y_;
+    std::vector<G4double>& z_;
+    std::vector<uint32_t>& indices_;
+
+    G4double tolerance_;
+    G4double minimum_area_;
+    G4double maximum_aspect_ratio_;
+    size_t threads_;
+
+    std::vector<char> alive_;
+
+    // The facets around each point.
+    std::vector<std::vector<uint32_t> > around_;
+
+    size_t number_of_facets_before_ = 0;
+    size_t number_of_facets_ = 0;
+    size_t number_of_degenerate_facets_ = 0;
+    size_t number_of_collapsed_edges_ = 0;
+    size_t number_of_flipped_edges_ = 0;
+    size_t number_of_removed_facets_ = 0;
+    size_t number_of_remaining_facets_ = 0;
+};
+
+} // CADMesh namespace
+
@@ -0,0 +1,86 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2011-2020 Christopher M. Poole <mail@christopherpoole.net>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+// STL //
+#include <fstream>
+#include <string>
+#include <vector>
+
+
+namespace CADMesh
+{
+
+namespace File
+{
+
+// Reads a file front to back through a buffer of a fixed size, for files too
+// large to hold in memory at once. Lines and records are handed out as views
+// into the buffer, which are valid until the next call. The buffer only grows
+// past the chunk size to hold a single line or record that is longer.
+class FileStream
+{
+  public:
+    FileStream(std::string filepath, size_t chunk_size = 1 << 20);
+
+    FileStream(const FileStream&) = delete;
+    FileStream& operator=(const FileStream&) = delete;
+
+  public:
+    bool IsOpen();
+
+    // The size of the whole file in bytes.
+    size_t Size();
+
+    // The next line without its line break, or false at the end of the file.
+    bool NextLine(const char*& begin, const char*& end);
+
+    // The next size bytes, or null if the file ends first. Peek leaves them
+    // to be read again.
+    const unsigned char* Read(size_t size);
+    const unsigned char* Peek(size_t size);
+
+    // The number of the line last returned by NextLine, starting at one.
+    size_t LineNumber();
+
+  private:
+    // Makes sure at least size bytes are buffered, if the file has them.
+    bool Fill(size_t size);
+
+  private:
+    std::ifstream file_;
+    size_t size_ = 0;
+
+    std::vector<char> buffer_;
+    size_t chunk_size_ = 0;
+
+    size_t begin_ = 0;
+    size_t end_ = 0;
+
+    size_t line_number_ = 0;
+};
+
+} // File namespace
+
+} // CADMesh namespace
+
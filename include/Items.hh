@@ -0,0 +1,163 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2011-2020 Christopher M. Poole <mail@christopherpoole.net>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#pragma once
+
+// CADMesh //
+#include "MappedFile.hh"
+
+// STL //
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+namespace CADMesh
+{
+
+namespace File
+{
+
+
+struct Token 
+{
+    Token(std::string name) : id(Register(name)) {};
+
+    std::string Name() const { return Names()[id]; };
+
+    bool operator==(Token other) const { return id == other.id; };
+    bool operator!=(Token other) const { return id != other.id; };
+
+    // Tokens with the same name share an id, in every translation unit.
+    static uint32_t Register(std::string name)
+    {
+        auto& names = Names();
+
+        for (size_t i = 0; i < names.size(); i++)
+        {
+            if (names[i] == name)
+                return (uint32_t) i;
+        }
+
+        names.push_back(name);
+        return (uint32_t) (names.size() - 1);
+    };
+
+    static std::vector<std::string>& Names()
+    {
+        static std::vector<std::string> names;
+        return names;
+    };
+
+    uint32_t id;
+};
+
+
+// Marks a missing parent, child or sibling.
+static const uint32_t NoItem = 0xffffffff;
+
+
+// A token in the flat item arena. The value of the token is the span
+// [position, position + length) of the input, and the tree structure is kept
+// as indices into the arena.
+struct Item
+{
+    size_t      position;
+
+    Token       token;
+    uint32_t    length;
+
+    uint32_t    parent;
+    uint32_t    first_child;
+    uint32_t    last_child;
+    uint32_t    next_sibling;
+};
+
+
+class Items
+{
+  public:
+    Items(std::shared_ptr<MappedFile> file);
+
+  public:
+    // Iterates over the indices of the children of one item.
+    class Children
+    {
+      public:
+        class Iterator
+        {
+          public:
+            Iterator(Items* items, uint32_t index) : items_(items), index_(index) {};
+
+            size_t operator*() { return index_; };
+            bool operator!=(const Iterator& other) { return index_ != other.index_; };
+
+            Iterator& operator++()
+            {
+                index_ = (*items_)[index_].next_sibling;
+                return *this;
+            };
+
+          private:
+            Items* items_;
+            uint32_t index_;
+        };
+
+        Children(Items* items, uint32_t first) : items_(items), first_(first) {};
+
+        Iterator begin() { return Iterator(items_, first_); };
+        Iterator end() { return Iterator(items_, NoItem); };
+
+      private:
+        Items* items_;
+        uint32_t first_;
+    };
+
+  public:
+    size_t Add(Token token, size_t position, size_t length, size_t parent);
+
+    Item& operator[](size_t index);
+    size_t Size();
+
+    Children ChildrenOf(size_t index);
+    size_t NumberOfChildren(size_t index);
+    bool HasChildren(size_t index);
+
+    std::string Value(size_t index);
+    double DoubleValue(size_t index);
+    long IntegerValue(size_t index);
+
+    size_t LineNumber(size_t index);
+
+  private:
+    std::shared_ptr<MappedFile> file_;
+
+    std::vector<Item> items_;
+};
+
+
+} // File namespace
+
+} // CADMesh namespace
+
@@ -23,8 +23,13 @@
 #pragma once
 
 
+// CADMesh //
+#include "Items.hh"
+#include "MappedFile.hh"
+
 // STL //
 #include <iostream>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -36,14 +41,6 @@ namespace File
 {
 
 
-struct Token 
-{
-    std::string name;
-
-    bool operator==(Token other) { return name == other.name; };
-    bool operator!=(Token other) { return name != other.name; };
-};
-
 // Error tokens.
 static Token ErrorToken { "ErrorToken" };
 static Token EnfOfFileToken { "EndOfFileToken" };
@@ -65,26 +62,6 @@ static Token CommentToken { "Comment" };
 static Token BlankLineToken { "BlankLine" };
 
 
-struct Item
-{
-    Token       token;
-
-    size_t      position;
-    size_t      line;
-
-    std::string value;
-    std::string error;
-
-    Item*       parent;
-
-    std::vector<Item> children;
-};
-
-
-typedef std::vector<Item> Items;
-typedef Items::iterator ItemsIterator;
-
-
 class Lexer;
 
 
@@ -100,6 +77,12 @@ struct __FinalState : public State
     {
         return nullptr;
     }
+
+    static State* Instance()
+    {
+        static __FinalState state;
+        return &state;
+    }
 };
 
 
@@ -108,29 +91,46 @@ class Lexer
   public:
     Lexer(std::string filepath, State* initial_state = nullptr);
 
+    // Lex only [begin, end) of a file that is already mapped, so that several
+    // lexers can work on parts of the same file at once.
+    Lexer( std::shared_ptr<MappedFile> file
+         , size_t begin
+         , size_t end
+         , State* initial_state = nullptr);
+
+    // Splits [begin, end) into chunks of whole lines, and lexes them on up to
+    // `chunks` threads. The lexers are returned in file order.
+    static std::vector<Lexer> RunInChunks( std::shared_ptr<MappedFile> file
+                                         , size_t begin
+                                         , size_t end
+                                         , size_t chunks
+                                         , State* initial_state);
+
   public:
     std::string String();
 
     void Run(State* initial_state, size_t lines = 0);
-    Items GetItems();
+
+    std::shared_ptr<Items> GetItems();
+    size_t GetRoot();
 
     void Backup();
-    void BackupTo(int position);
+    void BackupTo(size_t position);
 
     std::string Next();
     std::string Peek();
 
     void Skip();
 
-    Item* ThisIsA(Token token, std::string error = "");
-    Item* StartOfA(Token token, std::string error = "");
-    Item* EndOfA(Token token, std::string error = "");
-    Item* MaybeEndOfA(Token token, std::string error = "");
+    size_t ThisIsA(Token token);
+    size_t StartOfA(Token token);
+    size_t EndOfA(Token token);
+    size_t MaybeEndOfA(Token token);
 
-    bool OneOf(std::string possibles);
-    bool ManyOf(std::string possibles);
-    bool Until(std::string match);
-    bool MatchExactly(std::string match);
+    bool OneOf(const char* possibles);
+    bool ManyOf(const char* possibles);
+    bool Until(const char* match);
+    bool MatchExactly(const char* match);
 
     bool OneDigit();
     bool ManyDigits();
@@ -148,38 +148,69 @@ class Lexer
     bool SkipLineBreak();
     bool SkipLineBreaks();
     bool SkipLine();
+    bool SkipWhiteSpaceAndLineBreaks();
+
+    bool AtEndOfLine();
+    bool AtEndOfFile();
 
     State* Error(std::string message);
     State* LastError();
 
     bool TestState(State* state);
+    bool Predict(const char* prefix);
 
     bool IsDryRun();
 
     void PrintMessage(std::string name, std::string message);
-    void PrintItem(Item item);
+    void PrintItem(size_t index);
 
     size_t LineNumber();
+    size_t LineNumber(size_t position);
+
+  private:
+    // Character classes for the lookup table used by the primitives above.
+    enum CharacterClass
+    {
+        DigitClass      = 1 << 0,
+        LetterClass     = 1 << 1,
+        PrintableClass  = 1 << 2,
+        WhiteSpaceClass = 1 << 3,
+        LineBreakClass  = 1 << 4
+    };
+
+    static const unsigned char* CharacterClasses();
+
+    bool OneOfClass(unsigned char character_class);
+    bool ManyOfClass(unsigned char character_class);
+
+    // Like ManyOfClass for white space, with or without line breaks, but
+    // long runs are jumped using the file's structural index.
+    bool ManyOfBlankClass(unsigned char character_class);
 
   private:
     State* state_;
 
-    Item* parent_item_ = nullptr; 
-    Items items_;
+    std::shared_ptr<Items> items_;
+
+    size_t root_ = NoItem;
+    size_t parent_item_ = NoItem;
+
+    std::shared_ptr<MappedFile> file_;
+    const StructuralIndex* index_ = nullptr;
 
-    std::string input_;
+    const char* input_ = nullptr;
+    size_t length_ = 0;
 
     size_t position_ = 0;
     size_t start_ = 0;
-    size_t width_ = 1;
-    size_t line_ = 1;
-    size_t end_line_ = 0;
+    size_t end_position_ = std::string::npos;
 
     bool dry_run_ = false;
 
     int depth_ = 0;
 
     std::string last_error_ = "";
+    size_t last_error_position_ = 0;
 };
 
 }
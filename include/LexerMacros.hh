@@ -26,8 +26,13 @@
     static Token name##Token{ #name }
 
 
+// States hold no data, so each one is a single shared instance and moving
+// between states never allocates.
 #define CADMeshLexerStateDefinition(name) \
-    struct name##State : public State { State* operator()(Lexer* lexer) const ; } 
+    struct name##State : public State { \
+        State* operator()(Lexer* lexer) const ; \
+        static State* Instance() { static name##State state; return &state; } \
+    } 
 
 #define CADMeshLexerState(name) name##State::operator()(Lexer* lexer) const
 
@@ -90,14 +95,22 @@
 #define SkipLine() lexer->SkipLine()
 #define DidNotSkipLine() !SkipLine()
 
-#define AtEndOfLine() Next() == "\n" || Next() == "\r"
+#define SkipWhiteSpaceAndLineBreaks() lexer->SkipWhiteSpaceAndLineBreaks()
+#define DidNotSkipWhiteSpaceAndLineBreaks() !SkipWhiteSpaceAndLineBreaks()
+
+#define AtEndOfLine() lexer->AtEndOfLine()
 
 #define Error(message) { lexer->Error(message); return nullptr; }
 
-#define NextState(next) return new next##State()
-#define TestState(next) lexer->TestState(new next##State())
+#define NextState(next) return next##State::Instance()
+#define TestState(next) lexer->TestState(next##State::Instance())
 #define TryState(next) if (TestState(next)) NextState(next)
-#define FinalState() return new __FinalState();
 
-#define RunLexer(filepath, start) Lexer(filepath, new start##State).GetItems()
+// Choose the next state from the start of the upcoming input (past any blank
+// space) without running it first. A predicted state that then fails to lex
+// is an error, rather than falling through to the next candidate.
+#define PredictState(next, prefix) if (lexer->Predict(prefix)) NextState(next)
+#define FinalState() return __FinalState::Instance();
+
+#define RunLexer(filepath, start) Lexer(filepath, start##State::Instance()).GetItems()
 
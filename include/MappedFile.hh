@@ -0,0 +1,102 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2011-2020 Christopher M. Poole <mail@christopherpoole.net>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+// CADMesh //
+#include "StructuralIndex.hh"
+
+// STL //
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+namespace CADMesh
+{
+
+namespace File
+{
+
+// A read-only view of the bytes of a file on disk. Regular files are mapped
+// into memory where the platform supports it, so large meshes are not copied
+// before lexing. Anything else (pipes, devices, or a failed mapping) falls
+// back to reading the whole file into a std::string.
+class MappedFile
+{
+  public:
+    MappedFile(std::string filepath);
+
+    // Reads just the first size bytes of the file, such as a header.
+    MappedFile(std::string filepath, size_t size);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+  public:
+    const char* Data();
+    size_t Size();
+
+    bool IsMapped();
+
+    // Line numbers start at one, and are only indexed when first asked for.
+    size_t LineNumber(size_t position);
+    size_t EndOfLine(size_t line);
+
+    // Splits [begin, end) into at most `chunks` ranges, returned as their
+    // boundaries. Each range after the first starts on a line that begins
+    // with prefix, ignoring leading white space.
+    std::vector<size_t> Split(size_t begin, size_t end, size_t chunks, std::string prefix = "");
+
+    // Where the white space and line breaks are, indexed when first asked
+    // for. Only text files should ask.
+    const StructuralIndex& Index();
+
+  private:
+    bool Map(std::string filepath);
+    void Read(std::string filepath);
+
+    void IndexLineBreaks();
+
+  private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+
+    void* mapping_ = nullptr;
+    size_t mapping_size_ = 0;
+
+    std::string buffer_;
+
+    // Offsets of every '\n' in the file.
+    std::vector<size_t> line_breaks_;
+    std::once_flag index_line_breaks_;
+
+    std::unique_ptr<StructuralIndex> index_;
+    std::once_flag index_once_;
+};
+
+} // File namespace
+
+} // CADMesh namespace
+
@@ -22,11 +22,18 @@
 
 #pragma once
 
+// CADMesh //
+#include "Validation.hh"
+#include "FacetRepair.hh"
+
 // GEANT4 //
+#include "geomdefs.hh"
 #include "G4ThreeVector.hh"
 #include "G4TriangularFacet.hh"
 
 // STL //
+#include <cstdint>
+#include <functional>
 #include <vector>
 #include <memory>
 
@@ -37,16 +44,46 @@ namespace CADMesh
 typedef std::vector<G4ThreeVector> Points;
 typedef std::vector<G4TriangularFacet*> Triangles;
 
+// Three vertex indices per triangle.
+typedef std::vector<uint32_t> Indices;
+
+
+// Hashes a point by its exact position, to find corners that are the same
+// point.
+struct PointHash
+{
+    size_t operator()(const G4ThreeVector& point) const
+    {
+        std::hash<G4double> hash;
+
+        auto seed = hash(point.x());
+        seed ^= hash(point.y()) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+        seed ^= hash(point.z()) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
 
+        return seed;
+    }
+};
+
+
+// A triangle mesh, held as one array for each vertex coordinate and an index
+// buffer, rather than as a Geant4 facet per triangle. Facets are only built
+// when a solid needs them.
 class Mesh
 {
   public:
-    Mesh(Points points, Triangles triangles, G4String name = "");
+    Mesh(Points points, Indices indices, G4String name = "");
 
     static std::shared_ptr<Mesh> New( Points points
-                                    , Triangles triangles
+                                    , Indices indices
                                     , G4String name = "");
 
+    // Every three corners make a triangle. Corners at the same position
+    // become one vertex.
+    static std::shared_ptr<Mesh> FromCorners( Points corners
+                                            , G4String name = "");
+
+    // The points are recovered from the triangles. The mesh takes the
+    // facets from the caller, and deletes them once their corners are read.
     static std::shared_ptr<Mesh> New( Triangles triangles
                                     , G4String name = "");
 
@@ -55,16 +92,86 @@ class Mesh
 
   public:
     G4String GetName();
+
+    size_t GetNumberOfPoints();
+    size_t GetNumberOfTriangles();
+
+    G4ThreeVector GetPoint(size_t index);
     Points GetPoints();
+
+    const std::vector<G4double>& GetX();
+    const std::vector<G4double>& GetY();
+    const std::vector<G4double>& GetZ();
+    const Indices& GetIndices();
+
+    // Builds a new facet for each triangle, owned by the caller.
     Triangles GetTriangles();
 
     G4bool IsValidForNavigation();
 
+    // Finds every boundary, non-manifold and misoriented edge, and every
+    // degenerate facet. Threads are picked from the hardware if not given.
+    Validation Validate(size_t threads = 0);
+
+    // Merges points that are within the tolerance of each other, or of a
+    // point that is merged with them, into the first of them. A relative
+    // tolerance is a fraction of the diagonal of the bounding box. Zero
+    // merges points at exactly the same position. Triangles left with two
+    // corners at the same point are dropped. Threads are picked from the
+    // hardware if not given.
+    void Weld(G4double tolerance, G4bool relative = false, size_t threads = 0);
+
+    // Collapses short edges and flips long ones until no facet has an edge
+    // or a height within the tolerance, an area within the minimum area, or
+    // a longest edge more than the maximum aspect ratio times its height,
+    // keeping the mesh closed. Zero is no limit for either of the last two.
+    // Facets that can't be repaired are left. See FacetRepair.
+    FacetRepair RepairDegenerateFacets( G4double minimum_area = 0
+                                      , G4double maximum_aspect_ratio = 0
+                                      , G4double tolerance = kCarTolerance
+                                      , size_t threads = 0);
+
+    // Collapses edges until there are at most target triangles, or no more
+    // can be collapsed without the surface moving by more than the maximum
+    // deviation, keeping the mesh closed. Either being zero is no limit.
+    // Returns an upper bound on how far the surface moved. See Decimation.
+    G4double Decimate( size_t target
+                     , G4double maximum_deviation = 0
+                     , size_t threads = 0);
+
+    // Sorts the triangles along a Hilbert curve through the bounding box, by
+    // their centres, and numbers the points in the order the triangles first
+    // use them, so that triangles and points near each other in space are
+    // near each other in memory. Threads are picked from the hardware if not
+    // given.
+    void Reorder(size_t threads = 0);
+
+    // Frees the points and indices once nothing more is to be built from
+    // them. The name is kept.
+    void Release();
+    G4bool IsReleased();
+
+    // Counts the changes made to the points and indices in place, so that
+    // what was built from them can tell when it is out of date.
+    size_t GetModificationCount();
+
+  private:
+    // The distance along a Hilbert curve through a cube of 2^levels cells a
+    // side, up to 21 levels, of the cell at the coordinates given, which are
+    // changed.
+    static uint64_t HilbertIndex(uint32_t coordinates[3], uint32_t levels);
+
   private:
     G4String name_ = "";
 
-    Points points_;
-    Triangles triangles_;
+    std::vector<G4double> x_;
+    std::vector<G4double> y_;
+    std::vector<G4double> z_;
+
+    Indices indices_;
+
+    G4bool released_ = false;
+    size_t modification_count_ = 0;
 };
 
 typedef std::vector<std::shared_ptr<Mesh> > Meshes;
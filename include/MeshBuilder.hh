@@ -0,0 +1,70 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2011-2020 Christopher M. Poole <mail@christopherpoole.net>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+// CADMesh //
+#include "Mesh.hh"
+#include "MeshSink.hh"
+
+// STL //
+#include <unordered_map>
+
+
+namespace CADMesh
+{
+
+namespace File
+{
+
+// Builds the meshes a reader would have, from what is streamed to it.
+class MeshBuilder : public MeshSink
+{
+  public:
+    void StartMesh(G4String name);
+    void AddTriangle( const G4ThreeVector& a
+                    , const G4ThreeVector& b
+                    , const G4ThreeVector& c);
+    void EndMesh();
+
+    Meshes GetMeshes();
+
+  private:
+    void AddCorner(const G4ThreeVector& corner);
+
+  private:
+    Meshes meshes_;
+
+    G4String name_ = "";
+
+    // Each point is kept once, as it first arrives, with three indices into
+    // the points for each triangle.
+    Points points_;
+    Indices indices_;
+
+    std::unordered_map<G4ThreeVector, uint32_t, PointHash> point_index_;
+};
+
+} // File namespace
+
+} // CADMesh namespace
+
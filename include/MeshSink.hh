@@ -0,0 +1,54 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2011-2020 Christopher M. Poole <mail@christopherpoole.net>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+// GEANT4 //
+#include "G4String.hh"
+#include "G4ThreeVector.hh"
+
+
+namespace CADMesh
+{
+
+namespace File
+{
+
+// Receives meshes from a reader as they are parsed, one triangle at a time,
+// so that nothing but the sink's own output needs to be kept. Triangles come
+// between a StartMesh and its EndMesh.
+class MeshSink
+{
+  public:
+    virtual ~MeshSink() { };
+
+    virtual void StartMesh(G4String name) = 0;
+    virtual void AddTriangle( const G4ThreeVector& a
+                            , const G4ThreeVector& b
+                            , const G4ThreeVector& c) = 0;
+    virtual void EndMesh() = 0;
+};
+
+} // File namespace
+
+} // CADMesh namespace
+
@@ -0,0 +1,64 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2011-2020 Christopher M. Poole <mail@christopherpoole.net>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+// STL //
+#include <cstdint>
+
+
+namespace CADMesh
+{
+
+namespace File
+{
+
+// Converts decimal numbers straight from the input, in the one pass that
+// recognises them. Numbers have the form [+-]digits[.digits][(e|E)[+-]digits].
+class NumberParser
+{
+  public:
+    // Returns the end of the number at the start of [begin, end), or begin if
+    // there isn't one. The value is the same double strtod would give.
+    static const char* Parse(const char* begin, const char* end, double& value);
+
+    // As above for [+-]digits, stopping at the first non-digit like atol.
+    static const char* Parse(const char* begin, const char* end, long& value);
+
+    // Recognise a number without converting it.
+    static const char* Match(const char* begin, const char* end);
+
+  private:
+    static const char* Digits( const char* begin
+                             , const char* end
+                             , uint64_t& mantissa
+                                 , int& digits);
+
+    static const char* Exponent(const char* begin, const char* end, int64_t& exponent);
+
+    static bool IsDigit(char c) { return c >= '0' && c <= '9'; };
+};
+
+} // File namespace
+
+} // CADMesh namespace
+
@@ -26,6 +26,7 @@
 #include "Reader.hh"
 #include "Lexer.hh"
 #include "LexerMacros.hh"
+#include "FileStream.hh"
 
 // GEANT4 //
 #include "globals.hh"
@@ -45,6 +46,7 @@ class OBJReader : public Reader
     G4bool Read(G4String filepath);
     G4bool CanRead(Type file_type);
 
+    G4bool Stream(G4String filepath, MeshSink& sink);
 
   protected:
     // Lexer.
@@ -57,9 +59,10 @@ class OBJReader : public Reader
     CADMeshLexerStateDefinition(Object);
 
     // Parser. 
-    std::shared_ptr<Mesh> ParseMesh(Items items);
-    G4ThreeVector ParseVertex(Items items);
-    G4TriangularFacet* ParseFacet(Items items, G4bool quad);
+    void ParseVertices(Items& items, size_t solid, size_t& next);
+    Indices ParseFacets(Items& items, size_t solid);
+    G4ThreeVector ParseVertex(Items& items, size_t vertex);
+    void ParseFacet(Items& items, size_t facet, G4bool quad, Indices& facets);
 
   private:
     Points vertices_;
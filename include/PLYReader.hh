@@ -26,6 +26,8 @@
 #include "Reader.hh"
 #include "Lexer.hh"
 #include "LexerMacros.hh"
+#include "MappedFile.hh"
+#include "FileStream.hh"
 
 // GEANT4 //
 #include "globals.hh"
@@ -38,6 +40,7 @@ namespace File
 {
 
 CADMeshLexerToken(Header);
+CADMeshLexerToken(Format);
 CADMeshLexerToken(Element);
 CADMeshLexerToken(Property);
 
@@ -49,11 +52,14 @@ class PLYReader : public Reader
     G4bool Read(G4String filepath);
     G4bool CanRead(Type file_type);
 
+    G4bool Stream(G4String filepath, MeshSink& sink);
+
   protected:
     //Lexer.
     CADMeshLexerStateDefinition(StartHeader);
     CADMeshLexerStateDefinition(EndHeader);
 
+    CADMeshLexerStateDefinition(Format);
     CADMeshLexerStateDefinition(Element);
     CADMeshLexerStateDefinition(Property);
     CADMeshLexerStateDefinition(Ignore);
@@ -61,12 +67,75 @@ class PLYReader : public Reader
     CADMeshLexerStateDefinition(Vertex);
     CADMeshLexerStateDefinition(Facet);
 
+    // The header, compiled once into what is needed to decode the body.
+    enum FileFormat
+    {
+        ASCII,
+        BinaryLittleEndian,
+        BinaryBigEndian
+    };
+
+    enum PropertyType
+    {
+        Int8,
+        UInt8,
+        Int16,
+        UInt16,
+        Int32,
+        UInt32,
+        Float32,
+        Float64
+    };
+
+    struct PropertySchema
+    {
+        G4String name;
+        PropertyType type;
+
+        G4bool is_list = false;
+        PropertyType count_type = UInt8;
+
+        // Byte offset from the start of the element, for fixed size elements.
+        size_t offset = 0;
+    };
+
+    struct ElementSchema
+    {
+        G4String name;
+        size_t count = 0;
+
+        std::vector<PropertySchema> properties;
+
+        // Bytes per element, or zero if the element contains lists.
+        size_t stride = 0;
+    };
+
     // Parser. 
-    void ParseHeader(Items items);
+    void ParseHeader(Items& items, size_t root);
+    PropertySchema ParseProperty(Items& items, size_t property);
+
+    std::shared_ptr<Mesh> ParseMesh( std::vector<Lexer>& vertex_chunks
+                                   , std::vector<Lexer>& facet_chunks);
+    G4ThreeVector ParseVertex(Items& items, size_t vertex);
+    void ParseFacet(Items& items, size_t facet, const Points& vertices, Indices& indices);
+
+    // Binary decoder.
+    static size_t HeaderSize(MappedFile& file);
+    std::shared_ptr<Mesh> ReadBinary(MappedFile& file);
+
+    static PropertyType PropertyTypeFromName(G4String name);
+    static size_t SizeOf(PropertyType type);
+    G4double ReadValue(const unsigned char* bytes, PropertyType type);
+
+    // Streaming, one element at a time.
+    void StreamText(FileStream& file, MeshSink& sink);
+    void StreamBinary(FileStream& file, MeshSink& sink);
+
+    FileFormat format_ = ASCII;
+    std::vector<ElementSchema> elements_;
 
-    std::shared_ptr<Mesh> ParseMesh(Items vertex_items, Items face_items);
-    G4ThreeVector ParseVertex(Items items);
-    G4TriangularFacet* ParseFacet(Items items, Points vertices);
+    size_t vertex_element_ = 0;
+    size_t facet_element_ = 0;
 
     size_t vertex_count_ = 0;
     size_t facet_count_ = 0;
@@ -0,0 +1,350 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2011-2020 Christopher M. Poole <mail@christopherpoole.net>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+// STL //
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <thread>
+#include <vector>
+
+
+namespace CADMesh
+{
+
+// An error raised on a worker thread. Geant4 exceptions must be raised on
+// the thread that started the work, so the error only keeps how to raise
+// it again there.
+class WorkerError : public std::exception
+{
+  public:
+    WorkerError(std::function<void()> raise) : raise_(raise) {};
+
+    void Raise() const { raise_(); };
+
+  private:
+    std::function<void()> raise_;
+};
+
+
+// True on the threads started by ParallelFor.
+inline bool& IsWorkerThread()
+{
+    static thread_local bool is_worker = false;
+    return is_worker;
+}
+
+
+// How many threads work started on this thread may use, or zero if it is
+// not limited. Workers are given an even share of their caller's, so nested
+// calls don't start more threads than the outermost one asked for.
+inline size_t& ThreadShare()
+{
+    static thread_local size_t share = 0;
+    return share;
+}
+
+
+// Rethrows an error caught on a worker thread. Once back on the thread that
+// started the work, a WorkerError is raised again there instead.
+inline void RethrowOnCaller(std::exception_ptr error)
+{
+    try
+    {
+        std::rethrow_exception(error);
+    }
+
+    catch (const WorkerError& worker_error)
+    {
+        if (IsWorkerThread())
+        {
+            throw;
+        }
+
+        worker_error.Raise();
+    }
+}
+
+
+// Calls function(i) for every i in [0, count), with each of up to `threads`
+// threads taking a contiguous block of indices. An exception thrown by any
+// call is rethrown here once every thread has finished; if several are
+// thrown, the one from the earliest block wins, so errors are deterministic.
+// Errors raised through Exceptions on a worker are only raised, on this
+// thread, after the join. Threads are started for each call; a call made on
+// a worker uses no more than that worker's share of the threads.
+template <typename Function>
+void ParallelFor(size_t count, size_t threads, Function function)
+{
+    threads = std::min(threads, count);
+
+    auto budget = ThreadShare();
+
+    if (budget > 0)
+    {
+        threads = std::min(threads, budget);
+    }
+
+    if (threads < 2)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            function(i);
+        }
+
+        return;
+    }
+
+    std::vector<std::exception_ptr> errors(threads);
+    std::vector<std::thread> workers;
+
+    auto step = (count + threads - 1) / threads;
+
+    if (budget == 0)
+    {
+        budget = std::max<size_t>(threads, std::thread::hardware_concurrency());
+    }
+
+    auto share = std::max<size_t>(1, budget / threads);
+
+    for (size_t t = 0; t < threads; t++)
+    {
+        workers.emplace_back([&, t]()
+        {
+            IsWorkerThread() = true;
+            ThreadShare() = share;
+
+            try
+            {
+                for (size_t i = t * step; i < std::min(count, (t + 1) * step); i++)
+                {
+                    function(i);
+                }
+            }
+
+            catch (...)
+            {
+                errors[t] = std::current_exception();
+            }
+        });
+    }
+
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+
+    for (auto& error : errors)
+    {
+        if (error)
+        {
+            RethrowOnCaller(error);
+            return;
+        }
+    }
+}
+
+
+// Calls function(i) for every i in [0, count) on up to `threads` threads,
+// each taking the next index as soon as it is free, so that uneven work is
+// shared out. Put the largest items first. Errors are rethrown as for
+// ParallelFor, the one from the lowest index winning.
+template <typename Function>
+void ParallelForEach(size_t count, size_t threads, Function function)
+{
+    threads = std::min(threads, count);
+
+    if (threads < 2)
+    {
+        ParallelFor(count, 1, function);
+        return;
+    }
+
+    std::atomic<size_t> next(0);
+    std::vector<std::exception_ptr> errors(count);
+
+    ParallelFor(threads, threads, [&](size_t)
+    {
+        for (auto i = next++; i < count; i = next++)
+        {
+            try
+            {
+                function(i);
+            }
+
+            catch (...)
+            {
+                errors[i] = std::current_exception();
+            }
+        }
+    });
+
+    for (auto& error : errors)
+    {
+        if (error)
+        {
+            RethrowOnCaller(error);
+            return;
+        }
+    }
+}
+
+
+// Enough threads for count items of work, each thread taking at least grain
+// of them, and no more than the hardware has.
+inline size_t NumberOfThreads(size_t count, size_t grain)
+{
+    size_t hardware = std::max(std::thread::hardware_concurrency(), 1u);
+
+    return std::max<size_t>(1, std::min<size_t>(hardware, count / grain));
+}
+
+
+// Sorts [begin, end) in contiguous runs, one per thread, then merges
+// neighbouring runs in parallel until one is left. The comparison should be
+// a total order for the result to be the same for any number of threads.
+template <typename Iterator, typename Compare>
+void ParallelSort(Iterator begin, Iterator end, size_t threads, Compare compare)
+{
+    size_t count = end - begin;
+    threads = std::max<size_t>(1, std::min(threads, count));
+
+    std::vector<size_t> bounds;
+
+    for (size_t t = 0; t <= threads; t++)
+    {
+        bounds.push_back(count * t / threads);
+    }
+
+    ParallelFor(threads, threads, [&](size_t t)
+    {
+        std::sort(begin + bounds[t], begin + bounds[t + 1], compare);
+    });
+
+    for (size_t width = 1; width < threads; width *= 2)
+    {
+        ParallelFor((threads + 2 * width - 1) / (2 * width), threads, [&](size_t pair)
+        {
+            auto first = 2 * width * pair;
+            auto middle = std::min(first + width, threads);
+            auto last = std::min(first + 2 * width, threads);
+
+            if (middle < last)
+            {
+                std::inplace_merge( begin + bounds[first]
+                                  , begin + bounds[middle]
+                                  , begin + bounds[last]
+                                  , compare);
+            }
+        });
+    }
+}
+
+
+// Sorts the keys, and the values with them, a byte at a time from the
+// lowest. Each thread counts the bytes in a contiguous block and then moves
+// its block to where the counts put it. Equal keys keep their order, so the
+// result is the same for any number of threads. Bytes that every key has
+// the same are skipped.
+inline void ParallelRadixSort( std::vector<uint64_t>& keys
+                             , std::vector<uint32_t>& values
+                             , size_t threads)
+{
+    auto count = keys.size();
+    threads = std::max<size_t>(1, std::min(threads, count));
+
+    std::vector<uint64_t> sorted_keys(count);
+    std::vector<uint32_t> sorted_values(count);
+
+    // A count, and then a place to move to, for each byte in each block.
+    std::vector<size_t> places(256 * threads);
+
+    for (size_t shift = 0; shift < 64; shift += 8)
+    {
+        std::fill(places.begin(), places.end(), 0);
+
+        ParallelFor(threads, threads, [&](size_t t)
+        {
+            auto counts = &places[256 * t];
+
+            for (size_t i = count * t / threads; i < count * (t + 1) / threads; i++)
+            {
+                counts[(keys[i] >> shift) & 0xff]++;
+            }
+        });
+
+        bool same = false;
+        size_t place = 0;
+
+        for (size_t byte = 0; byte < 256 && !same; byte++)
+        {
+            size_t total = 0;
+
+            for (size_t t = 0; t < threads; t++)
+            {
+                total += places[256 * t + byte];
+            }
+
+            same = total == count;
+        }
+
+        if (same)
+        {
+            continue;
+        }
+
+        for (size_t byte = 0; byte < 256; byte++)
+        {
+            for (size_t t = 0; t < threads; t++)
+            {
+                auto counted = places[256 * t + byte];
+                places[256 * t + byte] = place;
+                place += counted;
+            }
+        }
+
+        ParallelFor(threads, threads, [&](size_t t)
+        {
+            auto next = &places[256 * t];
+
+            for (size_t i = count * t / threads; i < count * (t + 1) / threads; i++)
+            {
+                auto& to = next[(keys[i] >> shift) & 0xff];
+
+                sorted_keys[to] = keys[i];
+                sorted_values[to] = values[i];
+
+                to++;
+            }
+        });
+
+        keys.swap(sorted_keys);
+        values.swap(sorted_values);
+    }
+}
+
+} // CADMesh namespace
+
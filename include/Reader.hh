@@ -25,6 +25,7 @@
 // CADMesh //
 #include "FileTypes.hh"
 #include "Mesh.hh"
+#include "MeshSink.hh"
 #include "Exceptions.hh"
 
 // GEANT4 //
@@ -46,6 +47,11 @@ class Reader
     virtual G4bool Read(G4String filepath) = 0;
     virtual G4bool CanRead(Type file_type) = 0;
 
+    // Parses the file a chunk at a time, handing each mesh to the sink as it
+    // is read rather than keeping the whole file. The default reads the
+    // whole file and then hands over its meshes.
+    virtual G4bool Stream(G4String filepath, MeshSink& sink);
+
   public: 
     G4String GetName();
 
@@ -57,14 +63,43 @@ class Reader
 
     Meshes GetMeshes();
 
+    // Validates every mesh, side by side when there are several.
+    Validations Validate();
+
+    // Large files are read in chunks on this many threads. Zero picks a
+    // number based on the size of the file, and one reads serially.
+    void SetNumberOfThreads(size_t number_of_threads);
+    size_t GetNumberOfThreads();
+
+    // With a chunk size, Read streams the file through a buffer of about
+    // that many bytes rather than holding all of it. Zero reads it whole.
+    void SetChunkSize(size_t chunk_size);
+    size_t GetChunkSize();
+
+    // Welds the points of each mesh as it is read. See Mesh::Weld.
+    void SetWeldTolerance(G4double tolerance, G4bool relative = false);
+
   protected:
     size_t AddMesh(std::shared_ptr<Mesh> mesh);
     void SetMeshes(Meshes meshs);
 
+    size_t NumberOfChunks(size_t bytes);
+
+    // Reads the file by streaming it into meshes.
+    G4bool ReadStreaming(G4String filepath);
+    size_t StreamChunkSize();
+
   private:
     Meshes meshes_;
 
     G4String name_ = "";
+
+    size_t number_of_threads_ = 0;
+    size_t chunk_size_ = 0;
+
+    G4bool weld_ = false;
+    G4double weld_tolerance_ = 0;
+    G4bool weld_relative_ = false;
 };
 
 }
@@ -26,6 +26,8 @@
 #include "Reader.hh"
 #include "Lexer.hh"
 #include "LexerMacros.hh"
+#include "MappedFile.hh"
+#include "FileStream.hh"
 
 // GEANT4 //
 #include "globals.hh"
@@ -45,6 +47,8 @@ class STLReader : public Reader
     G4bool Read(G4String filepath);
     G4bool CanRead(Type file_type);
 
+    G4bool Stream(G4String filepath, MeshSink& sink);
+
   protected:
     // Lexer.
     CADMeshLexerStateDefinition(StartSolid);
@@ -60,11 +64,32 @@ class STLReader : public Reader
 
     CADMeshLexerStateDefinition(ThreeVector);
 
+    // Scanner, for well formed files.
+    G4bool Scan(MappedFile& file);
+    static G4bool ScanFacets( const char* begin
+                            , const char* end
+                            , std::vector<G4double>& coordinates);
+
+    // Binary files.
+    G4bool IsBinary(MappedFile& file);
+    G4bool ReadBinary(MappedFile& file);
+
+    static G4bool IsBinary(const unsigned char* header, size_t header_size, size_t file_size);
+    static G4String NameFromHeader(const unsigned char* header);
+    static void CheckBinarySize(size_t count, size_t file_size);
+
+    // Streaming.
+    G4bool StreamText(FileStream& file, MeshSink& sink);
+    G4bool StreamBinary(FileStream& file, MeshSink& sink);
+
+    static uint32_t ReadUInt32(const unsigned char* bytes);
+    static G4ThreeVector ReadThreeVector(const unsigned char* bytes);
+
     // Parser.
-    std::shared_ptr<Mesh> ParseMesh(Items items);
-    G4TriangularFacet* ParseFacet(Items items);
-    G4TriangularFacet* ParseVertices(Items items);
-    G4ThreeVector ParseThreeVector(Items items);
+    std::shared_ptr<Mesh> ParseMesh(Items& items, size_t solid);
+    Points ParseFacet(Items& items, size_t facet);
+    Points ParseVertices(Items& items, size_t vertices);
+    G4ThreeVector ParseThreeVector(Items& items, size_t three_vector);
 };
 
 } // File namespace
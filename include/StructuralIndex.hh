@@ -0,0 +1,117 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2011-2020 Christopher M. Poole <mail@christopherpoole.net>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+// STL //
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+namespace CADMesh
+{
+
+namespace File
+{
+
+// A first pass over the bytes of a file that records, one bit per byte, where
+// the line breaks ('\n') and the white space (' ', '\t', '\r') are. The
+// lexer then jumps over white space and to the ends of lines a word at a time
+// rather than a byte at a time. The bitmaps are computed 64 bytes at a time
+// with AVX2 or SSE2 when the processor has them, chosen at runtime.
+class StructuralIndex
+{
+  public:
+    enum Kernel
+    {
+        Scalar,
+        SSE2,
+        AVX2
+    };
+
+    StructuralIndex(const char* data, size_t size, Kernel kernel = Best());
+
+  public:
+    // The fastest kernel this processor supports.
+    static Kernel Best();
+    static bool IsSupported(Kernel kernel);
+    static std::string KernelName(Kernel kernel);
+
+    // The first position at or after position that isn't white space, or
+    // that is neither white space nor a line break, or size.
+    size_t NextNonWhiteSpace(size_t position) const;
+    size_t NextNonBlank(size_t position) const;
+
+    // The first line break at or after position, or size.
+    size_t NextLineBreak(size_t position) const;
+
+    const std::vector<uint64_t>& LineBreaks() const { return line_breaks_; };
+    const std::vector<uint64_t>& WhiteSpace() const { return white_space_; };
+
+    // The position of the lowest set bit of a non-zero word.
+    static size_t CountTrailingZeros(uint64_t word);
+
+  private:
+    // Each fills one word of each bitmap from 64 bytes.
+    static void ClassifyScalar(const char* block, uint64_t& line_breaks, uint64_t& white_space);
+    static void ClassifySSE2(const char* block, uint64_t& line_breaks, uint64_t& white_space);
+    static void ClassifyAVX2(const char* block, uint64_t& line_breaks, uint64_t& white_space);
+
+    // The first position at or after position whose bit is set in
+    // mask(line breaks, white space), or size.
+    template <typename Mask>
+    size_t Find(size_t position, Mask mask) const
+    {
+        if (position >= size_)
+        {
+            return size_;
+        }
+
+        auto word = position / 64;
+        auto bits = mask(line_breaks_[word], white_space_[word]) & (~0ull << (position % 64));
+
+        while (!bits)
+        {
+            if (++word == line_breaks_.size())
+            {
+                return size_;
+            }
+
+            bits = mask(line_breaks_[word], white_space_[word]);
+        }
+
+        return std::min(size_, word * 64 + CountTrailingZeros(bits));
+    };
+
+  private:
+    size_t size_ = 0;
+
+    std::vector<uint64_t> line_breaks_;
+    std::vector<uint64_t> white_space_;
+};
+
+} // File namespace
+
+} // CADMesh namespace
+
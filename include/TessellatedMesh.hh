@@ -24,18 +24,28 @@
 
 // CADMesh //
 #include "CADMeshTemplate.hh"
+#include "BVHSolid.hh"
+#include "CoplanarMerge.hh"
 
 // GEANT4 //
 #include "G4String.hh"
 #include "G4ThreeVector.hh"
 #include "G4TessellatedSolid.hh"
 #include "G4TriangularFacet.hh"
+#include "G4QuadrangularFacet.hh"
 #include "G4Tet.hh"
 #include "G4AssemblyVolume.hh"
 #include "G4Material.hh"
 #include "G4LogicalVolume.hh"
 //#include "G4SystemOfUnits.hh"
 #include "G4UIcommand.hh"
+#include "G4ios.hh"
+
+// STL //
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
 
 
 namespace CADMesh
@@ -45,6 +55,14 @@ class TessellatedMesh : public CADMeshTemplate<TessellatedMesh>
 {
   using CADMeshTemplate::CADMeshTemplate;
 
+  public:
+    // The kind of solid GetSolid and GetSolids build.
+    enum SolidType
+    {
+        Tessellated,
+        BVH
+    };
+
   public:
     G4VSolid* GetSolid();
     G4VSolid* GetSolid(G4int index);
@@ -55,21 +73,147 @@ class TessellatedMesh : public CADMeshTemplate<TessellatedMesh>
     G4TessellatedSolid* GetTessellatedSolid();
     G4TessellatedSolid* GetTessellatedSolid(G4int index);
     G4TessellatedSolid* GetTessellatedSolid(G4String name, G4bool exact = true);
+
+    // Solids are built once for each mesh, scale, offset, reverse and type,
+    // and the same solid is handed out again after that. This is safe to
+    // call from several threads at once, but not while changing the settings.
     G4TessellatedSolid* GetTessellatedSolid(std::shared_ptr<Mesh> mesh);
 
+    BVHSolid* GetBVHSolid();
+    BVHSolid* GetBVHSolid(G4int index);
+    BVHSolid* GetBVHSolid(G4String name, G4bool exact = true);
+    BVHSolid* GetBVHSolid(std::shared_ptr<Mesh> mesh);
+
     G4AssemblyVolume* GetAssembly();
 
   public:
     void SetReverse(G4bool reverse) {
+        if (reverse != this->reverse_)
+        {
+            InvalidateSolids();
+        }
+
         this->reverse_ = reverse;
     };
 
     G4bool GetReverse() {
         return this->reverse_;
     };
-    
+
+    // Frees each mesh once its solid is built, so only the solid's facets
+    // are left in memory. A released mesh can't be built again.
+    void SetReleaseMeshes(G4bool release_meshes) {
+        this->release_meshes_ = release_meshes;
+    };
+
+    G4bool GetReleaseMeshes() {
+        return this->release_meshes_;
+    };
+
+    // Solids are built on this many threads, the larger meshes first, and
+    // their facets split between threads in proportion to their size. One,
+    // the default, builds them in turn, and zero uses every core.
+    void SetNumberOfThreads(size_t number_of_threads) {
+        this->number_of_threads_ = number_of_threads;
+    };
+
+    size_t GetNumberOfThreads() {
+        return this->number_of_threads_;
+    };
+
+    // G4TessellatedSolid by default, or BVHSolid.
+    void SetSolidType(SolidType solid_type) {
+        this->solid_type_ = solid_type;
+    };
+
+    SolidType GetSolidType() {
+        return this->solid_type_;
+    };
+
+    // Gives each BVHSolid a DistanceField with cells of this size, to look
+    // up its safety distances. Zero, the default, gives them none.
+    void SetDistanceFieldCellSize(G4double cell_size) {
+        if (cell_size != this->distance_field_cell_size_)
+        {
+            InvalidateSolids();
+        }
+
+        this->distance_field_cell_size_ = cell_size;
+    };
+
+    G4double GetDistanceFieldCellSize() {
+        return this->distance_field_cell_size_;
+    };
+
+    // Merges triangles that are coplanar to within this distance into
+    // fewer facets when building a G4TessellatedSolid, see CoplanarMerge.
+    // Zero, the default, builds a facet for every triangle.
+    void SetCoplanarTolerance(G4double tolerance) {
+        if (tolerance != this->coplanar_tolerance_)
+        {
+            InvalidateSolids();
+        }
+
+        this->coplanar_tolerance_ = tolerance;
+    };
+
+    G4double GetCoplanarTolerance() {
+        return this->coplanar_tolerance_;
+    };
+
+  protected:
+    void InvalidateSolids();
+
+  private:
+    size_t NumberOfThreads();
+
+    G4VSolid* GetCachedSolid( std::shared_ptr<Mesh> mesh
+                            , size_t threads
+                            , SolidType solid_type);
+
+    G4TessellatedSolid* BuildTessellatedSolid( std::shared_ptr<Mesh> mesh
+                                             , size_t threads);
+
+    std::vector<G4VFacet*> BuildMergedFacets( std::shared_ptr<Mesh> mesh
+                                            , size_t threads);
+
+    BVHSolid* BuildBVHSolid( std::shared_ptr<Mesh> mesh
+                           , size_t threads);
+
+    // Geant4 registers each new solid in a store that is not safe to add to
+    // from several threads at once.
+    static std::mutex& SolidStoreMutex();
+
   private:
-    G4bool reverse_;
+    G4bool reverse_ = false;
+    G4bool release_meshes_ = false;
+
+    size_t number_of_threads_ = 1;
+
+    SolidType solid_type_ = Tessellated;
+    G4double distance_field_cell_size_ = 0;
+    G4double coplanar_tolerance_ = 0;
+
+    struct CachedSolid
+    {
+        std::once_flag built;
+        G4VSolid* solid = nullptr;
+    };
+
+    // The modification count of the mesh is part of the key, so that a
+    // mesh changed in place gets a new solid.
+    typedef std::tuple< std::shared_ptr<Mesh>
+                      , size_t
+                      , G4double
+                      , G4double
+                      , G4double
+                      , G4double
+                      , G4bool
+                      , SolidType> SolidKey;
+
+    // Solids are owned by the Geant4 solid store, not by the cache.
+    std::map<SolidKey, std::shared_ptr<CachedSolid> > solids_;
+    std::mutex solids_mutex_;
 };
 
 } // CADMesh namespace
@@ -0,0 +1,93 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2011-2020 Christopher M. Poole <mail@christopherpoole.net>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+// GEANT4 //
+#include "globals.hh"
+#include "G4String.hh"
+#include "G4ThreeVector.hh"
+
+// STL //
+#include <vector>
+
+
+namespace CADMesh
+{
+
+// What Mesh::Validate finds wrong with a mesh. Facets are numbered in the
+// order of the mesh, and points at the same position are the same point.
+struct Validation
+{
+    struct Edge
+    {
+        G4ThreeVector start;
+        G4ThreeVector end;
+
+        // Every facet that uses the edge.
+        std::vector<size_t> facets;
+    };
+
+    struct Facet
+    {
+        size_t index;
+
+        G4ThreeVector a;
+        G4ThreeVector b;
+        G4ThreeVector c;
+    };
+
+    G4String name = "";
+    size_t number_of_facets = 0;
+
+    // Edges of only one facet, such as on the rim of a hole.
+    std::vector<Edge> boundary_edges;
+
+    // Edges shared by more than two facets.
+    std::vector<Edge> non_manifold_edges;
+
+    // Edges whose two facets run along them in the same direction, so one
+    // of the two faces the wrong way.
+    std::vector<Edge> misoriented_edges;
+
+    // Facets Geant4 would refuse, with an edge or a height no longer than
+    // the surface tolerance.
+    std::vector<Facet> degenerate_facets;
+
+    // Every edge is shared by exactly two facets.
+    G4bool IsValidForNavigation() const
+    {
+        return boundary_edges.empty() && non_manifold_edges.empty();
+    }
+
+    G4bool IsValid() const
+    {
+        return IsValidForNavigation()
+            && misoriented_edges.empty()
+            && degenerate_facets.empty();
+    }
+};
+
+typedef std::vector<Validation> Validations;
+
+} // CADMesh namespace
+
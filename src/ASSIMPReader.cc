@@ -60,28 +60,33 @@ G4bool ASSIMPReader::Read(G4String filepath)
         aiMesh* mesh = scene->mMeshes[index];
         auto name = mesh->mName.C_Str();
 
-        Triangles triangles;
+        Points points;
 
-        for(unsigned int i=0; i < mesh->mNumFaces; i++)
+        for(unsigned int i=0; i < mesh->mNumVertices; i++)
         {
-            const aiFace& face = mesh->mFaces[i];
+            points.push_back(G4ThreeVector( mesh->mVertices[i].x
+                                          , mesh->mVertices[i].y
+                                          , mesh->mVertices[i].z));
+        }
 
-            G4ThreeVector a( mesh->mVertices[face.mIndices[0]].x
-                           , mesh->mVertices[face.mIndices[0]].y 
-                           , mesh->mVertices[face.mIndices[0]].z); 
+        Indices indices;
 
-            G4ThreeVector b( mesh->mVertices[face.mIndices[1]].x
-                           , mesh->mVertices[face.mIndices[1]].y 
-                           , mesh->mVertices[face.mIndices[1]].z); 
+        for(unsigned int i=0; i < mesh->mNumFaces; i++)
+        {
+            const aiFace& face = mesh->mFaces[i];
 
-            G4ThreeVector c( mesh->mVertices[face.mIndices[2]].x
-                           , mesh->mVertices[face.mIndices[2]].y 
-                           , mesh->mVertices[face.mIndices[2]].z); 
+            // Points and lines are left over after triangulation.
+            if (face.mNumIndices != 3)
+            {
+                continue;
+            }
 
-            triangles.push_back(new G4TriangularFacet(a, b, c, ABSOLUTE));
+            indices.push_back(face.mIndices[0]);
+            indices.push_back(face.mIndices[1]);
+            indices.push_back(face.mIndices[2]);
         }
 
-        AddMesh(Mesh::New(triangles, name));
+        AddMesh(Mesh::New(std::move(points), std::move(indices), name));
     }
 
     return true;
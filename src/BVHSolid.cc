@@ -0,0 +1,389 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2011-2020 Christopher M. Poole <mail@christopherpoole.net>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// CADMesh //
+#include "BVHSolid.hh"
+#include "Exceptions.hh"
+
+// GEANT4 //
+#include "G4BoundingEnvelope.hh"
+#include "G4GeometryTolerance.hh"
+#include "G4PolyhedronArbitrary.hh"
+#include "G4VGraphicsScene.hh"
+#include "Randomize.hh"
+
+// STL //
+#include <algorithm>
+#include <cmath>
+
+
+namespace CADMesh
+{
+
+BVHSolid::BVHSolid( G4String name
+                  , const Points& points
+                  , const Indices& indices
+                  , size_t threads)
+    : BVHSolid( name
+              , std::make_shared<BoundingVolumeHierarchy>( points
+                                                         , indices
+                                                         , G4GeometryTolerance::GetInstance()->GetSurfaceTolerance()
+                                                         , threads))
+{
+}
+
+
+BVHSolid::BVHSolid( G4String name
+                  , std::shared_ptr<const BoundingVolumeHierarchy> hierarchy)
+    : G4VSolid(name)
+    , hierarchy_(hierarchy)
+{
+    auto areas = std::make_shared<std::vector<G4double> >(hierarchy_->GetNumberOfTriangles());
+
+    G4double area = 0;
+    G4double volume = 0;
+
+    for (size_t i = 0; i < areas->size(); i++)
+    {
+        auto a = hierarchy_->GetCorner(i, 0);
+        auto b = hierarchy_->GetCorner(i, 1);
+        auto c = hierarchy_->GetCorner(i, 2);
+
+        area += (b - a).cross(c - a).mag() / 2;
+        volume += a.dot(b.cross(c)) / 6;
+
+        (*areas)[i] = area;
+    }
+
+    areas_ = areas;
+
+    surface_area_ = area;
+    cubic_volume_ = volume;
+}
+
+
+EInside BVHSolid::Inside(const G4ThreeVector& p) const
+{
+    auto half_tolerance = kCarTolerance / 2;
+
+    auto minimum = hierarchy_->GetMinimum();
+    auto maximum = hierarchy_->GetMaximum();
+
+    for (G4int axis = 0; axis < 3; axis++)
+    {
+        if (p[axis] < minimum[axis] - half_tolerance || p[axis] > maximum[axis] + half_tolerance)
+        {
+            return kOutside;
+        }
+    }
+
+    if (distance_field_)
+    {
+        auto side = distance_field_->Side(p);
+
+        if (side > 0) return kOutside;
+        if (side < 0) return kInside;
+    }
+
+    auto nearest = hierarchy_->Closest(p);
+
+    if (nearest.triangle == BoundingVolumeHierarchy::none)
+    {
+        return kOutside;
+    }
+
+    if (nearest.distance_squared <= half_tolerance * half_tolerance)
+    {
+        return kSurface;
+    }
+
+    return hierarchy_->Contains(p, nearest) ? kInside : kOutside;
+}
+
+
+G4ThreeVector BVHSolid::SurfaceNormal(const G4ThreeVector& p) const
+{
+    auto nearest = hierarchy_->Closest(p);
+
+    if (nearest.triangle == BoundingVolumeHierarchy::none)
+    {
+        return G4ThreeVector(0, 0, 1);
+    }
+
+    return hierarchy_->GetNormal(nearest.triangle);
+}
+
+
+G4double BVHSolid::DistanceToIn(const G4ThreeVector& p, const G4ThreeVector& v) const
+{
+    auto half_tolerance = kCarTolerance / 2;
+
+    // Only the triangles facing the ray can be entered through. Those just
+    // behind p count too, so that a point on the surface enters at once.
+    auto hit = hierarchy_->Intersect(p, v, -half_tolerance, BoundingVolumeHierarchy::Against);
+
+    if (hit.triangle == BoundingVolumeHierarchy::none)
+    {
+        return kInfinity;
+    }
+
+    return hit.distance > half_tolerance ? hit.distance : 0;
+}
+
+
+G4double BVHSolid::DistanceToIn(const G4ThreeVector& p) const
+{
+    EInside side;
+    auto safety = Safety(p, side);
+
+    // Points on the surface or inside are already in.
+    return side == kOutside ? safety : 0;
+}
+
+
+G4double BVHSolid::DistanceToOut( const G4ThreeVector& p
+                                , const G4ThreeVector& v
+                                , const G4bool calcNorm
+                                , G4bool* validNorm
+                                , G4ThreeVector* n) const
+{
+    auto half_tolerance = kCarTolerance / 2;
+
+    auto hit = hierarchy_->Intersect(p, v, -half_tolerance, BoundingVolumeHierarchy::Along);
+
+    // The mesh need not be convex, so the solid may lie beyond the exit.
+    if (calcNorm && validNorm)
+    {
+        (*validNorm) = false;
+    }
+
+    if (calcNorm && n)
+    {
+        (*n) = hit.triangle == BoundingVolumeHierarchy::none ? v : hierarchy_->GetNormal(hit.triangle);
+    }
+
+    if (hit.triangle == BoundingVolumeHierarchy::none)
+    {
+        return 0;
+    }
+
+    return hit.distance > half_tolerance ? hit.distance : 0;
+}
+
+
+G4double BVHSolid::DistanceToOut(const G4ThreeVector& p) const
+{
+    EInside side;
+    auto safety = Safety(p, side);
+
+    // Points on the surface or outside are already out.
+    return side == kInside ? safety : 0;
+}
+
+
+G4double BVHSolid::Safety(const G4ThreeVector& p, EInside& side) const
+{
+    auto half_tolerance = kCarTolerance / 2;
+
+    // Away from the surface the field knows both the side and a safety.
+    if (distance_field_)
+    {
+        auto field_side = distance_field_->Side(p);
+        auto safety = distance_field_->Safety(p);
+
+        if (field_side != 0 && safety >= 0)
+        {
+            side = field_side > 0 ? kOutside : kInside;
+            return safety;
+        }
+
+        searches_->fetch_add(1, std::memory_order_relaxed);
+    }
+
+    auto nearest = hierarchy_->Closest(p);
+
+    if (nearest.triangle == BoundingVolumeHierarchy::none)
+    {
+        side = kOutside;
+        return kInfinity;
+    }
+
+    auto distance = std::sqrt(nearest.distance_squared);
+
+    if (distance <= half_tolerance)
+    {
+        side = kSurface;
+        return 0;
+    }
+
+    auto minimum = hierarchy_->GetMinimum();
+    auto maximum = hierarchy_->GetMaximum();
+
+    G4bool in_box = true;
+
+    for (G4int axis = 0; axis < 3; axis++)
+    {
+        in_box = in_box && p[axis] >= minimum[axis] && p[axis] <= maximum[axis];
+    }
+
+    side = in_box && hierarchy_->Contains(p, nearest) ? kInside : kOutside;
+
+    return distance;
+}
+
+
+void BVHSolid::SetDistanceField(std::shared_ptr<const DistanceField> distance_field)
+{
+    if (distance_field && !distance_field->IsFor(*hierarchy_))
+    {
+        Exceptions::InvalidDistanceField( "BVHSolid::SetDistanceField"
+                                        , "The distance field was built around another mesh than the solid '" + GetName() + "'.");
+    }
+
+    distance_field_ = distance_field;
+}
+
+
+void BVHSolid::BoundingLimits(G4ThreeVector& pMin, G4ThreeVector& pMax) const
+{
+    pMin = hierarchy_->GetMinimum();
+    pMax = hierarchy_->GetMaximum();
+}
+
+
+G4bool BVHSolid::CalculateExtent( const EAxis pAxis
+                                , const G4VoxelLimits& pVoxelLimit
+                                , const G4AffineTransform& pTransform
+                                , G4double& pMin
+                                , G4double& pMax) const
+{
+    G4ThreeVector minimum;
+    G4ThreeVector maximum;
+
+    BoundingLimits(minimum, maximum);
+
+    G4BoundingEnvelope envelope(minimum, maximum);
+
+    return envelope.CalculateExtent(pAxis, pVoxelLimit, pTransform, pMin, pMax);
+}
+
+
+G4String BVHSolid::GetEntityType() const
+{
+    return "BVHSolid";
+}
+
+
+std::ostream& BVHSolid::StreamInfo(std::ostream& os) const
+{
+    os << "-----------------------------------------------------------\n"
+       << "    *** Dump for solid - " << GetName() << " ***\n"
+       << "    ===================================================\n"
+       << " Solid type: " << GetEntityType() << "\n"
+       << " Parameters: \n"
+       << "   number of triangles: " << hierarchy_->GetNumberOfTriangles() << "\n"
+       << "   number of nodes: " << hierarchy_->GetNumberOfNodes() << "\n"
+       << "   kernel: " << BoundingVolumeHierarchy::KernelName(BoundingVolumeHierarchy::Best()) << "\n"
+       << "-----------------------------------------------------------\n";
+
+    return os;
+}
+
+
+void BVHSolid::DescribeYourselfTo(G4VGraphicsScene& scene) const
+{
+    scene.AddSolid(*this);
+}
+
+
+G4Polyhedron* BVHSolid::CreatePolyhedron() const
+{
+    auto& points = hierarchy_->GetPoints();
+    auto& indices = hierarchy_->GetIndices();
+
+    auto polyhedron = new G4PolyhedronArbitrary(points.size(), indices.size() / 3);
+
+    for (auto& point : points)
+    {
+        polyhedron->AddVertex(point);
+    }
+
+    for (size_t i = 0; i < indices.size(); i += 3)
+    {
+        polyhedron->AddFacet(indices[i] + 1, indices[i + 1] + 1, indices[i + 2] + 1);
+    }
+
+    polyhedron->SetReferences();
+
+    return (G4Polyhedron*) polyhedron;
+}
+
+
+G4VSolid* BVHSolid::Clone() const
+{
+    return new BVHSolid(*this);
+}
+
+
+G4double BVHSolid::GetCubicVolume()
+{
+    return cubic_volume_;
+}
+
+
+G4double BVHSolid::GetSurfaceArea()
+{
+    return surface_area_;
+}
+
+
+G4ThreeVector BVHSolid::GetPointOnSurface() const
+{
+    auto& areas = *areas_;
+
+    if (areas.empty())
+    {
+        return G4ThreeVector();
+    }
+
+    auto area = G4UniformRand() * areas.back();
+    auto triangle = std::upper_bound(areas.begin(), areas.end(), area) - areas.begin();
+    triangle = std::min<size_t>(triangle, areas.size() - 1);
+
+    auto a = hierarchy_->GetCorner(triangle, 0);
+    auto b = hierarchy_->GetCorner(triangle, 1);
+    auto c = hierarchy_->GetCorner(triangle, 2);
+
+    auto u = G4UniformRand();
+    auto v = G4UniformRand();
+
+    if (u + v > 1)
+    {
+        u = 1 - u;
+        v = 1 - v;
+    }
+
+    return a + (b - a) * u + (c - a) * v;
+}
+
+} // CADMesh namespace
+
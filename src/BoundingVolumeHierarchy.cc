@@ -0,0 +1,1128 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2011-2020 Christopher M. Poole <mail@christopherpoole.net>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// CADMesh //
+#include "BoundingVolumeHierarchy.hh"
+#include "Exceptions.hh"
+#include "Parallel.hh"
+
+// STL //
+#include <algorithm>
+#include <cmath>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define CADMESH_HAS_X86_SIMD
+#include <immintrin.h>
+#endif
+
+
+namespace CADMesh
+{
+
+BoundingVolumeHierarchy::BoundingVolumeHierarchy( const Points& points
+                                                , const Indices& indices
+                                                , G4double padding
+                                                , size_t threads
+                                                , Kernel kernel)
+    : points_(points)
+    , indices_(indices)
+    , padding_(padding)
+    , kernel_(IsSupported(kernel) ? kernel : Scalar)
+{
+    if (indices_.size() % 3 != 0)
+    {
+        Exceptions::InvalidMesh("BoundingVolumeHierarchy", "The number of indices is not a multiple of three.");
+    }
+
+    for (auto index : indices_)
+    {
+        if (index >= points_.size())
+        {
+            Exceptions::InvalidMesh("BoundingVolumeHierarchy", "A triangle refers to a point that doesn't exist.");
+        }
+    }
+
+    Build(std::max<size_t>(threads, 1));
+}
+
+
+void BoundingVolumeHierarchy::Build(size_t threads)
+{
+    auto count = GetNumberOfTriangles();
+
+    if (count == 0)
+    {
+        return;
+    }
+
+    if (count > std::numeric_limits<uint32_t>::max())
+    {
+        Exceptions::InvalidMesh("BoundingVolumeHierarchy", "The mesh has too many triangles to index.");
+    }
+
+    std::vector<Bounds> bounds(count);
+    std::vector<uint32_t> order(count);
+
+    ParallelFor(count, threads, [&](size_t i)
+    {
+        order[i] = i;
+
+        for (size_t axis = 0; axis < 3; axis++)
+        {
+            auto a = points_[indices_[3 * i]][axis];
+            auto b = points_[indices_[3 * i + 1]][axis];
+            auto c = points_[indices_[3 * i + 2]][axis];
+
+            bounds[i].minimum[axis] = std::min({ a, b, c });
+            bounds[i].maximum[axis] = std::max({ a, b, c });
+            bounds[i].centre[axis] = (bounds[i].minimum[axis] + bounds[i].maximum[axis]) / 2;
+        }
+    });
+
+    Node root;
+    root.first = 0;
+    root.count = count;
+    Fit(root, bounds, order);
+
+    nodes_.push_back(root);
+
+    // The top of the tree is split here, breadth first, until the nodes are
+    // small enough to hand out. Where that stops doesn't depend on the
+    // number of threads, so neither does the tree.
+    const size_t grain = 1 << 12;
+
+    typedef std::pair<size_t, size_t> Work; // node, depth
+
+    std::vector<Work> work = { Work(0, 0) };
+    std::vector<Work> subtrees;
+
+    for (size_t k = 0; k < work.size(); k++)
+    {
+        auto node = work[k].first;
+        auto depth = work[k].second;
+
+        if (nodes_[node].count <= grain)
+        {
+            subtrees.push_back(work[k]);
+        }
+
+        else if (Split(nodes_, node, depth, bounds, order))
+        {
+            work.push_back(Work(nodes_[node].first, depth + 1));
+            work.push_back(Work(nodes_[node].first + 1, depth + 1));
+        }
+    }
+
+    // The rest of each subtree is built on its own, the largest first, into
+    // its own nodes, with its root first.
+    std::vector<size_t> largest(subtrees.size());
+
+    for (size_t k = 0; k < largest.size(); k++)
+    {
+        largest[k] = k;
+    }
+
+    std::stable_sort(largest.begin(), largest.end(), [&](size_t a, size_t b)
+    {
+        return nodes_[subtrees[a].first].count > nodes_[subtrees[b].first].count;
+    });
+
+    std::vector<std::vector<Node> > built(subtrees.size());
+
+    ParallelForEach(largest.size(), threads, [&](size_t k)
+    {
+        auto& nodes = built[largest[k]];
+        nodes.push_back(nodes_[subtrees[largest[k]].first]);
+
+        std::vector<Work> stack = { Work(0, subtrees[largest[k]].second) };
+
+        while (!stack.empty())
+        {
+            auto node = stack.back().first;
+            auto depth = stack.back().second;
+            stack.pop_back();
+
+            if (Split(nodes, node, depth, bounds, order))
+            {
+                stack.push_back(Work(nodes[node].first + 1, depth + 1));
+                stack.push_back(Work(nodes[node].first, depth + 1));
+            }
+        }
+    });
+
+    // Each subtree's root takes the place of the node it grew from, and the
+    // rest are added to the end.
+    for (size_t k = 0; k < subtrees.size(); k++)
+    {
+        auto& nodes = built[k];
+        auto offset = nodes_.size() - 1;
+
+        for (auto& node : nodes)
+        {
+            if (node.count == 0)
+            {
+                node.first += offset;
+            }
+        }
+
+        nodes_[subtrees[k].first] = nodes[0];
+        nodes_.insert(nodes_.end(), nodes.begin() + 1, nodes.end());
+    }
+
+    for (auto& node : nodes_)
+    {
+        for (size_t axis = 0; axis < 3; axis++)
+        {
+            node.minimum[axis] -= padding_;
+            node.maximum[axis] += padding_;
+        }
+    }
+
+    // The triangles are kept in the order of the leaves, with three more
+    // empty ones at the end so that the last leaf can be read four at a time.
+    Indices indices(indices_.size());
+
+    for (size_t i = 0; i < count; i++)
+    {
+        for (size_t corner = 0; corner < 3; corner++)
+        {
+            indices[3 * i + corner] = indices_[3 * order[i] + corner];
+        }
+    }
+
+    indices_.swap(indices);
+
+    for (size_t axis = 0; axis < 3; axis++)
+    {
+        corner_[axis].assign(count + 3, 0);
+        first_edge_[axis].assign(count + 3, 0);
+        second_edge_[axis].assign(count + 3, 0);
+    }
+
+    ParallelFor(count, threads, [&](size_t i)
+    {
+        auto a = points_[indices_[3 * i]];
+        auto b = points_[indices_[3 * i + 1]];
+        auto c = points_[indices_[3 * i + 2]];
+
+        for (size_t axis = 0; axis < 3; axis++)
+        {
+            corner_[axis][i] = a[axis];
+            first_edge_[axis][i] = b[axis] - a[axis];
+            second_edge_[axis][i] = c[axis] - a[axis];
+        }
+    });
+}
+
+
+void BoundingVolumeHierarchy::Fit( Node& node
+                                 , const std::vector<Bounds>& bounds
+                                 , const std::vector<uint32_t>& order)
+{
+    for (size_t axis = 0; axis < 3; axis++)
+    {
+        node.minimum[axis] = kInfinity;
+        node.maximum[axis] = -kInfinity;
+    }
+
+    for (size_t k = node.first; k < node.first + node.count; k++)
+    {
+        auto& triangle = bounds[order[k]];
+
+        for (size_t axis = 0; axis < 3; axis++)
+        {
+            node.minimum[axis] = std::min(node.minimum[axis], triangle.minimum[axis]);
+            node.maximum[axis] = std::max(node.maximum[axis], triangle.maximum[axis]);
+        }
+    }
+}
+
+
+G4bool BoundingVolumeHierarchy::Split( std::vector<Node>& nodes
+                                     , size_t node
+                                     , size_t depth
+                                     , const std::vector<Bounds>& bounds
+                                     , std::vector<uint32_t>& order)
+{
+    const size_t bins = 16;
+    const size_t largest_leaf = 8;
+    const size_t deepest = 48;
+
+    auto first = nodes[node].first;
+    auto count = nodes[node].count;
+
+    if (count <= 2)
+    {
+        return false;
+    }
+
+    auto begin = order.begin() + first;
+    auto end = begin + count;
+
+    G4double low[3] = { kInfinity, kInfinity, kInfinity };
+    G4double high[3] = { -kInfinity, -kInfinity, -kInfinity };
+
+    for (auto i = begin; i != end; i++)
+    {
+        for (size_t axis = 0; axis < 3; axis++)
+        {
+            low[axis] = std::min(low[axis], bounds[*i].centre[axis]);
+            high[axis] = std::max(high[axis], bounds[*i].centre[axis]);
+        }
+    }
+
+    auto area = [](const G4double minimum[3], const G4double maximum[3])
+    {
+        auto x = maximum[0] - minimum[0];
+        auto y = maximum[1] - minimum[1];
+        auto z = maximum[2] - minimum[2];
+
+        return x * y + y * z + z * x;
+    };
+
+    auto bin_of = [&](uint32_t triangle, size_t axis)
+    {
+        auto bin = (size_t) ((bounds[triangle].centre[axis] - low[axis]) / (high[axis] - low[axis]) * bins);
+
+        return std::min(bin, bins - 1);
+    };
+
+    // The cheapest split between bins along any axis, by the surface area
+    // heuristic, with the cost of a leaf being its number of triangles.
+    G4double best_cost = kInfinity;
+    size_t best_axis = 3;
+    size_t best_bin = 0;
+
+    for (size_t axis = 0; axis < 3; axis++)
+    {
+        if (!(high[axis] > low[axis]))
+        {
+            continue;
+        }
+
+        size_t counts[bins] = {};
+        Node boxes[bins];
+
+        for (size_t b = 0; b < bins; b++)
+        {
+            for (size_t a = 0; a < 3; a++)
+            {
+                boxes[b].minimum[a] = kInfinity;
+                boxes[b].maximum[a] = -kInfinity;
+            }
+        }
+
+        for (auto i = begin; i != end; i++)
+        {
+            auto b = bin_of(*i, axis);
+            counts[b]++;
+
+            for (size_t a = 0; a < 3; a++)
+            {
+                boxes[b].minimum[a] = std::min(boxes[b].minimum[a], bounds[*i].minimum[a]);
+                boxes[b].maximum[a] = std::max(boxes[b].maximum[a], bounds[*i].maximum[a]);
+            }
+        }
+
+        // The area and count to the right of each split.
+        G4double right_area[bins];
+        size_t right_count[bins];
+
+        Node right = boxes[bins - 1];
+        size_t right_total = 0;
+
+        for (size_t b = bins - 1; b > 0; b--)
+        {
+            for (size_t a = 0; a < 3; a++)
+            {
+                right.minimum[a] = std::min(right.minimum[a], boxes[b].minimum[a]);
+                right.maximum[a] = std::max(right.maximum[a], boxes[b].maximum[a]);
+            }
+
+            right_total += counts[b];
+            right_count[b] = right_total;
+            right_area[b] = right_total > 0 ? area(right.minimum, right.maximum) : 0;
+        }
+
+        Node left = boxes[0];
+        size_t left_total = 0;
+
+        for (size_t b = 1; b < bins; b++)
+        {
+            for (size_t a = 0; a < 3; a++)
+            {
+                left.minimum[a] = std::min(left.minimum[a], boxes[b - 1].minimum[a]);
+                left.maximum[a] = std::max(left.maximum[a], boxes[b - 1].maximum[a]);
+            }
+
+            left_total += counts[b - 1];
+
+            if (left_total == 0 || right_count[b] == 0)
+            {
+                continue;
+            }
+
+            auto cost = left_total * area(left.minimum, left.maximum)
+                      + right_count[b] * right_area[b];
+
+            if (cost < best_cost)
+            {
+                best_cost = cost;
+                best_axis = axis;
+                best_bin = b;
+            }
+        }
+    }
+
+    auto whole = area(nodes[node].minimum, nodes[node].maximum);
+    auto leaf_cost = (G4double) count;
+    auto split_cost = whole > 0 ? 1 + best_cost / whole : kInfinity;
+
+    if (count <= largest_leaf && leaf_cost <= split_cost)
+    {
+        return false;
+    }
+
+    size_t middle = 0;
+
+    if (best_axis < 3 && depth < deepest)
+    {
+        middle = std::partition(begin, end, [&](uint32_t triangle)
+        {
+            return bin_of(triangle, best_axis) < best_bin;
+        }) - begin;
+    }
+
+    // Too deep, or nothing to split on: halve by the widest axis.
+    if (middle == 0 || middle == count)
+    {
+        size_t axis = 0;
+
+        for (size_t a = 1; a < 3; a++)
+        {
+            if (high[a] - low[a] > high[axis] - low[axis])
+                axis = a;
+        }
+
+        middle = count / 2;
+
+        std::nth_element(begin, begin + middle, end, [&](uint32_t a, uint32_t b)
+        {
+            return bounds[a].centre[axis] < bounds[b].centre[axis]
+                || (bounds[a].centre[axis] == bounds[b].centre[axis] && a < b);
+        });
+    }
+
+    Node left;
+    left.first = first;
+    left.count = middle;
+    Fit(left, bounds, order);
+
+    Node right;
+    right.first = first + middle;
+    right.count = count - middle;
+    Fit(right, bounds, order);
+
+    nodes[node].first = nodes.size();
+    nodes[node].count = 0;
+
+    nodes.push_back(left);
+    nodes.push_back(right);
+
+    return true;
+}
+
+
+BoundingVolumeHierarchy::Hit BoundingVolumeHierarchy::Intersect( const G4ThreeVector& origin
+                                                               , const G4ThreeVector& direction
+                                                               , G4double from
+                                                               , Facing facing) const
+{
+    Hit hit;
+
+    if (nodes_.empty())
+    {
+        return hit;
+    }
+
+    G4double o[3] = { origin.x(), origin.y(), origin.z() };
+    G4double d[3] = { direction.x(), direction.y(), direction.z() };
+    G4double inverse[3] = { 1 / d[0], 1 / d[1], 1 / d[2] };
+
+    auto intersect = kernel_ == AVX ? IntersectAVX : IntersectScalar;
+
+    // Deep enough for the deepest tree Split makes.
+    uint32_t stack[128];
+    size_t size = 0;
+
+    if (Entry(nodes_[0], o, d, inverse, from, hit.distance) < kInfinity)
+    {
+        stack[size++] = 0;
+    }
+
+    while (size > 0)
+    {
+        auto& node = nodes_[stack[--size]];
+
+        if (node.count > 0)
+        {
+            for (size_t first = node.first; first < node.first + node.count; first += 4)
+            {
+                auto count = std::min<size_t>(4, node.first + node.count - first);
+
+                G4double distances[4];
+                intersect(*this, first, count, o, d, distances, facing);
+
+                for (size_t lane = 0; lane < count; lane++)
+                {
+                    if (distances[lane] >= from && distances[lane] < hit.distance)
+                    {
+                        hit.distance = distances[lane];
+                        hit.triangle = first + lane;
+                    }
+                }
+            }
+
+            continue;
+        }
+
+        // The nearer child is looked at first, so that it can rule out the
+        // further one.
+        auto near = node.first;
+        auto far = node.first + 1;
+
+        auto near_entry = Entry(nodes_[near], o, d, inverse, from, hit.distance);
+        auto far_entry = Entry(nodes_[far], o, d, inverse, from, hit.distance);
+
+        if (far_entry < near_entry)
+        {
+            std::swap(near, far);
+            std::swap(near_entry, far_entry);
+        }
+
+        if (far_entry < kInfinity) stack[size++] = far;
+        if (near_entry < kInfinity) stack[size++] = near;
+    }
+
+    return hit;
+}
+
+
+size_t BoundingVolumeHierarchy::Crossings( const G4ThreeVector& origin
+                                         , const G4ThreeVector& direction
+                                         , G4bool& ambiguous) const
+{
+    ambiguous = false;
+
+    if (nodes_.empty())
+    {
+        return 0;
+    }
+
+    G4double o[3] = { origin.x(), origin.y(), origin.z() };
+    G4double d[3] = { direction.x(), direction.y(), direction.z() };
+    G4double inverse[3] = { 1 / d[0], 1 / d[1], 1 / d[2] };
+
+    // How near an edge, as a fraction of the triangle, and how glancing a
+    // crossing can be before it can't be counted on.
+    const G4double margin = 1e-9;
+
+    size_t crossings = 0;
+
+    uint32_t stack[128];
+    size_t size = 0;
+
+    stack[size++] = 0;
+
+    while (size > 0)
+    {
+        auto& node = nodes_[stack[--size]];
+
+        if (Entry(node, o, d, inverse, 0, kInfinity) == kInfinity)
+        {
+            continue;
+        }
+
+        if (node.count == 0)
+        {
+            stack[size++] = node.first;
+            stack[size++] = node.first + 1;
+
+            continue;
+        }
+
+        for (size_t i = node.first; i < node.first + node.count; i++)
+        {
+            G4ThreeVector a(corner_[0][i], corner_[1][i], corner_[2][i]);
+            G4ThreeVector e1(first_edge_[0][i], first_edge_[1][i], first_edge_[2][i]);
+            G4ThreeVector e2(second_edge_[0][i], second_edge_[1][i], second_edge_[2][i]);
+
+            auto p = direction.cross(e2);
+            auto det = e1.dot(p);
+            auto s = origin - a;
+
+            auto normal = e1.cross(e2);
+            auto scale = normal.mag();
+
+            if (std::abs(det) <= margin * scale)
+            {
+                // Along the plane of the triangle. It only matters if the ray
+                // is in the plane.
+                if (scale > 0 && std::abs(s.dot(normal)) <= margin * scale * std::sqrt(scale))
+                {
+                    ambiguous = true;
+                }
+
+                continue;
+            }
+
+            auto u = s.dot(p) / det;
+            auto q = s.cross(e1);
+            auto v = direction.dot(q) / det;
+            auto t = e2.dot(q) / det;
+
+            if (u < -margin || v < -margin || u + v > 1 + margin || t <= 0)
+            {
+                continue;
+            }
+
+            if (u < margin || v < margin || u + v > 1 - margin)
+            {
+                ambiguous = true;
+            }
+
+            crossings++;
+        }
+    }
+
+    return crossings;
+}
+
+
+BoundingVolumeHierarchy::Nearest BoundingVolumeHierarchy::Closest( const G4ThreeVector& point
+                                                                 , G4double within) const
+{
+    Nearest nearest;
+
+    if (within < kInfinity)
+    {
+        nearest.distance_squared = within * within;
+    }
+
+    if (nodes_.empty())
+    {
+        return nearest;
+    }
+
+    G4double p[3] = { point.x(), point.y(), point.z() };
+
+    uint32_t stack[128];
+    size_t size = 0;
+
+    if (DistanceSquared(nodes_[0], p) < nearest.distance_squared)
+    {
+        stack[size++] = 0;
+    }
+
+    while (size > 0)
+    {
+        auto& node = nodes_[stack[--size]];
+
+        if (DistanceSquared(node, p) >= nearest.distance_squared)
+        {
+            continue;
+        }
+
+        if (node.count == 0)
+        {
+            auto near = node.first;
+            auto far = node.first + 1;
+
+            auto near_distance = DistanceSquared(nodes_[near], p);
+            auto far_distance = DistanceSquared(nodes_[far], p);
+
+            if (far_distance < near_distance)
+            {
+                std::swap(near, far);
+                std::swap(near_distance, far_distance);
+            }
+
+            if (far_distance < nearest.distance_squared) stack[size++] = far;
+            if (near_distance < nearest.distance_squared) stack[size++] = near;
+
+            continue;
+        }
+
+        for (size_t i = node.first; i < node.first + node.count; i++)
+        {
+            G4ThreeVector a(corner_[0][i], corner_[1][i], corner_[2][i]);
+            G4ThreeVector ab(first_edge_[0][i], first_edge_[1][i], first_edge_[2][i]);
+            G4ThreeVector ac(second_edge_[0][i], second_edge_[1][i], second_edge_[2][i]);
+
+            G4bool on_face = false;
+            auto closest = ClosestPoint(point, a, ab, ac, on_face);
+
+            auto distance_squared = (point - closest).mag2();
+
+            if (distance_squared < nearest.distance_squared)
+            {
+                nearest.distance_squared = distance_squared;
+                nearest.triangle = i;
+                nearest.point = closest;
+                nearest.on_face = on_face;
+            }
+        }
+    }
+
+    return nearest;
+}
+
+
+G4ThreeVector BoundingVolumeHierarchy::ClosestPoint( const G4ThreeVector& point
+                                                   , const G4ThreeVector& a
+                                                   , const G4ThreeVector& ab
+                                                   , const G4ThreeVector& ac
+                                                   , G4bool& on_face)
+{
+    // After Ericson, Real-Time Collision Detection, 5.1.5.
+    on_face = false;
+
+    auto ap = point - a;
+    auto d1 = ab.dot(ap);
+    auto d2 = ac.dot(ap);
+
+    auto bp = ap - ab;
+    auto d3 = ab.dot(bp);
+    auto d4 = ac.dot(bp);
+
+    auto cp = ap - ac;
+    auto d5 = ab.dot(cp);
+    auto d6 = ac.dot(cp);
+
+    auto va = d3 * d6 - d5 * d4;
+    auto vb = d5 * d2 - d1 * d6;
+    auto vc = d1 * d4 - d3 * d2;
+
+    if (d1 <= 0 && d2 <= 0)
+        return a;
+
+    if (d3 >= 0 && d4 <= d3)
+        return a + ab;
+
+    if (d6 >= 0 && d5 <= d6)
+        return a + ac;
+
+    if (vc <= 0 && d1 >= 0 && d3 <= 0)
+        return a + ab * (d1 / (d1 - d3));
+
+    if (vb <= 0 && d2 >= 0 && d6 <= 0)
+        return a + ac * (d2 / (d2 - d6));
+
+    if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0)
+        return a + ab + (ac - ab) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+    auto denominator = 1 / (va + vb + vc);
+    on_face = true;
+
+    return a + ab * (vb * denominator) + ac * (vc * denominator);
+}
+
+
+G4bool BoundingVolumeHierarchy::Contains( const G4ThreeVector& point
+                                        , const Nearest& nearest) const
+{
+    // Nearest to the inside of a face, the face says which side it is on.
+    if (nearest.on_face)
+    {
+        return (point - nearest.point).dot(GetNormal(nearest.triangle)) <= 0;
+    }
+
+    // Nearest to an edge or a corner it doesn't, so the crossings of a ray
+    // are counted instead, trying another direction if the ray passes too
+    // near an edge to be sure.
+    static const G4ThreeVector directions[] = {
+        G4ThreeVector( 0.5773502691896258,  0.5773502691896258,  0.5773502691896258),
+        G4ThreeVector(-0.2672612419124244,  0.5345224838248488,  0.8017837257372732),
+        G4ThreeVector( 0.8164965809277261, -0.4082482904638631,  0.4082482904638631),
+        G4ThreeVector(-0.3015113445777636, -0.9045340337332909,  0.3015113445777636),
+        G4ThreeVector( 0.4850712500726659,  0.7276068751089989, -0.4850712500726659)
+    };
+
+    size_t inside = 0;
+    size_t outside = 0;
+
+    for (auto& direction : directions)
+    {
+        G4bool ambiguous = false;
+        auto crossings = Crossings(point, direction, ambiguous);
+
+        if (!ambiguous)
+        {
+            return crossings % 2 == 1;
+        }
+
+        if (crossings % 2 == 1) inside++;
+        else outside++;
+    }
+
+    return inside > outside;
+}
+
+
+G4double BoundingVolumeHierarchy::Entry( const Node& node
+                                       , const G4double origin[3]
+                                       , const G4double direction[3]
+                                       , const G4double inverse[3]
+                                       , G4double from
+                                       , G4double to)
+{
+    for (size_t axis = 0; axis < 3; axis++)
+    {
+        if (direction[axis] == 0)
+        {
+            if (origin[axis] < node.minimum[axis] || origin[axis] > node.maximum[axis])
+                return kInfinity;
+
+            continue;
+        }
+
+        auto near = (node.minimum[axis] - origin[axis]) * inverse[axis];
+        auto far = (node.maximum[axis] - origin[axis]) * inverse[axis];
+
+        if (near > far)
+        {
+            std::swap(near, far);
+        }
+
+        from = std::max(from, near);
+        to = std::min(to, far);
+
+        if (from > to)
+        {
+            return kInfinity;
+        }
+    }
+
+    return from;
+}
+
+
+G4double BoundingVolumeHierarchy::DistanceSquared(const Node& node, const G4double point[3])
+{
+    G4double distance_squared = 0;
+
+    for (size_t axis = 0; axis < 3; axis++)
+    {
+        auto outside = std::max({ node.minimum[axis] - point[axis], point[axis] - node.maximum[axis], 0.0 });
+        distance_squared += outside * outside;
+    }
+
+    return distance_squared;
+}
+
+
+// The two kernels do the same arithmetic in the same order, so they find
+// exactly the same crossings.
+void BoundingVolumeHierarchy::IntersectScalar( const BoundingVolumeHierarchy& tree
+                                             , size_t first
+                                             , size_t count
+                                             , const G4double origin[3]
+                                             , const G4double direction[3]
+                                             , G4double distances[4]
+                                             , Facing facing)
+{
+    const G4double margin = 1e-12;
+
+    for (size_t lane = 0; lane < 4; lane++)
+    {
+        distances[lane] = kInfinity;
+
+        if (lane >= count)
+        {
+            continue;
+        }
+
+        auto i = first + lane;
+
+        auto e1x = tree.first_edge_[0][i];
+        auto e1y = tree.first_edge_[1][i];
+        auto e1z = tree.first_edge_[2][i];
+
+        auto e2x = tree.second_edge_[0][i];
+        auto e2y = tree.second_edge_[1][i];
+        auto e2z = tree.second_edge_[2][i];
+
+        auto px = direction[1] * e2z - direction[2] * e2y;
+        auto py = direction[2] * e2x - direction[0] * e2z;
+        auto pz = direction[0] * e2y - direction[1] * e2x;
+
+        auto det = e1x * px + e1y * py + e1z * pz;
+
+        if (facing == Against ? !(det > 0) : facing == Along ? !(det < 0) : det == 0)
+        {
+            continue;
+        }
+
+        auto inverse = 1 / det;
+
+        auto sx = origin[0] - tree.corner_[0][i];
+        auto sy = origin[1] - tree.corner_[1][i];
+        auto sz = origin[2] - tree.corner_[2][i];
+
+        auto u = (sx * px + sy * py + sz * pz) * inverse;
+
+        auto qx = sy * e1z - sz * e1y;
+        auto qy = sz * e1x - sx * e1z;
+        auto qz = sx * e1y - sy * e1x;
+
+        auto v = (direction[0] * qx + direction[1] * qy + direction[2] * qz) * inverse;
+        auto t = (e2x * qx + e2y * qy + e2z * qz) * inverse;
+
+        if (u >= -margin && v >= -margin && u + v <= 1 + margin)
+        {
+            distances[lane] = t;
+        }
+    }
+}
+
+
+#ifdef CADMESH_HAS_X86_SIMD
+__attribute__((target("avx")))
+void BoundingVolumeHierarchy::IntersectAVX( const BoundingVolumeHierarchy& tree
+                                          , size_t first
+                                          , size_t count
+                                          , const G4double origin[3]
+                                          , const G4double direction[3]
+                                          , G4double distances[4]
+                                          , Facing facing)
+{
+    auto e1x = _mm256_loadu_pd(tree.first_edge_[0].data() + first);
+    auto e1y = _mm256_loadu_pd(tree.first_edge_[1].data() + first);
+    auto e1z = _mm256_loadu_pd(tree.first_edge_[2].data() + first);
+
+    auto e2x = _mm256_loadu_pd(tree.second_edge_[0].data() + first);
+    auto e2y = _mm256_loadu_pd(tree.second_edge_[1].data() + first);
+    auto e2z = _mm256_loadu_pd(tree.second_edge_[2].data() + first);
+
+    auto dx = _mm256_set1_pd(direction[0]);
+    auto dy = _mm256_set1_pd(direction[1]);
+    auto dz = _mm256_set1_pd(direction[2]);
+
+    auto px = _mm256_sub_pd(_mm256_mul_pd(dy, e2z), _mm256_mul_pd(dz, e2y));
+    auto py = _mm256_sub_pd(_mm256_mul_pd(dz, e2x), _mm256_mul_pd(dx, e2z));
+    auto pz = _mm256_sub_pd(_mm256_mul_pd(dx, e2y), _mm256_mul_pd(dy, e2x));
+
+    auto det = _mm256_add_pd( _mm256_add_pd(_mm256_mul_pd(e1x, px), _mm256_mul_pd(e1y, py))
+                            , _mm256_mul_pd(e1z, pz));
+
+    auto zero = _mm256_setzero_pd();
+    auto one = _mm256_set1_pd(1.0);
+
+    __m256d valid;
+
+    if (facing == Against)
+        valid = _mm256_cmp_pd(det, zero, _CMP_GT_OQ);
+
+    else if (facing == Along)
+        valid = _mm256_cmp_pd(det, zero, _CMP_LT_OQ);
+
+    else
+        valid = _mm256_cmp_pd(det, zero, _CMP_NEQ_UQ);
+
+    auto inverse = _mm256_div_pd(one, det);
+
+    auto sx = _mm256_sub_pd(_mm256_set1_pd(origin[0]), _mm256_loadu_pd(tree.corner_[0].data() + first));
+    auto sy = _mm256_sub_pd(_mm256_set1_pd(origin[1]), _mm256_loadu_pd(tree.corner_[1].data() + first));
+    auto sz = _mm256_sub_pd(_mm256_set1_pd(origin[2]), _mm256_loadu_pd(tree.corner_[2].data() + first));
+
+    auto u = _mm256_mul_pd( _mm256_add_pd( _mm256_add_pd(_mm256_mul_pd(sx, px), _mm256_mul_pd(sy, py))
+                                         , _mm256_mul_pd(sz, pz))
+                          , inverse);
+
+    auto qx = _mm256_sub_pd(_mm256_mul_pd(sy, e1z), _mm256_mul_pd(sz, e1y));
+    auto qy = _mm256_sub_pd(_mm256_mul_pd(sz, e1x), _mm256_mul_pd(sx, e1z));
+    auto qz = _mm256_sub_pd(_mm256_mul_pd(sx, e1y), _mm256_mul_pd(sy, e1x));
+
+    auto v = _mm256_mul_pd( _mm256_add_pd( _mm256_add_pd(_mm256_mul_pd(dx, qx), _mm256_mul_pd(dy, qy))
+                                         , _mm256_mul_pd(dz, qz))
+                          , inverse);
+
+    auto t = _mm256_mul_pd( _mm256_add_pd( _mm256_add_pd(_mm256_mul_pd(e2x, qx), _mm256_mul_pd(e2y, qy))
+                                         , _mm256_mul_pd(e2z, qz))
+                          , inverse);
+
+    auto margin = _mm256_set1_pd(1e-12);
+    auto lowest = _mm256_set1_pd(-1e-12);
+
+    valid = _mm256_and_pd(valid, _mm256_cmp_pd(u, lowest, _CMP_GE_OQ));
+    valid = _mm256_and_pd(valid, _mm256_cmp_pd(v, lowest, _CMP_GE_OQ));
+    valid = _mm256_and_pd(valid, _mm256_cmp_pd(_mm256_add_pd(u, v), _mm256_add_pd(one, margin), _CMP_LE_OQ));
+
+    _mm256_storeu_pd(distances, _mm256_blendv_pd(_mm256_set1_pd(kInfinity), t, valid));
+
+    for (size_t lane = count; lane < 4; lane++)
+    {
+        distances[lane] = kInfinity;
+    }
+}
+
+#else
+// Without x86 intrinsics every kernel is the scalar one.
+void BoundingVolumeHierarchy::IntersectAVX( const BoundingVolumeHierarchy& tree
+                                          , size_t first
+                                          , size_t count
+                                          , const G4double origin[3]
+                                          , const G4double direction[3]
+                                          , G4double distances[4]
+                                          , Facing facing)
+{
+    IntersectScalar(tree, first, count, origin, direction, distances, facing);
+}
+#endif
+
+
+size_t BoundingVolumeHierarchy::GetNumberOfTriangles() const
+{
+    return indices_.size() / 3;
+}
+
+
+size_t BoundingVolumeHierarchy::GetNumberOfNodes() const
+{
+    return nodes_.size();
+}
+
+
+const Points& BoundingVolumeHierarchy::GetPoints() const
+{
+    return points_;
+}
+
+
+const Indices& BoundingVolumeHierarchy::GetIndices() const
+{
+    return indices_;
+}
+
+
+G4ThreeVector BoundingVolumeHierarchy::GetCorner(size_t triangle, size_t corner) const
+{
+    return points_[indices_[3 * triangle + corner]];
+}
+
+
+G4ThreeVector BoundingVolumeHierarchy::GetNormal(size_t triangle) const
+{
+    G4ThreeVector first_edge( first_edge_[0][triangle]
+                            , first_edge_[1][triangle]
+                            , first_edge_[2][triangle]);
+
+    G4ThreeVector second_edge( second_edge_[0][triangle]
+                             , second_edge_[1][triangle]
+                             , second_edge_[2][triangle]);
+
+    return first_edge.cross(second_edge).unit();
+}
+
+
+G4ThreeVector BoundingVolumeHierarchy::GetMinimum() const
+{
+    if (nodes_.empty())
+    {
+        return G4ThreeVector();
+    }
+
+    auto& root = nodes_[0];
+
+    return G4ThreeVector( root.minimum[0] + padding_
+                        , root.minimum[1] + padding_
+                        , root.minimum[2] + padding_);
+}
+
+
+G4ThreeVector BoundingVolumeHierarchy::GetMaximum() const
+{
+    if (nodes_.empty())
+    {
+        return G4ThreeVector();
+    }
+
+    auto& root = nodes_[0];
+
+    return G4ThreeVector( root.maximum[0] - padding_
+                        , root.maximum[1] - padding_
+                        , root.maximum[2] - padding_);
+}
+
+
+size_t BoundingVolumeHierarchy::GetMemoryUsed() const
+{
+    auto bytes = points_.capacity() * sizeof(G4ThreeVector)
+               + indices_.capacity() * sizeof(uint32_t)
+               + nodes_.capacity() * sizeof(Node);
+
+    for (size_t axis = 0; axis < 3; axis++)
+    {
+        bytes += ( corner_[axis].capacity()
+                 + first_edge_[axis].capacity()
+                 + second_edge_[axis].capacity()) * sizeof(G4double);
+    }
+
+    return bytes;
+}
+
+
+BoundingVolumeHierarchy::Kernel BoundingVolumeHierarchy::Best()
+{
+    if (IsSupported(AVX)) return AVX;
+
+    return Scalar;
+}
+
+
+bool BoundingVolumeHierarchy::IsSupported(Kernel kernel)
+{
+    if (kernel == Scalar)
+    {
+        return true;
+    }
+
+#ifdef CADMESH_HAS_X86_SIMD
+    // Reads CPUID once, the first time it is asked.
+    static const bool avx = __builtin_cpu_supports("avx");
+
+    if (kernel == AVX) return avx;
+#endif
+
+    return false;
+}
+
+
+std::string BoundingVolumeHierarchy::KernelName(Kernel kernel)
+{
+    if (kernel == AVX) return "AVX";
+
+    return "Scalar";
+}
+
+} // CADMesh namespace
+
@@ -35,23 +35,50 @@ namespace File
 
 G4bool BuiltInReader::Read(G4String filepath)
 {
-    File::Reader* reader = nullptr;
+    auto reader = ReaderFor(filepath);
+
+    if(!reader->Read(filepath))
+    {
+        return false;
+    }
+
+    // Added one at a time so they are welded here, if asked.
+    SetMeshes(Meshes());
+
+    for (auto mesh : reader->GetMeshes())
+    {
+        AddMesh(mesh);
+    }
+
+    return true;
+}
+
+
+G4bool BuiltInReader::Stream(G4String filepath, MeshSink& sink)
+{
+    return ReaderFor(filepath)->Stream(filepath, sink);
+}
+
+
+std::shared_ptr<Reader> BuiltInReader::ReaderFor(G4String filepath)
+{
+    std::shared_ptr<Reader> reader = nullptr;
 
     auto type = TypeFromName(filepath);
 
     if (type == STL)
     {
-        reader = new File::STLReader();
+        reader = std::make_shared<STLReader>();
     }
 
     else if (type == OBJ)
     {
-        reader = new File::OBJReader();
+        reader = std::make_shared<OBJReader>();
     }
 
     else if (type == PLY)
     {
-        reader = new File::PLYReader();
+        reader = std::make_shared<PLYReader>();
     }
 
     else
@@ -61,14 +88,10 @@ G4bool BuiltInReader::Read(G4String filepath)
                                        , filepath );
     }
 
+    reader->SetNumberOfThreads(GetNumberOfThreads());
+    reader->SetChunkSize(GetChunkSize());
 
-    if(!reader->Read(filepath))
-    {
-        return false;
-    }
-
-    SetMeshes(reader->GetMeshes());
-    return true;
+    return reader;
 }
 
 
@@ -24,6 +24,10 @@
 #include "CADMeshTemplate.hh"
 #include "Exceptions.hh"
 
+// STL //
+#include <algorithm>
+#include <cmath>
+
 
 namespace CADMesh
 {
@@ -159,7 +163,119 @@ CADMeshTemplate<T>::~CADMeshTemplate()
 template <typename T>
 bool CADMeshTemplate<T>::IsValidForNavigation()
 {
-    return reader_->GetMesh()->IsValidForNavigation();
+    for (auto validation : reader_->Validate())
+    {
+        if (!validation.IsValidForNavigation())
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+template <typename T>
+Validations CADMeshTemplate<T>::Validate()
+{
+    return reader_->Validate();
+}
+
+
+template <typename T>
+void CADMeshTemplate<T>::Reorder()
+{
+    for (auto mesh : reader_->GetMeshes())
+    {
+        mesh->Reorder();
+    }
+
+    InvalidateSolids();
+}
+
+
+template <typename T>
+size_t CADMeshTemplate<T>::RepairDegenerateFacets( G4double minimum_area
+                                                 , G4double maximum_aspect_ratio)
+{
+    auto scale = std::abs(scale_);
+    size_t remaining = 0;
+
+    for (auto mesh : reader_->GetMeshes())
+    {
+        auto repair = mesh->RepairDegenerateFacets( minimum_area / (scale * scale)
+                                                  , maximum_aspect_ratio
+                                                  , kCarTolerance / scale);
+
+        if (verbose_ > 0)
+        {
+            G4cout << "CADMesh: found " << repair.GetNumberOfDegenerateFacets()
+                   << " degenerate facets in '" << mesh->GetName() << "'"
+                   << ", collapsed " << repair.GetNumberOfCollapsedEdges() << " edges"
+                   << ", flipped " << repair.GetNumberOfFlippedEdges() << " edges"
+                   << " and removed " << repair.GetNumberOfRemovedFacets() << " facets"
+                   << ", leaving " << repair.GetNumberOfRemainingFacets() << "."
+                   << G4endl;
+        }
+
+        remaining += repair.GetNumberOfRemainingFacets();
+    }
+
+    InvalidateSolids();
+
+    return remaining;
+}
+
+
+template <typename T>
+G4double CADMeshTemplate<T>::Decimate(size_t target, G4double maximum_deviation)
+{
+    auto meshes = reader_->GetMeshes();
+
+    size_t triangles = 0;
+
+    for (auto mesh : meshes)
+    {
+        triangles += mesh->GetNumberOfTriangles();
+    }
+
+    // Meshes released once their solids were built, or read empty, have
+    // nothing to decimate.
+    if (triangles == 0)
+    {
+        return 0;
+    }
+
+    auto scale = std::abs(scale_);
+    G4double hausdorff_distance = 0;
+
+    for (auto mesh : meshes)
+    {
+        auto before = mesh->GetNumberOfTriangles();
+        size_t share = 0;
+
+        if (target > 0)
+        {
+            share = std::max<size_t>(1, target * before / triangles);
+        }
+
+        auto distance = scale * mesh->Decimate(share, maximum_deviation / scale);
+
+        if (verbose_ > 0)
+        {
+            G4cout << "CADMesh: decimated '" << mesh->GetName()
+                   << "' from " << before
+                   << " to " << mesh->GetNumberOfTriangles() << " triangles"
+                   << ", moving its surface by at most " << distance << "."
+                   << G4endl;
+        }
+
+        hausdorff_distance = std::max(hausdorff_distance, distance);
+    }
+
+    InvalidateSolids();
+
+    return hausdorff_distance;
 }
 
 
@@ -194,6 +310,11 @@ G4int CADMeshTemplate<T>::GetVerbose()
 template <typename T>
 void CADMeshTemplate<T>::SetScale(G4double scale)
 {
+    if (scale != scale_)
+    {
+        InvalidateSolids();
+    }
+
     scale_ = scale;
 }
 
@@ -215,6 +336,11 @@ void CADMeshTemplate<T>::SetOffset(G4double x, G4double y, G4double z)
 template <typename T>
 void CADMeshTemplate<T>::SetOffset(G4ThreeVector offset)
 {
+    if (offset != offset_)
+    {
+        InvalidateSolids();
+    }
+
     offset_ = offset;
 }
 
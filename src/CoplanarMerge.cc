@@ -0,0 +1,638 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2011-2020 Christopher M. Poole <mail@christopherpoole.net>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// CADMesh //
+#include "CoplanarMerge.hh"
+#include "Parallel.hh"
+
+// GEANT4 //
+#include "geomdefs.hh"
+
+// STL //
+#include <algorithm>
+#include <cmath>
+
+
+namespace CADMesh
+{
+
+CoplanarMerge::CoplanarMerge( const Points& points
+                            , const Indices& indices
+                            , G4double tolerance
+                            , size_t threads)
+    : tolerance_(tolerance)
+    , points_(points)
+    , triangles_(indices)
+{
+    number_of_facets_before_ = triangles_.size() / 3;
+
+    threads = std::max<size_t>(threads, 1);
+
+    RemovePlanarPoints(threads);
+    PairTriangles(threads);
+
+    Points().swap(points_);
+}
+
+
+void CoplanarMerge::RemovePlanarPoints(size_t threads)
+{
+    auto count = points_.size();
+    auto triangles = triangles_.size() / 3;
+
+    corners_of_.assign(count, std::vector<uint32_t>());
+    replaced_.assign(triangles, false);
+
+    for (size_t t = 0; t < triangles; t++)
+    {
+        for (size_t corner = 0; corner < 3; corner++)
+        {
+            corners_of_[triangles_[3 * t + corner]].push_back(t);
+        }
+    }
+
+    // Which points could be removed is found on several threads. Each is
+    // looked at again when its turn comes, as removing its neighbours
+    // changes the triangles around it.
+    std::vector<char> flat(count);
+
+    ParallelFor(count, threads, [&](size_t point)
+    {
+        std::vector<uint32_t> ring;
+        flat[point] = FlatRing(point, ring);
+    });
+
+    std::vector<uint32_t> ring;
+    Indices replacement;
+
+    for (size_t point = 0; point < count; point++)
+    {
+        if (!flat[point] || !FlatRing(point, ring) || !Triangulate(point, ring, replacement))
+        {
+            continue;
+        }
+
+        auto around = corners_of_[point];
+
+        for (auto t : around)
+        {
+            for (size_t corner = 0; corner < 3; corner++)
+            {
+                auto& corners = corners_of_[triangles_[3 * t + corner]];
+                corners.erase(std::remove(corners.begin(), corners.end(), t), corners.end());
+            }
+        }
+
+        // The new triangles take the places of the first of the old ones.
+        for (size_t k = 0; k < around.size(); k++)
+        {
+            auto t = around[k];
+
+            if (3 * k >= replacement.size())
+            {
+                replaced_[t] = true;
+                continue;
+            }
+
+            for (size_t corner = 0; corner < 3; corner++)
+            {
+                triangles_[3 * t + corner] = replacement[3 * k + corner];
+                corners_of_[replacement[3 * k + corner]].push_back(t);
+            }
+        }
+
+        number_of_points_removed_++;
+    }
+
+    Indices left;
+    left.reserve(triangles_.size() - 6 * number_of_points_removed_);
+
+    for (size_t t = 0; t < triangles; t++)
+    {
+        if (!replaced_[t])
+        {
+            left.insert(left.end(), triangles_.begin() + 3 * t, triangles_.begin() + 3 * t + 3);
+        }
+    }
+
+    triangles_.swap(left);
+
+    std::vector<std::vector<uint32_t> >().swap(corners_of_);
+    std::vector<char>().swap(replaced_);
+}
+
+
+G4bool CoplanarMerge::FlatRing(uint32_t point, std::vector<uint32_t>& ring) const
+{
+    auto& around = corners_of_[point];
+    auto count = around.size();
+
+    ring.clear();
+
+    if (count < 3 || count > 64)
+    {
+        return false;
+    }
+
+    // Each triangle around the point adds the edge opposite it, and they
+    // must join up into one loop.
+    std::vector<std::pair<uint32_t, uint32_t> > edges;
+
+    for (auto t : around)
+    {
+        size_t at = 3;
+
+        for (size_t corner = 0; corner < 3; corner++)
+        {
+            if (triangles_[3 * t + corner] == point)
+            {
+                if (at < 3) return false;
+                at = corner;
+            }
+        }
+
+        auto from = triangles_[3 * t + (at + 1) % 3];
+        auto to = triangles_[3 * t + (at + 2) % 3];
+
+        if (from == to)
+        {
+            return false;
+        }
+
+        edges.push_back(std::make_pair(from, to));
+    }
+
+    auto next = edges[0].first;
+
+    for (size_t k = 0; k < count; k++)
+    {
+        size_t found = 0;
+        uint32_t to = 0;
+
+        for (auto& edge : edges)
+        {
+            if (edge.first == next)
+            {
+                found++;
+                to = edge.second;
+            }
+        }
+
+        if (found != 1)
+        {
+            return false;
+        }
+
+        ring.push_back(next);
+        next = to;
+    }
+
+    if (next != edges[0].first)
+    {
+        return false;
+    }
+
+    auto sorted = ring;
+    std::sort(sorted.begin(), sorted.end());
+
+    if (std::adjacent_find(sorted.begin(), sorted.end()) != sorted.end())
+    {
+        return false;
+    }
+
+    // Every triangle must face the same way, and every point around lie
+    // within the tolerance of the plane through the point.
+    auto& centre = points_[point];
+    G4ThreeVector normal;
+
+    for (auto& edge : edges)
+    {
+        normal += (points_[edge.first] - centre).cross(points_[edge.second] - centre);
+    }
+
+    if (normal.mag2() == 0)
+    {
+        return false;
+    }
+
+    normal = normal.unit();
+
+    for (auto& edge : edges)
+    {
+        auto facing = (points_[edge.first] - centre).cross(points_[edge.second] - centre);
+
+        if (facing.dot(normal) <= 0)
+        {
+            return false;
+        }
+    }
+
+    for (auto p : ring)
+    {
+        if (std::abs((points_[p] - centre).dot(normal)) > tolerance_)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+G4bool CoplanarMerge::Triangulate( uint32_t point
+                                 , const std::vector<uint32_t>& ring
+                                 , Indices& triangles) const
+{
+    triangles.clear();
+
+    auto& centre = points_[point];
+    G4ThreeVector normal;
+
+    for (size_t k = 0; k < ring.size(); k++)
+    {
+        auto a = points_[ring[k]] - centre;
+        auto b = points_[ring[(k + 1) % ring.size()]] - centre;
+
+        normal += a.cross(b);
+    }
+
+    normal = normal.unit();
+
+    // The ring is clipped, an ear at a time, in the plane.
+    G4ThreeVector axis(1, 0, 0);
+
+    if (std::abs(normal.y()) < std::abs(normal.x()) && std::abs(normal.y()) <= std::abs(normal.z()))
+        axis = G4ThreeVector(0, 1, 0);
+
+    else if (std::abs(normal.z()) < std::abs(normal.x()))
+        axis = G4ThreeVector(0, 0, 1);
+
+    auto u = normal.cross(axis).unit();
+    auto v = normal.cross(u);
+
+    std::vector<G4double> s(ring.size());
+    std::vector<G4double> t(ring.size());
+
+    G4double scale = 0;
+
+    for (size_t k = 0; k < ring.size(); k++)
+    {
+        auto d = points_[ring[k]] - centre;
+
+        s[k] = d.dot(u);
+        t[k] = d.dot(v);
+
+        scale = std::max(scale, d.mag2());
+    }
+
+    auto epsilon = 1e-12 * scale;
+
+    auto turn = [&](size_t a, size_t b, size_t c)
+    {
+        return (s[b] - s[a]) * (t[c] - t[a]) - (t[b] - t[a]) * (s[c] - s[a]);
+    };
+
+    std::vector<size_t> polygon(ring.size());
+
+    for (size_t k = 0; k < polygon.size(); k++)
+    {
+        polygon[k] = k;
+    }
+
+    while (polygon.size() > 3)
+    {
+        auto size = polygon.size();
+        G4bool clipped = false;
+
+        for (size_t k = 0; k < size && !clipped; k++)
+        {
+            auto a = polygon[(k + size - 1) % size];
+            auto b = polygon[k];
+            auto c = polygon[(k + 1) % size];
+
+            if (turn(a, b, c) <= epsilon)
+            {
+                continue;
+            }
+
+            G4bool empty = true;
+
+            for (auto other : polygon)
+            {
+                if (other == a || other == b || other == c)
+                {
+                    continue;
+                }
+
+                if (turn(a, b, other) >= 0 && turn(b, c, other) >= 0 && turn(c, a, other) >= 0)
+                {
+                    empty = false;
+                    break;
+                }
+            }
+
+            if (!empty || HasEdge(ring[a], ring[c], point))
+            {
+                continue;
+            }
+
+            triangles.push_back(ring[a]);
+            triangles.push_back(ring[b]);
+            triangles.push_back(ring[c]);
+
+            polygon.erase(polygon.begin() + k);
+            clipped = true;
+        }
+
+        if (!clipped)
+        {
+            return false;
+        }
+    }
+
+    if (turn(polygon[0], polygon[1], polygon[2]) <= epsilon)
+    {
+        return false;
+    }
+
+    // A ring of three would become a triangle that may already be there,
+    // on the other side.
+    if (ring.size() == 3)
+    {
+        for (auto other : corners_of_[ring[0]])
+        {
+            auto corners = triangles_.begin() + 3 * other;
+
+            if ( std::find(corners, corners + 3, point) == corners + 3
+              && std::find(corners, corners + 3, ring[1]) != corners + 3
+              && std::find(corners, corners + 3, ring[2]) != corners + 3)
+            {
+                return false;
+            }
+        }
+    }
+
+    triangles.push_back(ring[polygon[0]]);
+    triangles.push_back(ring[polygon[1]]);
+    triangles.push_back(ring[polygon[2]]);
+
+    return true;
+}
+
+
+G4bool CoplanarMerge::HasEdge(uint32_t a, uint32_t b, uint32_t removed) const
+{
+    for (auto t : corners_of_[a])
+    {
+        auto corners = triangles_.begin() + 3 * t;
+
+        if ( std::find(corners, corners + 3, removed) == corners + 3
+          && std::find(corners, corners + 3, b) != corners + 3)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+void CoplanarMerge::PairTriangles(size_t threads)
+{
+    auto triangles = triangles_.size() / 3;
+
+    // Each triangle's edges, keyed by their points with the lower first.
+    struct Use
+    {
+        uint64_t key;
+        uint64_t use;
+
+        bool operator<(const Use& other) const
+        {
+            return key < other.key || (key == other.key && use < other.use);
+        }
+    };
+
+    std::vector<Use> uses(3 * triangles);
+
+    ParallelFor(3 * triangles, threads, [&](size_t i)
+    {
+        uint64_t from = triangles_[i];
+        uint64_t to = triangles_[i - i % 3 + (i + 1) % 3];
+
+        uses[i] = { std::min(from, to) << 32 | std::max(from, to), i };
+    });
+
+    ParallelSort(uses.begin(), uses.end(), threads, [](const Use& a, const Use& b)
+    {
+        return a < b;
+    });
+
+    // Two triangles that share an edge, and no others, going opposite ways
+    // along it, can make a quadrangle. Geant4 only takes those flat to a
+    // hundredth of kCarTolerance, and convex.
+    struct Pair
+    {
+        G4double length_squared;
+        uint32_t first;
+        uint32_t second;
+        uint32_t corners[4];
+
+        bool operator<(const Pair& other) const
+        {
+            if (length_squared != other.length_squared)
+                return length_squared > other.length_squared;
+
+            if (first != other.first)
+                return first < other.first;
+
+            return second < other.second;
+        }
+    };
+
+    std::vector<Pair> pairs;
+
+    for (size_t k = 0; k + 1 < uses.size(); k++)
+    {
+        if (uses[k].key != uses[k + 1].key)
+        {
+            continue;
+        }
+
+        if ((k > 0 && uses[k - 1].key == uses[k].key) || (k + 2 < uses.size() && uses[k + 2].key == uses[k].key))
+        {
+            continue;
+        }
+
+        auto i = uses[k].use;
+        auto j = uses[k + 1].use;
+
+        auto a = triangles_[i];
+        auto b = triangles_[i - i % 3 + (i + 1) % 3];
+        auto c = triangles_[i - i % 3 + (i + 2) % 3];
+
+        auto d = triangles_[j - j % 3 + (j + 2) % 3];
+
+        if (triangles_[j] != b || a == b || c == d)
+        {
+            continue;
+        }
+
+        Pair pair;
+        pair.length_squared = (points_[b] - points_[a]).mag2();
+        pair.first = i / 3;
+        pair.second = j / 3;
+        pair.corners[0] = a;
+        pair.corners[1] = d;
+        pair.corners[2] = b;
+        pair.corners[3] = c;
+
+        pairs.push_back(pair);
+    }
+
+    std::vector<char> usable(pairs.size());
+
+    ParallelFor(pairs.size(), threads, [&](size_t k)
+    {
+        G4ThreeVector corners[4];
+        G4ThreeVector middle;
+
+        for (size_t corner = 0; corner < 4; corner++)
+        {
+            corners[corner] = points_[pairs[k].corners[corner]];
+            middle += corners[corner] / 4;
+        }
+
+        auto normal = (corners[2] - corners[0]).cross(corners[3] - corners[1]);
+
+        if (normal.mag2() == 0)
+        {
+            usable[k] = false;
+            return;
+        }
+
+        normal = normal.unit();
+
+        G4bool flat = true;
+        G4bool convex = true;
+
+        for (size_t corner = 0; corner < 4; corner++)
+        {
+            auto& before = corners[(corner + 3) % 4];
+            auto& at = corners[corner];
+            auto& after = corners[(corner + 1) % 4];
+
+            flat = flat && std::abs((at - middle).dot(normal)) <= 0.01 * kCarTolerance;
+            convex = convex && (at - before).cross(after - at).dot(normal) > kCarTolerance * (after - before).mag();
+        }
+
+        usable[k] = flat && convex;
+    });
+
+    std::vector<Pair> usable_pairs;
+
+    for (size_t k = 0; k < pairs.size(); k++)
+    {
+        if (usable[k]) usable_pairs.push_back(pairs[k]);
+    }
+
+    std::vector<Pair>().swap(pairs);
+
+    // The longest shared edges first, as they cut across the thinnest
+    // triangles.
+    ParallelSort(usable_pairs.begin(), usable_pairs.end(), threads, [](const Pair& a, const Pair& b)
+    {
+        return a < b;
+    });
+
+    std::vector<char> paired(triangles, false);
+
+    for (auto& pair : usable_pairs)
+    {
+        if (paired[pair.first] || paired[pair.second])
+        {
+            continue;
+        }
+
+        paired[pair.first] = true;
+        paired[pair.second] = true;
+
+        quadrangles_.insert(quadrangles_.end(), pair.corners, pair.corners + 4);
+    }
+
+    Indices left;
+
+    for (size_t t = 0; t < triangles; t++)
+    {
+        if (!paired[t])
+        {
+            left.insert(left.end(), triangles_.begin() + 3 * t, triangles_.begin() + 3 * t + 3);
+        }
+    }
+
+    triangles_.swap(left);
+}
+
+
+const Indices& CoplanarMerge::GetTriangles() const
+{
+    return triangles_;
+}
+
+
+const Indices& CoplanarMerge::GetQuadrangles() const
+{
+    return quadrangles_;
+}
+
+
+size_t CoplanarMerge::GetNumberOfFacetsBefore() const
+{
+    return number_of_facets_before_;
+}
+
+
+size_t CoplanarMerge::GetNumberOfFacets() const
+{
+    return GetNumberOfTriangles() + GetNumberOfQuadrangles();
+}
+
+
+size_t CoplanarMerge::GetNumberOfTriangles() const
+{
+    return triangles_.size() / 3;
+}
+
+
+size_t CoplanarMerge::GetNumberOfQuadrangles() const
+{
+    return quadrangles_.size() / 4;
+}
+
+
+size_t CoplanarMerge::GetNumberOfPointsRemoved() const
+{
+    return number_of_points_removed_;
+}
+
+} // CADMesh namespace
+
@@ -0,0 +1,1123 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2011-2020 Christopher M. Poole <mail@christopherpoole.net>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// CADMesh //
+#include "Decimation.hh"
+#include "BoundingVolumeHierarchy.hh"
+#include "Parallel.hh"
+
+// GEANT4 //
+#include "geomdefs.hh"
+
+// STL //
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <queue>
+
+
+namespace CADMesh
+{
+
+Decimation::Decimation( const Points& points
+                      , const Indices& indices
+                      , size_t target
+                      , G4double maximum_deviation
+                      , size_t threads)
+    : original_points_(points)
+    , original_indices_(indices)
+    , target_(target)
+    , maximum_deviation_(maximum_deviation)
+    , threads_(std::max<size_t>(threads, 1))
+{
+    auto before = GetNumberOfFacetsBefore();
+
+    if ((target_ == 0 && maximum_deviation_ <= 0) || (target_ > 0 && target_ >= before))
+    {
+        points_ = original_points_;
+        triangles_ = original_indices_;
+        number_of_triangles_ = before;
+
+        return;
+    }
+
+    surface_ = std::make_shared<BoundingVolumeHierarchy>( original_points_
+                                                        , original_indices_
+                                                        , 0
+                                                        , threads_);
+
+    // Collapses are checked against samples of both surfaces, but they can
+    // still move further apart between them, so all of both is checked
+    // after. If it moved too far, the collapses are made again with a
+    // tighter limit, and if that still fails the mesh is left as it was.
+    auto limit = maximum_deviation_;
+
+    for (size_t attempt = 0; ; attempt++)
+    {
+        Start();
+
+        auto unlimited = std::numeric_limits<size_t>::max();
+        auto removed = target_ > 0 ? before - target_ : unlimited;
+
+        // Blocks of points are collapsed on their own first, with a share
+        // of the triangles to remove as big as their share of the points.
+        size_t blocks = 0;
+
+        for (auto block : block_)
+        {
+            blocks = std::max<size_t>(blocks, block + 1);
+        }
+
+        if (blocks > 1)
+        {
+            std::vector<std::vector<uint32_t> > points_in(blocks);
+
+            for (size_t p = 0; p < points_.size(); p++)
+            {
+                points_in[block_[p]].push_back(p);
+            }
+
+            std::vector<uint32_t> order(blocks);
+
+            for (size_t b = 0; b < blocks; b++)
+            {
+                order[b] = b;
+            }
+
+            std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+            {
+                return points_in[a].size() > points_in[b].size();
+            });
+
+            ParallelForEach(blocks, threads_, [&](size_t i)
+            {
+                auto block = order[i];
+                auto share = removed;
+
+                if (removed != unlimited)
+                {
+                    share = removed * points_in[block].size() / points_.size();
+                }
+
+                Collapse(points_in[block], block, false, share, limit);
+            });
+
+            number_of_triangles_ = std::count(alive_.begin(), alive_.end(), true);
+        }
+
+        std::vector<uint32_t> everything(points_.size());
+
+        for (size_t p = 0; p < points_.size(); p++)
+        {
+            everything[p] = p;
+        }
+
+        if (target_ > 0)
+        {
+            removed = number_of_triangles_ > target_ ? number_of_triangles_ - target_ : 0;
+        }
+
+        Collapse(everything, 0, true, removed, limit);
+        Finish();
+
+        hausdorff_distance_ = Bound(threads_);
+
+        if (maximum_deviation_ <= 0 || hausdorff_distance_ <= maximum_deviation_)
+        {
+            break;
+        }
+
+        if (attempt == 3)
+        {
+            points_ = original_points_;
+            triangles_ = original_indices_;
+            number_of_triangles_ = before;
+            hausdorff_distance_ = 0;
+
+            break;
+        }
+
+        limit *= std::max(0.25, 0.9 * maximum_deviation_ / hausdorff_distance_);
+    }
+
+    std::vector<char>().swap(alive_);
+    std::vector<char>().swap(removed_);
+    std::vector<char>().swap(frozen_);
+    std::vector<uint32_t>().swap(version_);
+    std::vector<uint32_t>().swap(block_);
+    std::vector<Quadric>().swap(quadrics_);
+    std::vector<std::vector<uint32_t> >().swap(around_);
+    std::vector<std::vector<uint32_t> >().swap(owned_);
+
+    Points().swap(samples_);
+    surface_.reset();
+}
+
+
+void Decimation::Quadric::Add(const Quadric& other)
+{
+    xx += other.xx;
+    xy += other.xy;
+    xz += other.xz;
+    yy += other.yy;
+    yz += other.yz;
+    zz += other.zz;
+
+    x += other.x;
+    y += other.y;
+    z += other.z;
+
+    c += other.c;
+}
+
+
+G4double Decimation::Quadric::Error(const G4ThreeVector& p) const
+{
+    return xx * p.x() * p.x() + 2 * xy * p.x() * p.y() + 2 * xz * p.x() * p.z()
+         + yy * p.y() * p.y() + 2 * yz * p.y() * p.z() + zz * p.z() * p.z()
+         + 2 * (x * p.x() + y * p.y() + z * p.z()) + c;
+}
+
+
+bool Decimation::Candidate::operator<(const Candidate& other) const
+{
+    if (cost != other.cost)
+        return cost > other.cost;
+
+    if (from != other.from)
+        return from > other.from;
+
+    return to > other.to;
+}
+
+
+void Decimation::Start()
+{
+    points_ = original_points_;
+    triangles_ = original_indices_;
+
+    auto count = points_.size();
+    auto triangles = triangles_.size() / 3;
+
+    alive_.assign(triangles, true);
+    removed_.assign(count, false);
+    frozen_.assign(count, false);
+    version_.assign(count, 0);
+    quadrics_.assign(count, Quadric());
+
+    around_.assign(count, std::vector<uint32_t>());
+
+    for (size_t t = 0; t < triangles; t++)
+    {
+        for (size_t corner = 0; corner < 3; corner++)
+        {
+            around_[triangles_[3 * t + corner]].push_back(t);
+        }
+    }
+
+    // Each point starts with the planes of its triangles, weighted by their
+    // areas. Points not on a single fan of triangles, as on a boundary, are
+    // never moved.
+    ParallelFor(count, threads_, [&](size_t p)
+    {
+        removed_[p] = around_[p].empty();
+        frozen_[p] = !removed_[p] && !IsDisk(p);
+
+        for (auto t : around_[p])
+        {
+            auto& a = points_[triangles_[3 * t]];
+            auto& b = points_[triangles_[3 * t + 1]];
+            auto& c = points_[triangles_[3 * t + 2]];
+
+            auto normal = (b - a).cross(c - a);
+            auto area = normal.mag() / 2;
+
+            if (area == 0)
+            {
+                continue;
+            }
+
+            normal = normal.unit();
+
+            auto d = -normal.dot(a);
+
+            Quadric plane;
+            plane.xx = area * normal.x() * normal.x();
+            plane.xy = area * normal.x() * normal.y();
+            plane.xz = area * normal.x() * normal.z();
+            plane.yy = area * normal.y() * normal.y();
+            plane.yz = area * normal.y() * normal.z();
+            plane.zz = area * normal.z() * normal.z();
+            plane.x = area * d * normal.x();
+            plane.y = area * d * normal.y();
+            plane.z = area * d * normal.z();
+            plane.c = area * d * d;
+
+            quadrics_[p].Add(plane);
+        }
+    });
+
+    // The original surface is sampled at its points, and at the centre and
+    // the middle of each edge of its triangles.
+    samples_.clear();
+    owned_.clear();
+
+    if (maximum_deviation_ > 0)
+    {
+        owned_.assign(triangles, std::vector<uint32_t>());
+
+        for (size_t p = 0; p < count; p++)
+        {
+            if (!around_[p].empty())
+            {
+                owned_[around_[p][0]].push_back(samples_.size());
+                samples_.push_back(points_[p]);
+            }
+        }
+
+        for (size_t t = 0; t < triangles; t++)
+        {
+            auto& a = points_[triangles_[3 * t]];
+            auto& b = points_[triangles_[3 * t + 1]];
+            auto& c = points_[triangles_[3 * t + 2]];
+
+            owned_[t].push_back(samples_.size());
+            samples_.push_back((a + b + c) / 3);
+
+            for (size_t corner = 0; corner < 3; corner++)
+            {
+                auto from = triangles_[3 * t + corner];
+                auto to = triangles_[3 * t + (corner + 1) % 3];
+
+                if (from < to)
+                {
+                    owned_[t].push_back(samples_.size());
+                    samples_.push_back((points_[from] + points_[to]) / 2);
+                }
+            }
+        }
+    }
+
+    // The blocks are a grid over the bounding box, with enough cells for
+    // several thousand points in each, whatever the number of threads.
+    G4ThreeVector minimum(kInfinity, kInfinity, kInfinity);
+    G4ThreeVector maximum(-kInfinity, -kInfinity, -kInfinity);
+
+    for (auto& point : points_)
+    {
+        minimum = G4ThreeVector( std::min(minimum.x(), point.x())
+                               , std::min(minimum.y(), point.y())
+                               , std::min(minimum.z(), point.z()));
+
+        maximum = G4ThreeVector( std::max(maximum.x(), point.x())
+                               , std::max(maximum.y(), point.y())
+                               , std::max(maximum.z(), point.z()));
+    }
+
+    auto cells = std::max<size_t>(1, (size_t) std::cbrt(count / 8192.0));
+    auto extent = maximum - minimum;
+
+    auto cell_of = [&](G4double value, G4double low, G4double size)
+    {
+        if (size <= 0)
+        {
+            return (size_t) 0;
+        }
+
+        return std::min(cells - 1, (size_t) ((value - low) / size * cells));
+    };
+
+    block_.resize(count);
+
+    ParallelFor(count, threads_, [&](size_t p)
+    {
+        auto& point = points_[p];
+
+        block_[p] = ( cell_of(point.x(), minimum.x(), extent.x()) * cells
+                    + cell_of(point.y(), minimum.y(), extent.y())) * cells
+                    + cell_of(point.z(), minimum.z(), extent.z());
+    });
+
+    number_of_triangles_ = triangles;
+}
+
+
+void Decimation::Collapse( const std::vector<uint32_t>& points
+                         , uint32_t block
+                         , G4bool everywhere
+                         , size_t removed
+                         , G4double limit)
+{
+    std::priority_queue<Candidate> queue;
+    std::vector<uint32_t> neighbours;
+
+    auto push = [&](uint32_t from)
+    {
+        Neighbours(from, neighbours);
+
+        for (auto to : neighbours)
+        {
+            if (frozen_[to] || (!everywhere && block_[to] != block))
+            {
+                continue;
+            }
+
+            Candidate candidate;
+
+            if (Cost(from, to, candidate))
+            {
+                queue.push(candidate);
+            }
+        }
+    };
+
+    for (auto point : points)
+    {
+        if (!removed_[point] && !frozen_[point])
+        {
+            push(point);
+        }
+    }
+
+    size_t gone = 0;
+
+    while (!queue.empty() && gone < removed)
+    {
+        auto candidate = queue.top();
+        queue.pop();
+
+        // Either end having moved since makes the candidate stale.
+        if ( removed_[candidate.from] || removed_[candidate.to]
+          || version_[candidate.from] != candidate.from_version
+          || version_[candidate.to] != candidate.to_version)
+        {
+            continue;
+        }
+
+        if (!CanCollapse(candidate, block, everywhere, limit))
+        {
+            continue;
+        }
+
+        Apply(candidate, limit);
+        gone += 2;
+
+        push(candidate.to);
+    }
+
+    if (everywhere)
+    {
+        number_of_triangles_ -= std::min(gone, number_of_triangles_);
+    }
+}
+
+
+G4bool Decimation::Cost(uint32_t from, uint32_t to, Candidate& candidate) const
+{
+    auto quadric = quadrics_[from];
+    quadric.Add(quadrics_[to]);
+
+    auto& a = points_[from];
+    auto& b = points_[to];
+    auto middle = (a + b) / 2;
+
+    // The point with the least error, if the quadric has one, and it is
+    // near the edge. Otherwise the best of the ends and the middle.
+    auto& q = quadric;
+
+    auto determinant = q.xx * (q.yy * q.zz - q.yz * q.yz)
+                     - q.xy * (q.xy * q.zz - q.yz * q.xz)
+                     + q.xz * (q.xy * q.yz - q.yy * q.xz);
+
+    auto scale = (q.xx + q.yy + q.zz) / 3;
+
+    G4ThreeVector best = middle;
+    G4double cost = q.Error(middle);
+
+    if (std::abs(determinant) > 1e-12 * scale * scale * scale && scale > 0)
+    {
+        auto inverse = 1 / determinant;
+
+        G4ThreeVector optimum(
+            -inverse * ( q.x * (q.yy * q.zz - q.yz * q.yz)
+                       - q.xy * (q.y * q.zz - q.yz * q.z)
+                       + q.xz * (q.y * q.yz - q.yy * q.z)),
+            -inverse * ( q.xx * (q.y * q.zz - q.z * q.yz)
+                       - q.x * (q.xy * q.zz - q.yz * q.xz)
+                       + q.xz * (q.xy * q.z - q.y * q.xz)),
+            -inverse * ( q.xx * (q.yy * q.z - q.yz * q.y)
+                       - q.xy * (q.xy * q.z - q.y * q.xz)
+                       + q.x * (q.xy * q.yz - q.yy * q.xz)));
+
+        if ((optimum - middle).mag() <= (b - a).mag())
+        {
+            best = optimum;
+            cost = q.Error(optimum);
+        }
+    }
+
+    for (auto& end : { a, b })
+    {
+        auto error = q.Error(end);
+
+        if (error < cost)
+        {
+            best = end;
+            cost = error;
+        }
+    }
+
+    if (!std::isfinite(cost))
+    {
+        return false;
+    }
+
+    candidate.cost = std::max(cost, 0.0);
+    candidate.from = from;
+    candidate.to = to;
+    candidate.from_version = version_[from];
+    candidate.to_version = version_[to];
+    candidate.position = best;
+
+    return true;
+}
+
+
+G4bool Decimation::CanCollapse( const Candidate& candidate
+                              , uint32_t block
+                              , G4bool everywhere
+                              , G4double limit) const
+{
+    auto from = candidate.from;
+    auto to = candidate.to;
+
+    if (frozen_[from] || frozen_[to])
+    {
+        return false;
+    }
+
+    // Within a block, every point the collapse touches must be in it, so
+    // that no other thread touches them.
+    if (!everywhere)
+    {
+        for (auto point : { from, to })
+        {
+            for (auto t : around_[point])
+            {
+                for (size_t corner = 0; corner < 3; corner++)
+                {
+                    if (block_[triangles_[3 * t + corner]] != block)
+                    {
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+
+    // The edge must have one triangle on each side, and the points around
+    // both ends only the two opposite it in common, or the collapse would
+    // pinch the surface.
+    std::vector<uint32_t> opposite;
+
+    for (auto t : around_[from])
+    {
+        auto corners = triangles_.begin() + 3 * t;
+
+        if (std::find(corners, corners + 3, to) == corners + 3)
+        {
+            continue;
+        }
+
+        for (size_t corner = 0; corner < 3; corner++)
+        {
+            if (corners[corner] != from && corners[corner] != to)
+            {
+                opposite.push_back(corners[corner]);
+            }
+        }
+    }
+
+    if (opposite.size() != 2 || opposite[0] == opposite[1])
+    {
+        return false;
+    }
+
+    std::sort(opposite.begin(), opposite.end());
+
+    std::vector<uint32_t> around_from;
+    std::vector<uint32_t> around_to;
+    std::vector<uint32_t> common;
+
+    Neighbours(from, around_from);
+    Neighbours(to, around_to);
+
+    std::set_intersection( around_from.begin(), around_from.end()
+                         , around_to.begin(), around_to.end()
+                         , std::back_inserter(common));
+
+    if (common != opposite)
+    {
+        return false;
+    }
+
+    // Each opposite point loses an edge, and none may be left with fewer
+    // than three.
+    std::vector<uint32_t> neighbours;
+
+    for (auto point : opposite)
+    {
+        Neighbours(point, neighbours);
+
+        if (neighbours.size() <= 3)
+        {
+            return false;
+        }
+    }
+
+    if (around_from.size() + around_to.size() - 4 < 3)
+    {
+        return false;
+    }
+
+    // No triangle that is left may turn over, or become a sliver.
+    auto& position = candidate.position;
+
+    auto quality = [](const G4ThreeVector& a, const G4ThreeVector& b, const G4ThreeVector& c)
+    {
+        auto lengths = (b - a).mag2() + (c - b).mag2() + (a - c).mag2();
+
+        if (lengths == 0)
+        {
+            return 0.0;
+        }
+
+        return 2 * std::sqrt(3.0) * (b - a).cross(c - a).mag() / lengths;
+    };
+
+    std::vector<uint32_t> kept;
+
+    for (auto point : { from, to })
+    {
+        for (auto t : around_[point])
+        {
+            auto corners = triangles_.begin() + 3 * t;
+
+            auto has_from = std::find(corners, corners + 3, from) != corners + 3;
+            auto has_to = std::find(corners, corners + 3, to) != corners + 3;
+
+            if (has_from && has_to)
+            {
+                continue;
+            }
+
+            G4ThreeVector before[3];
+            G4ThreeVector after[3];
+
+            for (size_t corner = 0; corner < 3; corner++)
+            {
+                before[corner] = points_[corners[corner]];
+                after[corner] = corners[corner] == point ? position : before[corner];
+            }
+
+            auto normal_before = (before[1] - before[0]).cross(before[2] - before[0]);
+            auto normal_after = (after[1] - after[0]).cross(after[2] - after[0]);
+
+            if (normal_after.dot(normal_before) <= 0)
+            {
+                return false;
+            }
+
+            auto quality_before = quality(before[0], before[1], before[2]);
+
+            if (quality(after[0], after[1], after[2]) < std::min(0.1, quality_before))
+            {
+                return false;
+            }
+
+            kept.push_back(t);
+        }
+    }
+
+    if (limit <= 0)
+    {
+        return true;
+    }
+
+    // The triangles left must stay within the limit of the original
+    // surface, as must the samples of it nearest the triangles that change.
+    if (surface_->Closest(position, limit).triangle == BoundingVolumeHierarchy::none)
+    {
+        return false;
+    }
+
+    for (auto k : kept)
+    {
+        G4ThreeVector corners[3];
+
+        for (size_t corner = 0; corner < 3; corner++)
+        {
+            auto index = triangles_[3 * k + corner];
+            corners[corner] = (index == from || index == to) ? position : points_[index];
+        }
+
+        G4ThreeVector probes[4] = { (corners[0] + corners[1] + corners[2]) / 3
+                                  , (corners[0] + corners[1]) / 2
+                                  , (corners[1] + corners[2]) / 2
+                                  , (corners[2] + corners[0]) / 2 };
+
+        for (auto& probe : probes)
+        {
+            if (surface_->Closest(probe, limit).triangle == BoundingVolumeHierarchy::none)
+            {
+                return false;
+            }
+        }
+    }
+
+    for (auto point : { from, to })
+    {
+        for (auto t : around_[point])
+        {
+            for (auto sample : owned_[t])
+            {
+                auto& p = samples_[sample];
+                auto nearest = kInfinity;
+
+                for (auto k : kept)
+                {
+                    G4ThreeVector corners[3];
+
+                    for (size_t corner = 0; corner < 3; corner++)
+                    {
+                        auto index = triangles_[3 * k + corner];
+                        corners[corner] = (index == from || index == to) ? position : points_[index];
+                    }
+
+                    G4bool on_face;
+                    auto closest = BoundingVolumeHierarchy::ClosestPoint( p
+                                                                        , corners[0]
+                                                                        , corners[1] - corners[0]
+                                                                        , corners[2] - corners[0]
+                                                                        , on_face);
+
+                    nearest = std::min(nearest, (p - closest).mag2());
+                }
+
+                if (nearest > limit * limit)
+                {
+                    return false;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+
+void Decimation::Apply(const Candidate& candidate, G4double limit)
+{
+    auto from = candidate.from;
+    auto to = candidate.to;
+
+    std::vector<uint32_t> moved;
+
+    if (limit > 0)
+    {
+        for (auto point : { from, to })
+        {
+            for (auto t : around_[point])
+            {
+                moved.insert(moved.end(), owned_[t].begin(), owned_[t].end());
+                owned_[t].clear();
+            }
+        }
+    }
+
+    auto around = around_[from];
+
+    for (auto t : around)
+    {
+        auto corners = triangles_.begin() + 3 * t;
+
+        if (std::find(corners, corners + 3, to) != corners + 3)
+        {
+            alive_[t] = false;
+
+            for (size_t corner = 0; corner < 3; corner++)
+            {
+                if (corners[corner] == from)
+                {
+                    continue;
+                }
+
+                auto& list = around_[corners[corner]];
+                list.erase(std::remove(list.begin(), list.end(), t), list.end());
+            }
+
+            continue;
+        }
+
+        std::replace(corners, corners + 3, from, to);
+        around_[to].push_back(t);
+    }
+
+    around_[from].clear();
+    removed_[from] = true;
+
+    points_[to] = candidate.position;
+    quadrics_[to].Add(quadrics_[from]);
+
+    version_[from]++;
+    version_[to]++;
+
+    // Each sample goes to whichever triangle is now nearest it.
+    for (auto sample : moved)
+    {
+        auto& p = samples_[sample];
+
+        auto nearest = kInfinity;
+        auto owner = around_[to].front();
+
+        for (auto t : around_[to])
+        {
+            auto& a = points_[triangles_[3 * t]];
+            auto& b = points_[triangles_[3 * t + 1]];
+            auto& c = points_[triangles_[3 * t + 2]];
+
+            G4bool on_face;
+            auto closest = BoundingVolumeHierarchy::ClosestPoint(p, a, b - a, c - a, on_face);
+            auto distance = (p - closest).mag2();
+
+            if (distance < nearest)
+            {
+                nearest = distance;
+                owner = t;
+            }
+        }
+
+        owned_[owner].push_back(sample);
+    }
+}
+
+
+void Decimation::Neighbours(uint32_t point, std::vector<uint32_t>& neighbours) const
+{
+    neighbours.clear();
+
+    for (auto t : around_[point])
+    {
+        for (size_t corner = 0; corner < 3; corner++)
+        {
+            auto other = triangles_[3 * t + corner];
+
+            if (other != point)
+            {
+                neighbours.push_back(other);
+            }
+        }
+    }
+
+    std::sort(neighbours.begin(), neighbours.end());
+    neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+}
+
+
+G4bool Decimation::IsDisk(uint32_t point) const
+{
+    auto& around = around_[point];
+
+    if (around.size() < 3)
+    {
+        return false;
+    }
+
+    // The edges opposite the point, which go once round it if it is in the
+    // middle of a single fan.
+    std::vector<std::pair<uint32_t, uint32_t> > edges;
+
+    for (auto t : around)
+    {
+        size_t at = 3;
+
+        for (size_t corner = 0; corner < 3; corner++)
+        {
+            if (triangles_[3 * t + corner] == point)
+            {
+                if (at < 3) return false;
+                at = corner;
+            }
+        }
+
+        edges.push_back(std::make_pair( triangles_[3 * t + (at + 1) % 3]
+                                      , triangles_[3 * t + (at + 2) % 3]));
+    }
+
+    std::sort(edges.begin(), edges.end());
+
+    for (size_t k = 1; k < edges.size(); k++)
+    {
+        if (edges[k].first == edges[k - 1].first)
+        {
+            return false;
+        }
+    }
+
+    auto next = edges[0].first;
+
+    for (size_t k = 0; k < edges.size(); k++)
+    {
+        auto edge = std::lower_bound( edges.begin(), edges.end()
+                                    , std::make_pair(next, (uint32_t) 0));
+
+        if (edge == edges.end() || edge->first != next)
+        {
+            return false;
+        }
+
+        next = edge->second;
+    }
+
+    return next == edges[0].first;
+}
+
+
+G4double Decimation::Bound(size_t threads) const
+{
+    auto& before = *surface_;
+    BoundingVolumeHierarchy after(points_, triangles_, 0, threads);
+
+    // How far any point of one surface is from the other. The distance from
+    // a triangle to a point is largest at one of the triangle's corners, so
+    // the furthest corner from a triangle near it bounds how far the points
+    // of a triangle are, as does the distance from its centre plus how far
+    // its corners are from that. Triangles are cut into four until one of
+    // those is no more than a little over the furthest distance found from
+    // any point, or they are very small.
+    // Found to within a thousandth of the size of the mesh, or a hundredth
+    // of the maximum deviation if that is less.
+    auto precision = 1e-3 * (before.GetMaximum() - before.GetMinimum()).mag();
+
+    if (maximum_deviation_ > 0)
+    {
+        precision = std::min(precision, 0.01 * maximum_deviation_);
+    }
+
+    auto furthest = [&]( const Points& points
+                       , const Indices& indices
+                       , const BoundingVolumeHierarchy& other)
+    {
+        auto distance = [&](const G4ThreeVector& point)
+        {
+            return std::sqrt(other.Closest(point).distance_squared);
+        };
+
+        std::vector<G4double> found(points.size(), 0);
+
+        ParallelFor(points.size(), threads, [&](size_t p)
+        {
+            found[p] = distance(points[p]);
+        });
+
+        G4double lower = 0;
+
+        for (auto f : found)
+        {
+            lower = std::max(lower, f);
+        }
+
+        struct Part
+        {
+            G4ThreeVector corners[3];
+            size_t depth;
+        };
+
+        std::vector<G4double> bounds(indices.size() / 3, 0);
+
+        ParallelFor(bounds.size(), threads, [&](size_t t)
+        {
+            std::vector<Part> parts;
+            parts.push_back({ { points[indices[3 * t]]
+                              , points[indices[3 * t + 1]]
+                              , points[indices[3 * t + 2]] }, 0 });
+
+            auto enough = lower;
+
+            while (!parts.empty())
+            {
+                auto part = parts.back();
+                parts.pop_back();
+
+                auto& a = part.corners[0];
+                auto& b = part.corners[1];
+                auto& c = part.corners[2];
+
+                auto centre = (a + b + c) / 3;
+                auto nearest = other.Closest(centre);
+                auto at_centre = std::sqrt(nearest.distance_squared);
+
+                enough = std::max(enough, at_centre);
+
+                auto spread = std::max({ (a - centre).mag(), (b - centre).mag(), (c - centre).mag() });
+                auto upper = at_centre + spread;
+
+                if (nearest.triangle != BoundingVolumeHierarchy::none)
+                {
+                    auto corner = other.GetCorner(nearest.triangle, 0);
+                    auto ab = other.GetCorner(nearest.triangle, 1) - corner;
+                    auto ac = other.GetCorner(nearest.triangle, 2) - corner;
+
+                    G4double worst = 0;
+
+                    for (auto& point : part.corners)
+                    {
+                        G4bool on_face;
+                        auto closest = BoundingVolumeHierarchy::ClosestPoint(point, corner, ab, ac, on_face);
+
+                        worst = std::max(worst, (point - closest).mag());
+                    }
+
+                    upper = std::min(upper, worst);
+                }
+
+                if (upper <= 1.01 * enough + precision || part.depth == 24)
+                {
+                    bounds[t] = std::max(bounds[t], upper);
+                    continue;
+                }
+
+                // Split across the longest edge, so that slivers become
+                // small quickly.
+                size_t longest = 0;
+
+                for (size_t k = 1; k < 3; k++)
+                {
+                    if ( (part.corners[(k + 1) % 3] - part.corners[k]).mag2()
+                       > (part.corners[(longest + 1) % 3] - part.corners[longest]).mag2())
+                    {
+                        longest = k;
+                    }
+                }
+
+                auto& from = part.corners[longest];
+                auto& to = part.corners[(longest + 1) % 3];
+                auto& other_corner = part.corners[(longest + 2) % 3];
+                auto middle = (from + to) / 2;
+
+                parts.push_back({ { from, middle, other_corner }, part.depth + 1 });
+                parts.push_back({ { middle, to, other_corner }, part.depth + 1 });
+            }
+        });
+
+        for (auto b : bounds)
+        {
+            lower = std::max(lower, b);
+        }
+
+        return lower;
+    };
+
+    return std::max( furthest(original_points_, original_indices_, after)
+                   , furthest(points_, triangles_, before));
+}
+
+
+void Decimation::Finish()
+{
+    // The points and triangles left keep their order.
+    std::vector<uint32_t> renumbered(points_.size(), 0);
+    std::vector<char> used(points_.size(), false);
+
+    Indices triangles;
+    triangles.reserve(3 * number_of_triangles_);
+
+    for (size_t t = 0; t < alive_.size(); t++)
+    {
+        if (!alive_[t])
+        {
+            continue;
+        }
+
+        for (size_t corner = 0; corner < 3; corner++)
+        {
+            auto point = triangles_[3 * t + corner];
+
+            used[point] = true;
+            triangles.push_back(point);
+        }
+    }
+
+    Points points;
+
+    for (size_t p = 0; p < points_.size(); p++)
+    {
+        if (used[p])
+        {
+            renumbered[p] = points.size();
+            points.push_back(points_[p]);
+        }
+    }
+
+    for (auto& index : triangles)
+    {
+        index = renumbered[index];
+    }
+
+    points_.swap(points);
+    triangles_.swap(triangles);
+
+    number_of_triangles_ = triangles_.size() / 3;
+}
+
+
+const Points& Decimation::GetPoints() const
+{
+    return points_;
+}
+
+
+const Indices& Decimation::GetIndices() const
+{
+    return triangles_;
+}
+
+
+size_t Decimation::GetNumberOfFacetsBefore() const
+{
+    return original_indices_.size() / 3;
+}
+
+
+size_t Decimation::GetNumberOfFacets() const
+{
+    return number_of_triangles_;
+}
+
+
+G4double Decimation::GetHausdorffDistance() const
+{
+    return hausdorff_distance_;
+}
+
+} // CADMesh namespace
+
@@ -0,0 +1,501 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2011-2020 Christopher M. Poole <mail@christopherpoole.net>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// CADMesh //
+#include "DistanceField.hh"
+#include "Exceptions.hh"
+#include "Parallel.hh"
+
+// STL //
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+
+namespace CADMesh
+{
+
+DistanceField::DistanceField( const BoundingVolumeHierarchy& hierarchy
+                            , G4double cell_size
+                            , size_t resolution
+                            , size_t threads)
+    : cell_size_(cell_size)
+    , resolution_(resolution)
+{
+    if (!(cell_size > 0) || resolution == 0 || resolution > 255)
+    {
+        Exceptions::InvalidDistanceField("DistanceField", "The cell size must be positive, and the resolution between 1 and 255.");
+    }
+
+    if (hierarchy.GetNumberOfTriangles() == 0)
+    {
+        Exceptions::InvalidDistanceField("DistanceField", "The mesh has no triangles.");
+    }
+
+    number_of_triangles_ = hierarchy.GetNumberOfTriangles();
+    mesh_hash_ = Hash(hierarchy);
+    minimum_ = hierarchy.GetMinimum();
+    maximum_ = hierarchy.GetMaximum();
+
+    // A cell more on every side, so that anywhere outside the field is at
+    // least a cell from the surface.
+    origin_ = minimum_ - G4ThreeVector(cell_size, cell_size, cell_size);
+
+    G4double cells = 1;
+
+    for (size_t axis = 0; axis < 3; axis++)
+    {
+        auto extent = maximum_[axis] - minimum_[axis] + 2 * cell_size;
+        auto dimension = std::max(std::ceil(extent / cell_size), 1.0);
+
+        cells *= dimension;
+
+        if (cells > (1 << 30))
+        {
+            Exceptions::InvalidDistanceField("DistanceField", "The cells are too small for the size of the mesh.");
+        }
+
+        dimensions_[axis] = dimension;
+    }
+
+    centres_.resize(cells);
+    bricks_.resize(cells);
+
+    ParallelFor(centres_.size(), threads, [&](size_t cell)
+    {
+        auto centre = Corner(cell) + G4ThreeVector(1, 1, 1) * (cell_size_ / 2);
+        auto nearest = hierarchy.Closest(centre);
+        auto distance = std::sqrt(nearest.distance_squared);
+
+        centres_[cell] = Lower(hierarchy.Contains(centre, nearest) ? -distance : distance);
+    });
+
+    // Cells the surface may come within a cell of get a brick, so the rest
+    // are all at least a cell from it everywhere.
+    auto half_diagonal = std::sqrt(3.0) * cell_size_ / 2;
+
+    std::vector<size_t> cells_with_bricks;
+
+    for (size_t cell = 0; cell < centres_.size(); cell++)
+    {
+        if (std::abs(centres_[cell]) <= half_diagonal + cell_size_)
+        {
+            bricks_[cell] = cells_with_bricks.size();
+            cells_with_bricks.push_back(cell);
+        }
+
+        else
+        {
+            bricks_[cell] = none;
+        }
+    }
+
+    auto side = resolution_ + 1;
+    auto step = cell_size_ / resolution_;
+
+    samples_.resize(cells_with_bricks.size() * side * side * side);
+
+    ParallelFor(cells_with_bricks.size(), threads, [&](size_t brick)
+    {
+        auto corner = Corner(cells_with_bricks[brick]);
+        auto sample = samples_.begin() + brick * side * side * side;
+
+        for (size_t k = 0; k < side; k++)
+        {
+            for (size_t j = 0; j < side; j++)
+            {
+                for (size_t i = 0; i < side; i++)
+                {
+                    auto position = corner + G4ThreeVector(i, j, k) * step;
+                    auto nearest = hierarchy.Closest(position);
+                    auto distance = std::sqrt(nearest.distance_squared);
+
+                    (*sample++) = Lower(hierarchy.Contains(position, nearest) ? -distance : distance);
+                }
+            }
+        }
+    });
+}
+
+
+G4double DistanceField::Safety(const G4ThreeVector& point) const
+{
+    size_t cell = 0;
+
+    if (!Cell(point, cell))
+    {
+        // Anywhere outside the field is further from the surface than from
+        // the bounding box of the mesh.
+        G4double distance_squared = 0;
+
+        for (size_t axis = 0; axis < 3; axis++)
+        {
+            auto outside = std::max({ minimum_[axis] - point[axis], point[axis] - maximum_[axis], 0.0 });
+            distance_squared += outside * outside;
+        }
+
+        return std::sqrt(distance_squared);
+    }
+
+    auto corner = Corner(cell);
+    auto brick = bricks_[cell];
+
+    if (brick == none)
+    {
+        auto centre = corner + G4ThreeVector(1, 1, 1) * (cell_size_ / 2);
+
+        return std::abs(centres_[cell]) - (point - centre).mag();
+    }
+
+    G4int side = 0;
+    auto bound = Bound(point, cell, side);
+
+    return bound >= cell_size_ / resolution_ ? bound : -1;
+}
+
+
+G4int DistanceField::Side(const G4ThreeVector& point) const
+{
+    size_t cell = 0;
+
+    if (!Cell(point, cell))
+    {
+        return 1;
+    }
+
+    if (bricks_[cell] != none)
+    {
+        G4int side = 0;
+        auto bound = Bound(point, cell, side);
+
+        return bound >= cell_size_ / resolution_ ? side : 0;
+    }
+
+    return centres_[cell] < 0 ? -1 : 1;
+}
+
+
+G4double DistanceField::Bound(const G4ThreeVector& point, size_t cell, G4int& side) const
+{
+    auto corner = Corner(cell);
+
+    size_t samples_per_side = resolution_ + 1;
+    auto step = cell_size_ / resolution_;
+
+    size_t voxel[3];
+
+    for (size_t axis = 0; axis < 3; axis++)
+    {
+        auto x = (point[axis] - corner[axis]) / step;
+        voxel[axis] = std::min<size_t>(std::max(x, 0.0), resolution_ - 1);
+    }
+
+    auto samples = samples_.data() + bricks_[cell] * samples_per_side * samples_per_side * samples_per_side;
+
+    // Each corner of the voxel bounds the distance at the point. The best
+    // of them is kept. Within that bound of the corner the surface isn't
+    // crossed, so the point is on the same side as the corner.
+    G4double bound = -kInfinity;
+
+    for (size_t k = voxel[2]; k <= voxel[2] + 1; k++)
+    {
+        for (size_t j = voxel[1]; j <= voxel[1] + 1; j++)
+        {
+            for (size_t i = voxel[0]; i <= voxel[0] + 1; i++)
+            {
+                auto position = corner + G4ThreeVector(i, j, k) * step;
+                auto sample = samples[(k * samples_per_side + j) * samples_per_side + i];
+                auto corner_bound = std::abs(sample) - (point - position).mag();
+
+                if (corner_bound > bound)
+                {
+                    bound = corner_bound;
+                    side = sample < 0 ? -1 : 1;
+                }
+            }
+        }
+    }
+
+    return bound;
+}
+
+
+G4bool DistanceField::IsFor(const BoundingVolumeHierarchy& hierarchy) const
+{
+    return number_of_triangles_ == hierarchy.GetNumberOfTriangles()
+        && minimum_ == hierarchy.GetMinimum()
+        && maximum_ == hierarchy.GetMaximum()
+        && mesh_hash_ == Hash(hierarchy);
+}
+
+
+uint64_t DistanceField::Hash(const BoundingVolumeHierarchy& hierarchy)
+{
+    uint64_t hash = 0xcbf29ce484222325;
+
+    auto add = [&](const void* data, size_t bytes)
+    {
+        auto p = (const unsigned char*) data;
+
+        for (size_t i = 0; i < bytes; i++)
+        {
+            hash = (hash ^ p[i]) * 0x100000001b3;
+        }
+    };
+
+    for (auto& point : hierarchy.GetPoints())
+    {
+        G4double coordinates[3] = { point.x(), point.y(), point.z() };
+        add(coordinates, sizeof(coordinates));
+    }
+
+    auto& indices = hierarchy.GetIndices();
+    add(indices.data(), indices.size() * sizeof(uint32_t));
+
+    return hash;
+}
+
+
+void DistanceField::Write(std::ostream& stream) const
+{
+    auto write = [&](const void* data, size_t bytes)
+    {
+        stream.write((const char*) data, bytes);
+    };
+
+    G4double geometry[10] = {
+        origin_.x(), origin_.y(), origin_.z(),
+        minimum_.x(), minimum_.y(), minimum_.z(),
+        maximum_.x(), maximum_.y(), maximum_.z(),
+        cell_size_
+    };
+
+    uint64_t sizes[3] = { centres_.size(), bricks_.size(), samples_.size() };
+
+    write(Tag(), std::strlen(Tag()));
+    write(geometry, sizeof(geometry));
+    write(dimensions_, sizeof(dimensions_));
+    write(&resolution_, sizeof(resolution_));
+    write(&number_of_triangles_, sizeof(number_of_triangles_));
+    write(&mesh_hash_, sizeof(mesh_hash_));
+    write(sizes, sizeof(sizes));
+
+    write(centres_.data(), centres_.size() * sizeof(float));
+    write(bricks_.data(), bricks_.size() * sizeof(uint32_t));
+    write(samples_.data(), samples_.size() * sizeof(float));
+}
+
+
+void DistanceField::Save(G4String filepath) const
+{
+    std::ofstream file(filepath, std::ios::binary);
+
+    if (file)
+    {
+        Write(file);
+    }
+
+    if (!file)
+    {
+        Exceptions::InvalidDistanceField("DistanceField::Save", "The file '" + filepath + "' could not be written.");
+    }
+}
+
+
+std::shared_ptr<DistanceField> DistanceField::Read(std::istream& stream)
+{
+    std::shared_ptr<DistanceField> field(new DistanceField());
+
+    auto read = [&](void* data, size_t bytes)
+    {
+        stream.read((char*) data, bytes);
+
+        return (bool) stream;
+    };
+
+    std::vector<char> tag(std::strlen(Tag()));
+
+    if (!read(tag.data(), tag.size()) || std::memcmp(tag.data(), Tag(), tag.size()) != 0)
+    {
+        Exceptions::InvalidDistanceField("DistanceField::Read", "This is not a distance field, or it was written by another version of CADMesh, or on a machine of another byte order.");
+        return nullptr;
+    }
+
+    G4double geometry[10];
+    uint64_t sizes[3];
+
+    if (!read(geometry, sizeof(geometry))
+        || !read(field->dimensions_, sizeof(field->dimensions_))
+        || !read(&field->resolution_, sizeof(field->resolution_))
+        || !read(&field->number_of_triangles_, sizeof(field->number_of_triangles_))
+        || !read(&field->mesh_hash_, sizeof(field->mesh_hash_))
+        || !read(sizes, sizeof(sizes)))
+    {
+        Exceptions::InvalidDistanceField("DistanceField::Read", "The distance field ended early.");
+        return nullptr;
+    }
+
+    field->origin_ = G4ThreeVector(geometry[0], geometry[1], geometry[2]);
+    field->minimum_ = G4ThreeVector(geometry[3], geometry[4], geometry[5]);
+    field->maximum_ = G4ThreeVector(geometry[6], geometry[7], geometry[8]);
+    field->cell_size_ = geometry[9];
+
+    // The sizes must agree with each other before anything is allocated.
+    uint64_t cells = (uint64_t) field->dimensions_[0] * field->dimensions_[1] * field->dimensions_[2];
+    uint64_t side = field->resolution_ + 1;
+
+    if (!(field->cell_size_ > 0)
+        || field->resolution_ == 0
+        || field->resolution_ > 255
+        || cells == 0
+        || cells > (1 << 30)
+        || sizes[0] != cells
+        || sizes[1] != cells
+        || sizes[2] % (side * side * side) != 0
+        || sizes[2] / (side * side * side) > cells)
+    {
+        Exceptions::InvalidDistanceField("DistanceField::Read", "The sizes in the distance field don't agree.");
+        return nullptr;
+    }
+
+    field->centres_.resize(sizes[0]);
+    field->bricks_.resize(sizes[1]);
+    field->samples_.resize(sizes[2]);
+
+    if (!read(field->centres_.data(), field->centres_.size() * sizeof(float))
+        || !read(field->bricks_.data(), field->bricks_.size() * sizeof(uint32_t))
+        || !read(field->samples_.data(), field->samples_.size() * sizeof(float)))
+    {
+        Exceptions::InvalidDistanceField("DistanceField::Read", "The distance field ended early.");
+        return nullptr;
+    }
+
+    auto number_of_bricks = sizes[2] / (side * side * side);
+
+    for (auto brick : field->bricks_)
+    {
+        if (brick != none && brick >= number_of_bricks)
+        {
+            Exceptions::InvalidDistanceField("DistanceField::Read", "A cell refers to a brick that doesn't exist.");
+            return nullptr;
+        }
+    }
+
+    return field;
+}
+
+
+std::shared_ptr<DistanceField> DistanceField::Load(G4String filepath)
+{
+    std::ifstream file(filepath, std::ios::binary);
+
+    if (!file)
+    {
+        Exceptions::FileNotFound("DistanceField::Load", filepath);
+        return nullptr;
+    }
+
+    return Read(file);
+}
+
+
+G4double DistanceField::GetCellSize() const
+{
+    return cell_size_;
+}
+
+
+size_t DistanceField::GetResolution() const
+{
+    return resolution_;
+}
+
+
+size_t DistanceField::GetNumberOfCells() const
+{
+    return centres_.size();
+}
+
+
+size_t DistanceField::GetNumberOfBricks() const
+{
+    size_t side = resolution_ + 1;
+
+    return samples_.size() / (side * side * side);
+}
+
+
+size_t DistanceField::GetMemoryUsed() const
+{
+    return centres_.capacity() * sizeof(float)
+         + bricks_.capacity() * sizeof(uint32_t)
+         + samples_.capacity() * sizeof(float);
+}
+
+
+G4bool DistanceField::Cell(const G4ThreeVector& point, size_t& cell) const
+{
+    size_t index[3];
+
+    for (size_t axis = 0; axis < 3; axis++)
+    {
+        auto x = (point[axis] - origin_[axis]) / cell_size_;
+
+        if (!(x >= 0 && x < dimensions_[axis]))
+        {
+            return false;
+        }
+
+        index[axis] = x;
+    }
+
+    cell = (index[2] * dimensions_[1] + index[1]) * dimensions_[0] + index[0];
+
+    return true;
+}
+
+
+G4ThreeVector DistanceField::Corner(size_t cell) const
+{
+    size_t i = cell % dimensions_[0];
+    size_t j = cell / dimensions_[0] % dimensions_[1];
+    size_t k = cell / dimensions_[0] / dimensions_[1];
+
+    return origin_ + G4ThreeVector(i, j, k) * cell_size_;
+}
+
+
+float DistanceField::Lower(G4double distance)
+{
+    auto lower = (float) distance;
+
+    if (std::abs((G4double) lower) > std::abs(distance))
+    {
+        lower = std::nextafter(lower, 0.0f);
+    }
+
+    return lower;
+}
+
+} // CADMesh namespace
+
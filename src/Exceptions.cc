@@ -22,6 +22,7 @@
 
 // CADMesh //
 #include "Exceptions.hh"
+#include "Parallel.hh"
 
 
 namespace CADMesh
@@ -30,42 +31,48 @@ namespace CADMesh
 namespace Exceptions
 {
 
-void FileNotFound(G4String origin, G4String filepath)
+// Geant4 exceptions are only raised on the thread that started the work. On
+// a worker the error is thrown instead, and raised after the join.
+void Raise(G4String origin, G4String name, G4String description)
 {
+    if (IsWorkerThread())
+    {
+        throw WorkerError([=]() { Raise(origin, name, description); });
+    }
+
     G4Exception( ("CADMesh in " + origin).c_str()
-               , "FileNotFound"
+               , name.c_str()
                , FatalException
-               , ("\nThe file: \n\t" + filepath + "\ncould not be found.").c_str());
+               , description.c_str());
+}
+
+
+void FileNotFound(G4String origin, G4String filepath)
+{
+    Raise(origin, "FileNotFound", "\nThe file: \n\t" + filepath + "\ncould not be found.");
 }
 
 
 void LexerError(G4String origin, G4String message)
 {
-    G4Exception( ("CADMesh in " + origin).c_str()
-               , "LexerError"
-               , FatalException
-               , ("\nThe CAD file appears to contain incorrect syntax:\n\t" + message).c_str());
+    Raise(origin, "LexerError", "\nThe CAD file appears to contain incorrect syntax:\n\t" + message);
 }
 
 
 void ParserError(G4String origin, G4String message)
 {
-    G4Exception( ("CADMesh in " + origin).c_str()
-               , "ParserError"
-               , FatalException
-               , ("\nThe CAD file appears to contain invalid data:\n\t" + message).c_str());
+    Raise(origin, "ParserError", "\nThe CAD file appears to contain invalid data:\n\t" + message);
 }
 
 
 void ReaderCantReadError(G4String origin, File::Type file_type, G4String filepath)
 {
-    G4Exception( ("CADMesh in " + origin).c_str()
-               , "ReaderCantReadError"
-               , FatalException
-               , (G4String("\nThe the reader can't read files of type '")
-                   + File::TypeString[file_type]
-                   + ".'\n\tSpecified the incorrect file type (?) for file:\n\t\t"
-                   + filepath).c_str());
+    Raise( origin
+         , "ReaderCantReadError"
+         , G4String("\nThe the reader can't read files of type '")
+             + File::TypeString[file_type]
+             + ".'\n\tSpecified the incorrect file type (?) for file:\n\t\t"
+             + filepath);
 }
 
 
@@ -74,19 +81,25 @@ void MeshNotFound(G4String origin, size_t index)
     std::stringstream message;
     message << "\nThe mesh with index '" << index << "' could not be found.";
 
-    G4Exception( ("CADMesh in " + origin).c_str()
-               , "MeshNotFound"
-               , FatalException
-               , message.str().c_str());
+    Raise(origin, "MeshNotFound", message.str());
 }
 
 
 void MeshNotFound(G4String origin, G4String name)
 {
-    G4Exception( ("CADMesh in " + origin).c_str()
-               , "MeshNotFound"
-               , FatalException
-               , ("\nThe mesh with name '" + name + "' could not be found.").c_str());
+    Raise(origin, "MeshNotFound", "\nThe mesh with name '" + name + "' could not be found.");
+}
+
+
+void InvalidMesh(G4String origin, G4String message)
+{
+    Raise(origin, "InvalidMesh", "\nThe mesh can't be built:\n\t" + message);
+}
+
+
+void InvalidDistanceField(G4String origin, G4String message)
+{
+    Raise(origin, "InvalidDistanceField", "\nThe distance field can't be used:\n\t" + message);
 }
 
 } // Exceptions namespace
@@ -0,0 +1,625 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2011-2020 Christopher M. Poole <mail@christopherpoole.net>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+// CADMesh //
+#include "FacetRepair.hh"
+#include "Parallel.hh"
+
+// STL //
+#include <algorithm>
+#include <cmath>
+
+
+namespace CADMesh
+{
+
+FacetRepair::FacetRepair( std::vector<G4double>& x
+                        , std::vector<G4double>& y
+                        , std::vector<G4double>& z
+                        , std::vector<uint32_t>& indices
+                        , G4double tolerance
+                        , G4double minimum_area
+                        , G4double maximum_aspect_ratio
+                        , size_t threads)
+    : x_(x)
+    , y_(y)
+    , z_(z)
+    , indices_(indices)
+    , tolerance_(tolerance)
+    , minimum_area_(minimum_area)
+    , maximum_aspect_ratio_(maximum_aspect_ratio)
+    , threads_(std::max<size_t>(threads, 1))
+{
+    number_of_facets_before_ = indices_.size() / 3;
+    number_of_facets_ = number_of_facets_before_;
+
+    auto degenerate = Find();
+    number_of_degenerate_facets_ = degenerate.size();
+
+    if (degenerate.empty())
+    {
+        return;
+    }
+
+    alive_.assign(number_of_facets_before_, true);
+    around_.assign(x_.size(), std::vector<uint32_t>());
+
+    for (uint32_t f = 0; f < number_of_facets_before_; f++)
+    {
+        for (size_t corner = 0; corner < 3; corner++)
+        {
+            auto& around = around_[indices_[3 * f + corner]];
+
+            if (around.empty() || around.back() != f)
+                around.push_back(f);
+        }
+    }
+
+    // A repair can leave the facets around it degenerate, or a facet can
+    // need a neighbour repaired first, so the facets changed are looked at
+    // again until nothing more can be done.
+    for (size_t round = 0; round < 16 && !degenerate.empty(); round++)
+    {
+        std::vector<uint32_t> touched;
+        G4bool repaired = false;
+
+        for (auto f : degenerate)
+        {
+            if (alive_[f] && IsDegenerate(f))
+            {
+                repaired = Repair(f, touched) || repaired;
+            }
+        }
+
+        if (!repaired)
+        {
+            break;
+        }
+
+        touched.insert(touched.end(), degenerate.begin(), degenerate.end());
+
+        std::sort(touched.begin(), touched.end());
+        touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+
+        degenerate.clear();
+
+        for (auto f : touched)
+        {
+            if (alive_[f] && IsDegenerate(f))
+                degenerate.push_back(f);
+        }
+    }
+
+    Finish();
+
+    number_of_remaining_facets_ = Find().size();
+}
+
+
+size_t FacetRepair::GetNumberOfFacetsBefore() const
+{
+    return number_of_facets_before_;
+}
+
+
+size_t FacetRepair::GetNumberOfFacets() const
+{
+    return number_of_facets_;
+}
+
+
+size_t FacetRepair::GetNumberOfDegenerateFacets() const
+{
+    return number_of_degenerate_facets_;
+}
+
+
+size_t FacetRepair::GetNumberOfCollapsedEdges() const
+{
+    return number_of_collapsed_edges_;
+}
+
+
+size_t FacetRepair::GetNumberOfFlippedEdges() const
+{
+    return number_of_flipped_edges_;
+}
+
+
+size_t FacetRepair::GetNumberOfRemovedFacets() const
+{
+    return number_of_removed_facets_;
+}
+
+
+size_t FacetRepair::GetNumberOfRemainingFacets() const
+{
+    return number_of_remaining_facets_;
+}
+
+
+std::vector<uint32_t> FacetRepair::Find() const
+{
+    auto facets = indices_.size() / 3;
+    auto threads = std::min(threads_, NumberOfThreads(facets, 1 << 16));
+
+    std::vector<unsigned char> flags(facets);
+
+    ParallelFor(threads, threads, [&](size_t t)
+    {
+        auto begin = facets * t / threads;
+        Classify(begin, facets * (t + 1) / threads, flags.data() + begin);
+    });
+
+    std::vector<uint32_t> degenerate;
+
+    for (size_t f = 0; f < facets; f++)
+    {
+        if (flags[f])
+            degenerate.push_back(f);
+    }
+
+    return degenerate;
+}
+
+
+G4bool FacetRepair::IsDegenerate(uint32_t facet) const
+{
+    unsigned char flag;
+    Classify(facet, facet + 1, &flag);
+
+    return flag;
+}
+
+
+void FacetRepair::Classify(size_t begin, size_t end, unsigned char* flags) const
+{
+    // The edges are squared, and the area too, so there are no square roots
+    // or divisions.
+    const G4double tolerance = tolerance_ * tolerance_;
+    const G4double area_limit = 4 * minimum_area_ * minimum_area_;
+    const G4double aspect_ratio = maximum_aspect_ratio_ * maximum_aspect_ratio_;
+    const G4bool any_aspect_ratio = maximum_aspect_ratio_ <= 0;
+
+    // The corners of a tile of facets are gathered first, a coordinate to
+    // an array, so that the tests run over the arrays in step.
+    const size_t tile = 256;
+    G4double p[9][tile];
+
+    for (size_t start = begin; start < end; start += tile)
+    {
+        auto count = std::min(tile, end - start);
+
+        for (size_t i = 0; i < count; i++)
+        {
+            for (size_t corner = 0; corner < 3; corner++)
+            {
+                auto point = indices_[3 * (start + i) + corner];
+
+                p[3 * corner][i] = x_[point];
+                p[3 * corner + 1][i] = y_[point];
+                p[3 * corner + 2][i] = z_[point];
+            }
+        }
+
+        for (size_t i = 0; i < count; i++)
+        {
+            auto abx = p[3][i] - p[0][i];
+            auto aby = p[4][i] - p[1][i];
+            auto abz = p[5][i] - p[2][i];
+
+            auto bcx = p[6][i] - p[3][i];
+            auto bcy = p[7][i] - p[4][i];
+            auto bcz = p[8][i] - p[5][i];
+
+            auto cax = p[0][i] - p[6][i];
+            auto cay = p[1][i] - p[7][i];
+            auto caz = p[2][i] - p[8][i];
+
+            auto ab = abx * abx + aby * aby + abz * abz;
+            auto bc = bcx * bcx + bcy * bcy + bcz * bcz;
+            auto ca = cax * cax + cay * cay + caz * caz;
+
+            // Twice the area.
+            auto nx = cay * abz - caz * aby;
+            auto ny = caz * abx - cax * abz;
+            auto nz = cax * aby - cay * abx;
+
+            auto area = nx * nx + ny * ny + nz * nz;
+
+            auto longest = std::max(ab, std::max(bc, ca));
+            auto shortest = std::min(ab, std::min(bc, ca));
+
+            flags[start - begin + i] = (shortest <= tolerance)
+                                     | (area <= tolerance * longest)
+                                     | (area <= area_limit)
+                                     | (!any_aspect_ratio & (longest * longest > aspect_ratio * area));
+        }
+    }
+}
+
+
+G4ThreeVector FacetRepair::GetPoint(uint32_t point) const
+{
+    return G4ThreeVector(x_[point], y_[point], z_[point]);
+}
+
+
+G4bool FacetRepair::Repair(uint32_t facet, std::vector<uint32_t>& touched)
+{
+    auto corners = &indices_[3 * facet];
+
+    if (corners[0] == corners[1] || corners[1] == corners[2] || corners[2] == corners[0])
+    {
+        Remove(facet);
+        return true;
+    }
+
+    G4double lengths[3];
+
+    for (size_t corner = 0; corner < 3; corner++)
+    {
+        lengths[corner] = (GetPoint(corners[(corner + 1) % 3]) - GetPoint(corners[corner])).mag();
+    }
+
+    auto shortest = std::min_element(lengths, lengths + 3) - lengths;
+    auto longest = std::max_element(lengths, lengths + 3) - lengths;
+
+    auto a = GetPoint(corners[0]);
+    auto area = (GetPoint(corners[1]) - a).cross(GetPoint(corners[2]) - a).mag();
+    auto height = lengths[longest] > 0 ? area / lengths[longest] : 0;
+
+    // A point near one end of the longest edge makes a needle, better
+    // collapsed, and one further along it a cap, better flipped. Whichever
+    // can't be done, the other is tried.
+    if (lengths[shortest] <= tolerance_ || lengths[shortest] <= 2 * height)
+    {
+        return Collapse(facet, shortest, touched) || Flip(facet, longest, touched);
+    }
+
+    return Flip(facet, longest, touched) || Collapse(facet, shortest, touched);
+}
+
+
+G4bool FacetRepair::Collapse(uint32_t facet, size_t corner, std::vector<uint32_t>& touched)
+{
+    auto from = indices_[3 * facet + (corner + 1) % 3];
+    auto to = indices_[3 * facet + corner];
+
+    // The facets on the edge go, and the points opposite it on them must be
+    // the only points next to both ends, or the surface would be joined to
+    // itself. Those points must keep at least three neighbours.
+    std::vector<uint32_t> shared;
+    std::vector<uint32_t> opposite;
+
+    for (auto f : around_[to])
+    {
+        auto corners = &indices_[3 * f];
+
+        if (corners[0] != from && corners[1] != from && corners[2] != from)
+            continue;
+
+        shared.push_back(f);
+
+        for (size_t k = 0; k < 3; k++)
+        {
+            if (corners[k] != from && corners[k] != to)
+                opposite.push_back(corners[k]);
+        }
+    }
+
+    std::sort(opposite.begin(), opposite.end());
+
+    if (std::adjacent_find(opposite.begin(), opposite.end()) != opposite.end())
+    {
+        return false;
+    }
+
+    std::vector<uint32_t> from_neighbours;
+    std::vector<uint32_t> to_neighbours;
+    std::vector<uint32_t> common;
+
+    Neighbours(from, from_neighbours);
+    Neighbours(to, to_neighbours);
+
+    std::set_intersection( from_neighbours.begin(), from_neighbours.end()
+                         , to_neighbours.begin(), to_neighbours.end()
+                         , std::back_inserter(common));
+
+    if (common != opposite)
+    {
+        return false;
+    }
+
+    std::vector<uint32_t> neighbours;
+
+    for (auto point : opposite)
+    {
+        Neighbours(point, neighbours);
+
+        if (neighbours.size() <= 3)
+            return false;
+    }
+
+    // No facet that is kept may turn over. Those already too thin to have
+    // a direction are left to be repaired themselves.
+    auto position = (GetPoint(from) + GetPoint(to)) / 2;
+
+    for (auto point : { from, to })
+    {
+        for (auto f : around_[point])
+        {
+            if (std::find(shared.begin(), shared.end(), f) != shared.end())
+                continue;
+
+            G4ThreeVector before[3];
+            G4ThreeVector after[3];
+
+            for (size_t k = 0; k < 3; k++)
+            {
+                auto index = indices_[3 * f + k];
+
+                before[k] = GetPoint(index);
+                after[k] = (index == from || index == to) ? position : before[k];
+            }
+
+            auto normal = (before[1] - before[0]).cross(before[2] - before[0]);
+            auto moved = (after[1] - after[0]).cross(after[2] - after[0]);
+
+            auto longest = std::max({ (before[1] - before[0]).mag()
+                                    , (before[2] - before[1]).mag()
+                                    , (before[0] - before[2]).mag() });
+
+            if (normal.mag() > tolerance_ * longest && normal.dot(moved) <= 0)
+                return false;
+        }
+    }
+
+    for (auto f : shared)
+    {
+        Remove(f);
+    }
+
+    x_[to] = position.x();
+    y_[to] = position.y();
+    z_[to] = position.z();
+
+    for (auto f : around_[from])
+    {
+        for (size_t k = 0; k < 3; k++)
+        {
+            if (indices_[3 * f + k] == from)
+                indices_[3 * f + k] = to;
+        }
+
+        around_[to].push_back(f);
+    }
+
+    around_[from].clear();
+
+    touched.insert(touched.end(), around_[to].begin(), around_[to].end());
+    number_of_collapsed_edges_++;
+
+    return true;
+}
+
+
+G4bool FacetRepair::Flip(uint32_t facet, size_t corner, std::vector<uint32_t>& touched)
+{
+    // The facet runs a, b, c, and the one on the other side of the edge
+    // from a to b runs b, a, d. They become a, d, c and d, b, c.
+    auto a = indices_[3 * facet + corner];
+    auto b = indices_[3 * facet + (corner + 1) % 3];
+    auto c = indices_[3 * facet + (corner + 2) % 3];
+
+    uint32_t other = 0;
+    size_t others = 0;
+
+    for (auto f : around_[a])
+    {
+        auto corners = &indices_[3 * f];
+
+        if (f != facet && (corners[0] == b || corners[1] == b || corners[2] == b))
+        {
+            other = f;
+            others++;
+        }
+    }
+
+    if (others != 1)
+    {
+        return false;
+    }
+
+    auto corners = &indices_[3 * other];
+    size_t at = 0;
+
+    while (corners[at] != b)
+    {
+        at++;
+    }
+
+    if (corners[(at + 1) % 3] != a)
+    {
+        return false;
+    }
+
+    auto d = corners[(at + 2) % 3];
+
+    if (d == c)
+    {
+        return false;
+    }
+
+    for (auto f : around_[c])
+    {
+        auto corners = &indices_[3 * f];
+
+        if (corners[0] == d || corners[1] == d || corners[2] == d)
+            return false;
+    }
+
+    // Both new facets must face the way the two did, and the thinner of
+    // them must be less thin than the thinner of those.
+    auto thinness = [&](uint32_t p, uint32_t q, uint32_t r, G4ThreeVector& normal)
+    {
+        auto pq = GetPoint(q) - GetPoint(p);
+        auto qr = GetPoint(r) - GetPoint(q);
+        auto rp = GetPoint(p) - GetPoint(r);
+
+        normal = pq.cross(-rp);
+
+        auto longest = std::max({ pq.mag2(), qr.mag2(), rp.mag2() });
+
+        return longest > 0 ? normal.mag() / longest : 0;
+    };
+
+    G4ThreeVector normals[4];
+
+    auto before = std::min( thinness(a, b, c, normals[0])
+                          , thinness(b, a, d, normals[1]));
+
+    auto after = std::min( thinness(a, d, c, normals[2])
+                         , thinness(d, b, c, normals[3]));
+
+    auto normal = normals[0] + normals[1];
+
+    if (after <= before || normals[2].dot(normal) <= 0 || normals[3].dot(normal) <= 0)
+    {
+        return false;
+    }
+
+    indices_[3 * facet] = a;
+    indices_[3 * facet + 1] = d;
+    indices_[3 * facet + 2] = c;
+
+    indices_[3 * other] = d;
+    indices_[3 * other + 1] = b;
+    indices_[3 * other + 2] = c;
+
+    around_[b].erase(std::find(around_[b].begin(), around_[b].end(), facet));
+    around_[a].erase(std::find(around_[a].begin(), around_[a].end(), other));
+
+    around_[d].push_back(facet);
+    around_[c].push_back(other);
+
+    touched.push_back(facet);
+    touched.push_back(other);
+
+    number_of_flipped_edges_++;
+
+    return true;
+}
+
+
+void FacetRepair::Remove(uint32_t facet)
+{
+    alive_[facet] = false;
+
+    for (size_t corner = 0; corner < 3; corner++)
+    {
+        auto& around = around_[indices_[3 * facet + corner]];
+        auto found = std::find(around.begin(), around.end(), facet);
+
+        if (found != around.end())
+            around.erase(found);
+    }
+}
+
+
+void FacetRepair::Neighbours(uint32_t point, std::vector<uint32_t>& neighbours) const
+{
+    neighbours.clear();
+
+    for (auto f : around_[point])
+    {
+        for (size_t corner = 0; corner < 3; corner++)
+        {
+            if (indices_[3 * f + corner] != point)
+                neighbours.push_back(indices_[3 * f + corner]);
+        }
+    }
+
+    std::sort(neighbours.begin(), neighbours.end());
+    neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+}
+
+
+void FacetRepair::Finish()
+{
+    // The points and facets left keep their order. Points no facet uses go.
+    std::vector<uint32_t> renumbered(x_.size(), 0);
+    std::vector<char> used(x_.size(), false);
+
+    size_t kept = 0;
+
+    for (size_t f = 0; f < alive_.size(); f++)
+    {
+        if (!alive_[f])
+        {
+            continue;
+        }
+
+        for (size_t corner = 0; corner < 3; corner++)
+        {
+            indices_[3 * kept + corner] = indices_[3 * f + corner];
+            used[indices_[3 * f + corner]] = true;
+        }
+
+        kept++;
+    }
+
+    indices_.resize(3 * kept);
+
+    uint32_t next = 0;
+
+    for (size_t p = 0; p < x_.size(); p++)
+    {
+        if (!used[p])
+        {
+            continue;
+        }
+
+        x_[next] = x_[p];
+        y_[next] = y_[p];
+        z_[next] = z_[p];
+
+        renumbered[p] = next++;
+    }
+
+    x_.resize(next);
+    y_.resize(next);
+    z_.resize(next);
+
+    for (auto& index : indices_)
+    {
+        index = renumbered[index];
+    }
+
+    number_of_facets_ = kept;
+    number_of_removed_facets_ = number_of_facets_before_ - kept;
+
+    std::vector<char>().swap(alive_);
+    std::vector<std::vector<uint32_t> >().swap(around_);
+}
+
+} // CADMesh namespace
+
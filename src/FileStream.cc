@@ -0,0 +1,172 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2011-2020 Christopher M. Poole <mail@christopherpoole.net>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// CADMesh //
+#include "FileStream.hh"
+
+// STL //
+#include <algorithm>
+#include <cstring>
+
+
+namespace CADMesh
+{
+
+namespace File
+{
+
+FileStream::FileStream(std::string filepath, size_t chunk_size)
+        : file_(filepath, std::ios::binary)
+        , chunk_size_(std::max<size_t>(chunk_size, 1))
+{
+    if (file_)
+    {
+        file_.seekg(0, std::ios::end);
+        size_ = (size_t) file_.tellg();
+        file_.seekg(0, std::ios::beg);
+    }
+
+    buffer_.resize(chunk_size_);
+}
+
+
+bool FileStream::IsOpen()
+{
+    return file_.is_open();
+}
+
+
+size_t FileStream::Size()
+{
+    return size_;
+}
+
+
+bool FileStream::NextLine(const char*& begin, const char*& end)
+{
+    // Only the part of the buffer not yet searched needs looking at.
+    size_t searched = 0;
+
+    while (true)
+    {
+        auto first = buffer_.data() + begin_;
+        auto last = buffer_.data() + end_;
+
+        auto line_break = (const char*) std::memchr(first + searched, '\n', last - first - searched);
+
+        if (line_break)
+        {
+            begin = first;
+            end = line_break;
+
+            begin_ = line_break - buffer_.data() + 1;
+            line_number_++;
+
+            return true;
+        }
+
+        searched = end_ - begin_;
+
+        if (!Fill(searched + 1))
+        {
+            break;
+        }
+    }
+
+    // The last line need not end in a line break.
+    if (begin_ == end_)
+    {
+        return false;
+    }
+
+    begin = buffer_.data() + begin_;
+    end = buffer_.data() + end_;
+
+    begin_ = end_;
+    line_number_++;
+
+    return true;
+}
+
+
+const unsigned char* FileStream::Read(size_t size)
+{
+    auto bytes = Peek(size);
+
+    if (bytes)
+    {
+        begin_ += size;
+    }
+
+    return bytes;
+}
+
+
+const unsigned char* FileStream::Peek(size_t size)
+{
+    if (!Fill(size))
+    {
+        return nullptr;
+    }
+
+    return (const unsigned char*) buffer_.data() + begin_;
+}
+
+
+size_t FileStream::LineNumber()
+{
+    return line_number_;
+}
+
+
+bool FileStream::Fill(size_t size)
+{
+    if (end_ - begin_ >= size)
+    {
+        return true;
+    }
+
+    // Keep what hasn't been handed out yet, and read after it.
+    std::memmove(buffer_.data(), buffer_.data() + begin_, end_ - begin_);
+
+    end_ -= begin_;
+    begin_ = 0;
+
+    // Grow geometrically for a long line, rather than a byte at a time.
+    if (buffer_.size() < size)
+    {
+        buffer_.resize(std::max(size, 2 * buffer_.size()));
+    }
+
+    while (end_ < size && file_)
+    {
+        file_.read(buffer_.data() + end_, buffer_.size() - end_);
+        end_ += (size_t) file_.gcount();
+    }
+
+    return end_ >= size;
+}
+
+} // File namespace
+
+} // CADMesh namespace
+
@@ -0,0 +1,158 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2011-2020 Christopher M. Poole <mail@christopherpoole.net>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+// CADMesh //
+#include "Items.hh"
+#include "NumberParser.hh"
+#include "Exceptions.hh"
+
+
+namespace CADMesh
+{
+
+namespace File
+{
+
+
+Items::Items(std::shared_ptr<MappedFile> file) : file_(file)
+{
+}
+
+
+size_t Items::Add(Token token, size_t position, size_t length, size_t parent)
+{
+    if (items_.size() >= NoItem)
+    {
+        Exceptions::LexerError("Items::Add", "Too many tokens in the file.");
+    }
+
+    auto index = (uint32_t) items_.size();
+
+    items_.push_back(Item { position
+                          , token
+                          , (uint32_t) length
+                          , (uint32_t) parent
+                          , NoItem
+                          , NoItem
+                          , NoItem });
+
+    if (parent != NoItem)
+    {
+        auto& p = items_[parent];
+
+        if (p.last_child == NoItem)
+        {
+            p.first_child = index;
+        }
+
+        else
+        {
+            items_[p.last_child].next_sibling = index;
+        }
+
+        p.last_child = index;
+    }
+
+    return index;
+}
+
+
+Item& Items::operator[](size_t index)
+{
+    return items_[index];
+}
+
+
+size_t Items::Size()
+{
+    return items_.size();
+}
+
+
+Items::Children Items::ChildrenOf(size_t index)
+{
+    return Children(this, items_[index].first_child);
+}
+
+
+size_t Items::NumberOfChildren(size_t index)
+{
+    size_t count = 0;
+
+    for (auto child = items_[index].first_child; child != NoItem; child = items_[child].next_sibling)
+    {
+        count++;
+    }
+
+    return count;
+}
+
+
+bool Items::HasChildren(size_t index)
+{
+    return items_[index].first_child != NoItem;
+}
+
+
+std::string Items::Value(size_t index)
+{
+    auto& item = items_[index];
+
+    return std::string(file_->Data() + item.position, item.length);
+}
+
+
+double Items::DoubleValue(size_t index)
+{
+    auto& item = items_[index];
+    auto begin = file_->Data() + item.position;
+
+    double value;
+    NumberParser::Parse(begin, begin + item.length, value);
+
+    return value;
+}
+
+
+long Items::IntegerValue(size_t index)
+{
+    auto& item = items_[index];
+    auto begin = file_->Data() + item.position;
+
+    long value;
+    NumberParser::Parse(begin, begin + item.length, value);
+
+    return value;
+}
+
+
+size_t Items::LineNumber(size_t index)
+{
+    return file_->LineNumber(items_[index].position);
+}
+
+
+} // File namespace
+
+} // CADMesh namespace
+
@@ -22,13 +22,15 @@
 
 // CADMesh //
 #include "Lexer.hh"
+#include "NumberParser.hh"
+#include "Parallel.hh"
 #include "Exceptions.hh"
 
 // STL //
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <sstream>
-#include <fstream>
-#include <streambuf>
 
 
 namespace CADMesh
@@ -40,9 +42,34 @@ namespace File
 
 Lexer::Lexer(std::string filepath, State* initial_state)
 {
-    std::ifstream file(filepath);
-    input_ = std::string( (std::istreambuf_iterator<char>(file))
-                        , std::istreambuf_iterator<char>());
+    // Lex straight from the file's bytes; the mapping lives as long as the
+    // lexer (or any copy of it) does.
+    file_ = std::make_shared<MappedFile>(filepath);
+
+    input_ = file_->Data();
+    length_ = file_->Size();
+
+    items_ = std::make_shared<Items>(file_);
+
+    if (initial_state)
+    {
+        Run(initial_state);
+    }
+}
+
+
+Lexer::Lexer( std::shared_ptr<MappedFile> file
+            , size_t begin
+            , size_t end
+            , State* initial_state)
+{
+    file_ = file;
+
+    input_ = file_->Data();
+    length_ = std::min(end, file_->Size());
+    position_ = begin;
+
+    items_ = std::make_shared<Items>(file_);
 
     if (initial_state)
     {
@@ -51,22 +78,52 @@ Lexer::Lexer(std::string filepath, State* initial_state)
 }
 
 
+std::vector<Lexer> Lexer::RunInChunks( std::shared_ptr<MappedFile> file
+                                     , size_t begin
+                                     , size_t end
+                                     , size_t chunks
+                                     , State* initial_state)
+{
+    auto boundaries = file->Split(begin, end, chunks);
+
+    std::vector<Lexer> lexers;
+
+    for (size_t i = 0; i + 1 < boundaries.size(); i++)
+    {
+        lexers.push_back(Lexer(file, boundaries[i], boundaries[i + 1]));
+    }
+
+    ParallelFor(lexers.size(), lexers.size(), [&](size_t i)
+    {
+        lexers[i].Run(initial_state);
+    });
+
+    return lexers;
+}
+
+
 std::string Lexer::String()
 {
-    return input_.substr(start_, position_ - start_);
+    return std::string(input_ + start_, position_ - start_);
 }
 
 
 void Lexer::Run(State* initial_state, size_t lines)
 {
-    parent_item_ = new Item { ParentToken, position_, line_, "", "", nullptr, std::vector<Item>() };
+    // Each run collects its items under a new root.
+    root_ = items_->Add(ParentToken, position_, 0, NoItem);
+    parent_item_ = root_;
 
     state_ = initial_state;
 
-    end_line_ = 0;
+    end_position_ = std::string::npos;
 
     if (lines > 0)
-        end_line_ = line_ + lines;
+    {
+        // Stop trying new states once the cursor moves past the line break
+        // that ends the last of the requested lines.
+        end_position_ = file_->EndOfLine(LineNumber() + lines);
+    }
 
     while (state_)
     {
@@ -75,62 +132,50 @@ void Lexer::Run(State* initial_state, size_t lines)
 }
 
 
-Items Lexer::GetItems()
+std::shared_ptr<Items> Lexer::GetItems()
 {
-    return parent_item_->children;
+    return items_;
 }
 
 
-void Lexer::Backup()
+size_t Lexer::GetRoot()
 {
-    position_ -= width_;
+    return root_;
+}
 
-    auto next = input_.substr(position_, 1);
 
-    if (next == "\n")
-    {
-        line_--;
-    }
+void Lexer::Backup()
+{
+    if (position_ > 0)
+        position_--;
 }
 
 
-void Lexer::BackupTo(int position)
+void Lexer::BackupTo(size_t position)
 {
-    auto s = input_.substr(position, position_ - position);
-    line_ -= std::count(s.begin(), s.end(), '\n');
-
     position_ = position;
 }
 
 
 std::string Lexer::Next()
 {
-    if (position_ >= input_.length())
+    if (position_ >= length_)
     {
         return "";
     }
 
-    // TODO: assuming width of 1.
-    auto next = input_.substr(position_, 1);
-
-    width_ = 1;
-    position_ += width_;
-
-    if (next == "\n")
-        line_++;
- 
-    return next;
+    return std::string(1, input_[position_++]);
 }
 
 
 std::string Lexer::Peek()
 {
-    auto next = Next();
-
-    if (next != "")
-        Backup();
+    if (position_ >= length_)
+    {
+        return "";
+    }
 
-    return next;
+    return std::string(1, input_[position_]);
 }
 
 
@@ -140,37 +185,24 @@ void Lexer::Skip()
 }
 
 
-Item* Lexer::ThisIsA(Token token, std::string error)
+size_t Lexer::ThisIsA(Token token)
 {
-    if (dry_run_) return nullptr;
+    if (dry_run_) return NoItem;
 
-    auto item = Item { token, position_, line_, String(), error, parent_item_, Items() };
+    auto item = items_->Add(token, start_, position_ - start_, parent_item_);
     Skip();
     
-    if (parent_item_)
-    { 
-        PrintItem(item);
-
-        parent_item_->children.push_back(item);
-        return &(parent_item_->children.back());
-    }
-
-    else
-    {
-        depth_++;
-        PrintItem(item);
+    PrintItem(item);
 
-        items_.push_back(item);
-        return &(items_.back());
-    }
+    return item;
 }
 
 
-Item* Lexer::StartOfA(Token token, std::string error)
+size_t Lexer::StartOfA(Token token)
 {
-    if (dry_run_) return nullptr;
+    if (dry_run_) return NoItem;
 
-    parent_item_ = ThisIsA(token, error);
+    parent_item_ = ThisIsA(token);
 
     depth_ ++;
 
@@ -178,63 +210,160 @@ Item* Lexer::StartOfA(Token token, std::string error)
 }
 
 
-Item* Lexer::EndOfA(Token token, std::string /*error*/)
+size_t Lexer::EndOfA(Token token)
 {
-    if (dry_run_) return nullptr;
+    if (dry_run_) return NoItem;
     
     depth_--;
     
-    PrintItem(*parent_item_);
+    PrintItem(parent_item_);
+
+    auto& parent = (*items_)[parent_item_];
 
-    if (parent_item_->token.name != token.name)
+    if (parent.token != token)
     {
         Exceptions::LexerError("Lexer::EndOfA", "Trying to end a '"
-                                              + parent_item_->token.name
+                                              + parent.token.Name()
                                               + "' with a '"
-                                              + token.name
+                                              + token.Name()
                                               + "' token.");
     }
 
-    if (parent_item_)
+    if (parent.parent != NoItem)
     {
-        parent_item_ = parent_item_->parent;
+        parent_item_ = parent.parent;
     }
 
-    return nullptr;
+    return NoItem;
 }
 
 
-Item* Lexer::MaybeEndOfA(Token token, std::string error)
+size_t Lexer::MaybeEndOfA(Token token)
 {
-    if (parent_item_->token.name == token.name)
+    if ((*items_)[parent_item_].token == token)
     {
-        return EndOfA(token, error);
+        return EndOfA(token);
     }
     
     else
     {
-        return nullptr;
+        return NoItem;
     }
 }
 
 
-bool Lexer::OneOf(std::string possibles)
+const unsigned char* Lexer::CharacterClasses()
 {
-    auto peek = Peek();
+    struct Table
+    {
+        unsigned char classes[256];
+
+        Table()
+        {
+            std::fill(classes, classes + 256, 0);
+
+            for (auto c : std::string("0123456789"))
+                classes[(unsigned char) c] |= DigitClass;
+
+            for (auto c : std::string("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ"))
+                classes[(unsigned char) c] |= LetterClass;
 
-    size_t position = possibles.find(Peek());
+            for (auto c : std::string("!\"#$%&\\\'()*+,-./0123456789:;<=>?@ABCDEFGHIJKLMNOPQRSTUVWXYZ[|]^_`abcdefghijklmnopqrstuvwxyz{}~"))
+                classes[(unsigned char) c] |= PrintableClass;
 
-    if (position != std::string::npos)
+            for (auto c : std::string(" \t\r"))
+                classes[(unsigned char) c] |= WhiteSpaceClass;
+
+            classes[(unsigned char) '\n'] |= LineBreakClass;
+        }
+    };
+
+    static const Table table;
+
+    return table.classes;
+}
+
+
+bool Lexer::OneOfClass(unsigned char character_class)
+{
+    if (position_ < length_
+        && (CharacterClasses()[(unsigned char) input_[position_]] & character_class))
     {
-        auto next = Next();
-        return next != "";
+        position_++;
+        return true;
     }
 
     return false;
 }
 
 
-bool Lexer::ManyOf(std::string possibles)
+bool Lexer::ManyOfClass(unsigned char character_class)
+{
+    auto classes = CharacterClasses();
+    auto start_position = position_;
+
+    while (position_ < length_
+           && (classes[(unsigned char) input_[position_]] & character_class))
+    {
+        position_++;
+    }
+
+    return position_ != start_position;
+}
+
+
+bool Lexer::ManyOfBlankClass(unsigned char character_class)
+{
+    auto classes = CharacterClasses();
+    auto start_position = position_;
+
+    // Most runs are a few bytes long, and are cheaper to step over than to
+    // look up; only index the file once a longer run turns up.
+    for (size_t i = 0; i < 8; i++)
+    {
+        if (position_ >= length_
+            || !(classes[(unsigned char) input_[position_]] & character_class))
+        {
+            return position_ != start_position;
+        }
+
+        position_++;
+    }
+
+    if (!index_)
+    {
+        index_ = &file_->Index();
+    }
+
+    position_ = (character_class & LineBreakClass) ? index_->NextNonBlank(position_)
+                                                   : index_->NextNonWhiteSpace(position_);
+    position_ = std::min(position_, length_);
+
+    return true;
+}
+
+
+bool Lexer::OneOf(const char* possibles)
+{
+    if (position_ >= length_)
+    {
+        return false;
+    }
+
+    auto next = input_[position_];
+
+    // strchr would also match the terminator of possibles.
+    if (next != '\0' && std::strchr(possibles, next))
+    {
+        position_++;
+        return true;
+    }
+
+    return false;
+}
+
+
+bool Lexer::ManyOf(const char* possibles)
 {
     bool has = false;
 
@@ -247,62 +376,94 @@ bool Lexer::ManyOf(std::string possibles)
 }
 
 
-bool Lexer::Until(std::string match)
+bool Lexer::Until(const char* match)
 {
+    // A single character can be found without looking at every byte.
+    if (match[0] != '\0' && match[1] == '\0')
+    {
+        // Line breaks are looked up once the file has been indexed.
+        if (match[0] == '\n' && index_)
+        {
+            position_ = index_->NextLineBreak(position_);
+
+            if (position_ >= length_)
+            {
+                position_ = length_;
+                return false;
+            }
+
+            position_++;
+            return true;
+        }
+
+        auto found = (const char*) std::memchr( input_ + position_
+                                              , match[0]
+                                              , length_ - position_);
+
+        if (!found)
+        {
+            position_ = length_;
+            return false;
+        }
+
+        position_ = found - input_ + 1;
+        return true;
+    }
+
     while (!OneOf(match))
     {
-        if (Next() == "")
+        if (position_ >= length_)
             return false;
+
+        position_++;
     }
 
     return true;
 }
 
 
-bool Lexer::MatchExactly(std::string match)
+bool Lexer::MatchExactly(const char* match)
 {
-    auto start_position = position_;
+    auto length = std::strlen(match);
 
-    for (auto m : match)
+    if (length_ - position_ < length
+        || std::memcmp(input_ + position_, match, length) != 0)
     {
-        if (!OneOf(std::string(1, m)))
-        {
-            BackupTo(start_position);
-            return false;
-        }
+        return false;
     }
 
+    position_ += length;
     return true;
 }
 
 
 bool Lexer::OneDigit()
 {
-    return OneOf("0123456789");
+    return OneOfClass(DigitClass);
 }
 
 
 bool Lexer::ManyDigits()
 {
-    return ManyOf("0123456789");
+    return ManyOfClass(DigitClass);
 }
 
 
 bool Lexer::OneLetter()
 {
-    return OneOf("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ");
+    return OneOfClass(LetterClass);
 }
 
 
 bool Lexer::ManyLetters()
 {
-    return ManyOf("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ");
+    return ManyOfClass(LetterClass);
 }
 
 
 bool Lexer::ManyCharacters()
 {
-    return ManyOf("!\"#$%&\\\'()*+,-./0123456789:;<=>?@ABCDEFGHIJKLMNOPQRSTUVWXYZ[|]^_`abcdefghijklmnopqrstuvwxyz{}~");
+    return ManyOfClass(PrintableClass);
 }
 
 
@@ -357,45 +518,25 @@ bool Lexer::Float()
 
 bool Lexer::Number()
 {
-    // Try for a float or int.
-    if (!Float())
-    {
-        if (!Integer())
-        {
-            return false;
-        }
-    }
+    // Recognise a float or int, with an optional exponent, in one pass.
+    auto end = NumberParser::Match(input_ + position_, input_ + length_);
 
-    auto start_position = position_;
-    
-    // We might have scientific notation.
-    if (OneOf("eE"))
+    if (end == input_ + position_)
     {
-        // Try and consume a flot or int again.
-        if (!Float())
-        {
-            if (!Integer())
-            {
-                // An e or E follow a number, but it isn't an exponent.
-                BackupTo(start_position);
-            }
-        }
+        return false;
     }
 
+    position_ = end - input_;
     return true;
 }
 
 
 bool Lexer::SkipWhiteSpace()
 {
-    if (!ManyOf(" \t\r"))
-    {
-        Skip();
-        return false;
-    }
+    bool skipped = ManyOfBlankClass(WhiteSpaceClass);
 
     Skip();
-    return true;
+    return skipped;
 }
 
 
@@ -435,20 +576,38 @@ bool Lexer::SkipLine()
 }
 
 
-State* Lexer::Error(std::string message)
+bool Lexer::SkipWhiteSpaceAndLineBreaks()
 {
+    bool skipped = ManyOfBlankClass(WhiteSpaceClass | LineBreakClass);
 
-    std::stringstream error;
-    error << "Error around line " << line_  << ": " << message << std::endl;
-   
-    last_error_ = error.str();
+    Skip();
+    return skipped;
+}
+
+
+bool Lexer::AtEndOfLine()
+{
+    return position_ < length_
+        && (input_[position_] == '\n' || input_[position_] == '\r');
+}
+
+
+bool Lexer::AtEndOfFile()
+{
+    return position_ >= length_;
+}
+
+
+State* Lexer::Error(std::string message)
+{
+    // Failed dry runs are routine while states are tried, so only note where
+    // they failed. The line number is looked up if the error is ever raised.
+    last_error_ = message;
+    last_error_position_ = position_;
 
     if (dry_run_) return nullptr;
-    
-    Item item { ErrorToken, position_, line_, "", error.str(), parent_item_, Items()};
-    items_.push_back(item);
 
-    Exceptions::LexerError("Lexer", error.str());
+    LastError();
 
     return nullptr;
 }
@@ -463,7 +622,11 @@ State* Lexer::LastError()
 
     else
     {
-        Exceptions::LexerError("Lexer", last_error_);
+        std::stringstream error;
+        error << "Error around line " << LineNumber(last_error_position_)
+              << ": " << last_error_ << std::endl;
+
+        Exceptions::LexerError("Lexer", error.str());
     }
         
     return nullptr;
@@ -476,7 +639,7 @@ bool Lexer::TestState(State* state)
     if (dry_run_) return false;
   
     // Check if an end line has been reached. 
-    if (end_line_ > 0 && line_ > end_line_) return false;
+    if (position_ > end_position_) return false;
 
     auto start_position = position_;
 
@@ -496,6 +659,33 @@ bool Lexer::TestState(State* state)
 }
 
 
+bool Lexer::Predict(const char* prefix)
+{
+    // Predictions stop at the same end line as TestState.
+    if (position_ > end_position_) return false;
+
+    auto classes = CharacterClasses();
+    auto position = position_;
+
+    // Look past blank space, as the states that are predicted skip it too.
+    while (position < length_
+           && (classes[(unsigned char) input_[position]] & (WhiteSpaceClass | LineBreakClass)))
+    {
+        position++;
+    }
+
+    if (position >= length_)
+    {
+        return false;
+    }
+
+    auto length = std::strlen(prefix);
+
+    return length_ - position >= length
+        && std::memcmp(input_ + position, prefix, length) == 0;
+}
+
+
 bool Lexer::IsDryRun()
 {
     return dry_run_;
@@ -504,7 +694,13 @@ bool Lexer::IsDryRun()
 
 size_t Lexer::LineNumber()
 {
-    return line_;
+    return LineNumber(position_);
+}
+
+
+size_t Lexer::LineNumber(size_t position)
+{
+    return file_->LineNumber(position);
 }
 
 
@@ -520,13 +716,13 @@ void Lexer::PrintMessage(std::string, std::string)
 #endif
 
 # ifdef CADMESH_LEXER_VERBOSE
-void Lexer::PrintItem(Item item)
+void Lexer::PrintItem(size_t index)
 {
     auto depth = std::max(0, depth_) * 2;
-    std::cout << std::string(depth, ' ') << item.token.name << ": " << item.value << std::endl;
+    std::cout << std::string(depth, ' ') << (*items_)[index].token.Name() << ": " << items_->Value(index) << std::endl;
 }
 # else
-void Lexer::PrintItem(Item)
+void Lexer::PrintItem(size_t)
 {
 }
 #endif
@@ -0,0 +1,265 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2011-2020 Christopher M. Poole <mail@christopherpoole.net>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+// CADMesh //
+#include "MappedFile.hh"
+
+// STL //
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <streambuf>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CADMESH_HAS_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+namespace CADMesh
+{
+
+namespace File
+{
+
+
+MappedFile::MappedFile(std::string filepath)
+{
+    if (!Map(filepath))
+    {
+        Read(filepath);
+    }
+}
+
+
+MappedFile::MappedFile(std::string filepath, size_t size)
+{
+    std::ifstream file(filepath, std::ios::binary);
+
+    buffer_.resize(size);
+    file.read(&buffer_[0], size);
+    buffer_.resize((size_t) file.gcount());
+
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+}
+
+
+MappedFile::~MappedFile()
+{
+#ifdef CADMESH_HAS_MMAP
+    if (mapping_)
+    {
+        munmap(mapping_, mapping_size_);
+    }
+#endif
+}
+
+
+const char* MappedFile::Data()
+{
+    return data_;
+}
+
+
+size_t MappedFile::Size()
+{
+    return size_;
+}
+
+
+bool MappedFile::IsMapped()
+{
+    return mapping_ != nullptr;
+}
+
+
+size_t MappedFile::LineNumber(size_t position)
+{
+    IndexLineBreaks();
+
+    // A line break belongs to the line it ends.
+    return 1 + std::lower_bound( line_breaks_.begin()
+                               , line_breaks_.end()
+                               , position) - line_breaks_.begin();
+}
+
+
+size_t MappedFile::EndOfLine(size_t line)
+{
+    IndexLineBreaks();
+
+    if (line == 0 || line > line_breaks_.size())
+    {
+        return std::string::npos;
+    }
+
+    return line_breaks_[line - 1];
+}
+
+
+std::vector<size_t> MappedFile::Split( size_t begin
+                                     , size_t end
+                                     , size_t chunks
+                                     , std::string prefix)
+{
+    std::vector<size_t> boundaries = { begin };
+
+    for (size_t i = 1; i < chunks; i++)
+    {
+        auto position = std::max(begin + (end - begin) * i / chunks, boundaries.back());
+
+        // Move to the start of the next line that starts with the prefix.
+        while (position < end)
+        {
+            auto line_break = (const char*) std::memchr(data_ + position, '\n', end - position);
+
+            if (!line_break)
+            {
+                position = end;
+                break;
+            }
+
+            position = line_break - data_ + 1;
+
+            auto first = data_ + position;
+            while (first < data_ + end && (*first == ' ' || *first == '\t')) first++;
+
+            if ((size_t) (data_ + end - first) >= prefix.size()
+                && std::memcmp(first, prefix.data(), prefix.size()) == 0)
+            {
+                break;
+            }
+        }
+
+        if (position >= end)
+        {
+            break;
+        }
+
+        if (position > boundaries.back())
+        {
+            boundaries.push_back(position);
+        }
+    }
+
+    boundaries.push_back(end);
+
+    return boundaries;
+}
+
+
+const StructuralIndex& MappedFile::Index()
+{
+    std::call_once(index_once_, [this]()
+    {
+        index_.reset(new StructuralIndex(data_, size_));
+    });
+
+    return *index_;
+}
+
+
+void MappedFile::IndexLineBreaks()
+{
+    // Readers may ask for line numbers from several threads at once.
+    std::call_once(index_line_breaks_, [this]()
+    {
+        auto& words = Index().LineBreaks();
+
+        for (size_t i = 0; i < words.size(); i++)
+        {
+            for (auto word = words[i]; word; word &= word - 1)
+            {
+                line_breaks_.push_back(64 * i + StructuralIndex::CountTrailingZeros(word));
+            }
+        }
+    });
+}
+
+
+bool MappedFile::Map(std::string filepath)
+{
+#ifdef CADMESH_HAS_MMAP
+    int fd = open(filepath.c_str(), O_RDONLY);
+
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat info;
+
+    // Only regular, non-empty files can be mapped.
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size <= 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    auto size = (size_t) info.st_size;
+    auto mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    // The mapping holds its own reference to the file.
+    close(fd);
+
+    if (mapping == MAP_FAILED)
+    {
+        return false;
+    }
+
+    // The lexers walk the input front to back.
+    madvise(mapping, size, MADV_SEQUENTIAL);
+
+    mapping_ = mapping;
+    mapping_size_ = size;
+
+    data_ = (const char*) mapping;
+    size_ = size;
+
+    return true;
+#else
+    (void) filepath;
+    return false;
+#endif
+}
+
+
+void MappedFile::Read(std::string filepath)
+{
+    std::ifstream file(filepath, std::ios::binary);
+    buffer_ = std::string( (std::istreambuf_iterator<char>(file))
+                         , std::istreambuf_iterator<char>());
+
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+}
+
+
+} // File namespace
+
+} // CADMesh namespace
+
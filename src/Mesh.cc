@@ -22,44 +22,155 @@
 
 // CADMesh //
 #include "Mesh.hh"
+#include "Decimation.hh"
+#include "Exceptions.hh"
+#include "Parallel.hh"
+
+// GEANT4 //
+#include "geomdefs.hh"
 
 // STL //
-#include <map>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <unordered_map>
 
 
 namespace CADMesh
 {
 
-Mesh::Mesh(Points points, Triangles triangles, G4String name)
+Mesh::Mesh(Points points, Indices indices, G4String name)
         : name_(name)
-        , points_(points)
-        , triangles_(triangles)
+        , indices_(std::move(indices))
 {
+    if (indices_.size() % 3 != 0)
+    {
+        Exceptions::InvalidMesh("Mesh::Mesh", "The number of indices is not a multiple of three.");
+    }
+
+    if (points.size() > std::numeric_limits<uint32_t>::max())
+    {
+        Exceptions::InvalidMesh("Mesh::Mesh", "The mesh has too many points to index.");
+    }
+
+    // Keep only the points that are used, in the order they were given.
+    std::vector<uint32_t> remap(points.size(), std::numeric_limits<uint32_t>::max());
+
+    for (auto& index : indices_)
+    {
+        if (index >= points.size())
+        {
+            Exceptions::InvalidMesh("Mesh::Mesh", "A triangle refers to a point that doesn't exist.");
+        }
+
+        remap[index] = 0;
+    }
+
+    uint32_t next = 0;
+
+    for (auto& index : remap)
+    {
+        if (index == 0)
+        {
+            index = next++;
+        }
+    }
+
+    x_.resize(next);
+    y_.resize(next);
+    z_.resize(next);
+
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        if (remap[i] != std::numeric_limits<uint32_t>::max())
+        {
+            x_[remap[i]] = points[i].x();
+            y_[remap[i]] = points[i].y();
+            z_[remap[i]] = points[i].z();
+        }
+    }
+
+    for (auto& index : indices_)
+    {
+        index = remap[index];
+    }
 }
 
 
 std::shared_ptr<Mesh> Mesh::New( Points points
-                               , Triangles triangles
+                               , Indices indices
                                , G4String name)
 {
-    return std::make_shared<Mesh>(points, triangles, name);
+    return std::make_shared<Mesh>(std::move(points), std::move(indices), name);
+}
+
+
+std::shared_ptr<Mesh> Mesh::FromCorners( Points corners
+                                       , G4String name)
+{
+    if (corners.size() % 3 != 0)
+    {
+        Exceptions::InvalidMesh("Mesh::FromCorners", "The number of corners is not a multiple of three.");
+    }
+
+    std::unordered_map<G4ThreeVector, uint32_t, PointHash> point_index;
+    point_index.reserve(corners.size() / 2);
+
+    Points points;
+    Indices indices(corners.size());
+
+    for (size_t i = 0; i < corners.size(); i++)
+    {
+        auto found = point_index.find(corners[i]);
+
+        if (found != point_index.end())
+        {
+            indices[i] = found->second;
+            continue;
+        }
+
+        if (points.size() == std::numeric_limits<uint32_t>::max())
+        {
+            Exceptions::InvalidMesh("Mesh::FromCorners", "The mesh has too many points to index.");
+        }
+
+        indices[i] = points.size();
+        point_index.emplace(corners[i], indices[i]);
+        points.push_back(corners[i]);
+    }
+
+    return New(std::move(points), std::move(indices), name);
 }
 
 
 std::shared_ptr<Mesh> Mesh::New( Triangles triangles
                                , G4String name)
 {
-    Points points;
-    //TODO: Extract the unique set of points from the triangles.
+    Points corners;
+    corners.reserve(3 * triangles.size());
 
-    return New(points, triangles, name);
+    for (auto triangle : triangles)
+    {
+        corners.push_back(triangle->GetVertex(0));
+        corners.push_back(triangle->GetVertex(1));
+        corners.push_back(triangle->GetVertex(2));
+
+        delete triangle;
+    }
+
+    return FromCorners(std::move(corners), name);
 }
 
 
 std::shared_ptr<Mesh> Mesh::New( std::shared_ptr<Mesh> mesh
                                , G4String name )
 {
-    return New(mesh->GetPoints(), mesh->GetTriangles(), name);
+    auto copy = std::make_shared<Mesh>(*mesh);
+    copy->name_ = name;
+
+    return copy;
 }
 
 
@@ -69,84 +180,777 @@ G4String Mesh::GetName()
 }
 
 
+size_t Mesh::GetNumberOfPoints()
+{
+    return x_.size();
+}
+
+
+size_t Mesh::GetNumberOfTriangles()
+{
+    return indices_.size() / 3;
+}
+
+
+G4ThreeVector Mesh::GetPoint(size_t index)
+{
+    return G4ThreeVector(x_[index], y_[index], z_[index]);
+}
+
+
 Points Mesh::GetPoints()
 {
-    return points_;
+    Points points(x_.size());
+
+    for (size_t i = 0; i < x_.size(); i++)
+    {
+        points[i] = GetPoint(i);
+    }
+
+    return points;
+}
+
+
+const std::vector<G4double>& Mesh::GetX()
+{
+    return x_;
+}
+
+
+const std::vector<G4double>& Mesh::GetY()
+{
+    return y_;
+}
+
+
+const std::vector<G4double>& Mesh::GetZ()
+{
+    return z_;
+}
+
+
+const Indices& Mesh::GetIndices()
+{
+    return indices_;
 }
 
 
 Triangles Mesh::GetTriangles()
 {
-    return triangles_;
+    Triangles triangles(GetNumberOfTriangles());
+
+    for (size_t i = 0; i < triangles.size(); i++)
+    {
+        triangles[i] = new G4TriangularFacet( GetPoint(indices_[3 * i])
+                                            , GetPoint(indices_[3 * i + 1])
+                                            , GetPoint(indices_[3 * i + 2])
+                                            , ABSOLUTE);
+    }
+
+    return triangles;
 }
 
 
 G4bool Mesh::IsValidForNavigation()
 {
-    std::map<G4ThreeVector, size_t> point_index;
+    return Validate().IsValidForNavigation();
+}
+
+
+Validation Mesh::Validate(size_t threads)
+{
+    Validation validation;
+    validation.name = name_;
+    validation.number_of_facets = GetNumberOfTriangles();
+
+    auto count = x_.size();
+    auto facets = GetNumberOfTriangles();
+
+    if (threads == 0)
+    {
+        threads = NumberOfThreads(indices_.size(), 1 << 16);
+    }
+
+    // Points at the same position are the same point, however they are
+    // indexed. Each is known by the first point at its position.
+    std::vector<uint32_t> order(count);
 
-    size_t index = 0;
-    for (auto point : points_)
+    for (size_t i = 0; i < count; i++)
     {
-        point_index[point] = index;
-        index++;
+        order[i] = i;
     }
 
-    typedef std::pair<size_t, size_t> Edge; // such that Edge.first < Edge.second
+    auto same_position = [&](uint32_t a, uint32_t b)
+    {
+        return x_[a] == x_[b] && y_[a] == y_[b] && z_[a] == z_[b];
+    };
+
+    ParallelSort(order.begin(), order.end(), threads, [&](uint32_t a, uint32_t b)
+    {
+        if (x_[a] != x_[b]) return x_[a] < x_[b];
+        if (y_[a] != y_[b]) return y_[a] < y_[b];
+        if (z_[a] != z_[b]) return z_[a] < z_[b];
+
+        return a < b;
+    });
 
-    std::map<Edge, G4int> edge_use_count;
+    std::vector<uint32_t> point_of(count);
 
-    for(size_t i=0; i < triangles_.size(); i++)
+    for (size_t k = 0; k < count; k++)
     {
-        auto triangle = triangles_[i];
+        if (k > 0 && same_position(order[k], order[k - 1]))
+            point_of[order[k]] = point_of[order[k - 1]];
 
-        size_t a = point_index[triangle->GetVertex(0)];
-        size_t b = point_index[triangle->GetVertex(1)];
-        size_t c = point_index[triangle->GetVertex(2)];
+        else
+            point_of[order[k]] = order[k];
+    }
+
+    std::vector<uint32_t>().swap(order);
 
-        if (a < b)
+    // Each facet uses three edges, keyed by their two points with the lower
+    // first, and marked by whether the facet runs along them from lower to
+    // higher. Edges between points at the same position are left out, with
+    // a key that sorts last.
+    struct Use
+    {
+        uint64_t key;
+        uint64_t use;
+
+        bool operator<(const Use& other) const
         {
-            edge_use_count[Edge(a, b)] += 1; 
+            return key < other.key || (key == other.key && use < other.use);
         }
+    };
+
+    const auto none = std::numeric_limits<uint64_t>::max();
 
-        else if (a > b)
+    std::vector<Use> uses(3 * facets);
+    std::vector<std::vector<Validation::Facet> > degenerate(threads);
+
+    ParallelFor(threads, threads, [&](size_t t)
+    {
+        for (size_t f = facets * t / threads; f < facets * (t + 1) / threads; f++)
         {
-            edge_use_count[Edge(b, a)] += 1; 
+            for (size_t corner = 0; corner < 3; corner++)
+            {
+                uint64_t from = point_of[indices_[3 * f + corner]];
+                uint64_t to = point_of[indices_[3 * f + (corner + 1) % 3]];
+
+                if (from == to)
+                    uses[3 * f + corner] = { none, 0 };
+
+                else if (from < to)
+                    uses[3 * f + corner] = { (from << 32) | to, (f << 1) | 1 };
+
+                else
+                    uses[3 * f + corner] = { (to << 32) | from, f << 1 };
+            }
+
+            // The same test as G4TriangularFacet.
+            auto a = GetPoint(indices_[3 * f]);
+            auto b = GetPoint(indices_[3 * f + 1]);
+            auto c = GetPoint(indices_[3 * f + 2]);
+
+            auto e1 = b - a;
+            auto e2 = c - a;
+
+            auto length1 = e1.mag();
+            auto length2 = (e2 - e1).mag();
+            auto length3 = e2.mag();
+
+            auto longest = std::max({ length1, length2, length3 });
+
+            if ( std::min({ length1, length2, length3 }) <= kCarTolerance
+              || e1.cross(e2).mag() / longest <= kCarTolerance)
+            {
+                degenerate[t].push_back({ f, a, b, c });
+            }
         }
+    });
 
-        if (b < c)
+    ParallelSort(uses.begin(), uses.end(), threads, [](const Use& a, const Use& b)
+    {
+        return a < b;
+    });
+
+    auto used = std::lower_bound(uses.begin(), uses.end(), Use { none, 0 }) - uses.begin();
+
+    // Each thread looks at the edges that start in its block of the uses.
+    std::vector<Validation> found(threads);
+
+    ParallelFor(threads, threads, [&](size_t t)
+    {
+        size_t start = used * t / threads;
+        size_t end = used * (t + 1) / threads;
+
+        while (start > 0 && start < end && uses[start].key == uses[start - 1].key)
         {
-            edge_use_count[Edge(b, c)] += 1; 
+            start++;
+        }
+
+        while (start < end)
+        {
+            auto last = start + 1;
+
+            while (last < (size_t) used && uses[last].key == uses[start].key)
+            {
+                last++;
+            }
+
+            auto key = uses[start].key;
+            auto forward = uses[start].use & 1;
+
+            auto lower = GetPoint(key >> 32);
+            auto higher = GetPoint(key & 0xffffffff);
+
+            Validation::Edge edge;
+            edge.start = forward ? lower : higher;
+            edge.end = forward ? higher : lower;
+
+            for (auto k = start; k < last; k++)
+            {
+                edge.facets.push_back(uses[k].use >> 1);
+            }
+
+            if (last - start == 1)
+                found[t].boundary_edges.push_back(edge);
+
+            else if (last - start > 2)
+                found[t].non_manifold_edges.push_back(edge);
+
+            else if ((uses[start + 1].use & 1) == forward)
+                found[t].misoriented_edges.push_back(edge);
+
+            start = last;
         }
+    });
+
+    auto append = [](std::vector<Validation::Edge>& to, std::vector<Validation::Edge>& from)
+    {
+        to.insert(to.end(), from.begin(), from.end());
+    };
+
+    for (size_t t = 0; t < threads; t++)
+    {
+        append(validation.boundary_edges, found[t].boundary_edges);
+        append(validation.non_manifold_edges, found[t].non_manifold_edges);
+        append(validation.misoriented_edges, found[t].misoriented_edges);
 
-        else if (b > c)
+        validation.degenerate_facets.insert( validation.degenerate_facets.end()
+                                           , degenerate[t].begin()
+                                           , degenerate[t].end());
+    }
+
+    return validation;
+}
+
+
+void Mesh::Weld(G4double tolerance, G4bool relative, size_t threads)
+{
+    auto count = x_.size();
+
+    if (count == 0)
+    {
+        return;
+    }
+
+    if (threads == 0)
+    {
+        threads = NumberOfThreads(count, 1 << 16);
+    }
+
+    auto x = std::minmax_element(x_.begin(), x_.end());
+    auto y = std::minmax_element(y_.begin(), y_.end());
+    auto z = std::minmax_element(z_.begin(), z_.end());
+
+    if (relative)
+    {
+        tolerance *= std::sqrt( std::pow(*x.second - *x.first, 2)
+                              + std::pow(*y.second - *y.first, 2)
+                              + std::pow(*z.second - *z.first, 2));
+    }
+
+    // Points are put in cells twice the tolerance across, so any two within
+    // the tolerance are in the same cell or in one of the seven neighbours
+    // on the sides of the cell each is nearest. With no tolerance, a cell is
+    // one exact position.
+    struct Cell
+    {
+        int64_t x, y, z;
+
+        bool operator<(const Cell& other) const
         {
-            edge_use_count[Edge(c, b)] += 1; 
+            return x < other.x || (x == other.x && (y < other.y || (y == other.y && z < other.z)));
         }
 
-        if (c < a)
+        bool operator==(const Cell& other) const
         {
-            edge_use_count[Edge(c, a)] += 1; 
+            return x == other.x && y == other.y && z == other.z;
         }
+    };
+
+    // Cells are kept few enough to number with integers.
+    auto range = std::max({ *x.second - *x.first, *y.second - *y.first, *z.second - *z.first });
+    auto size = tolerance > 0 ? std::max(2 * tolerance, range / std::pow(2.0, 52)) : 0.0;
 
-        else if (c > a)
+    auto cell_of = [&](G4double value, G4double origin)
+    {
+        if (size > 0)
         {
-            edge_use_count[Edge(a, c)] += 1; 
- 
+            return (int64_t) std::floor((value - origin) / size);
         }
+
+        // So that 0 and -0 are the same position.
+        value += 0.0;
+
+        int64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+
+        return bits;
+    };
+
+    std::vector<Cell> cells(count);
+
+    ParallelFor(count, threads, [&](size_t i)
+    {
+        cells[i] = { cell_of(x_[i], *x.first)
+                   , cell_of(y_[i], *y.first)
+                   , cell_of(z_[i], *z.first) };
+    });
+
+    // Sort the points by cell, and by index within a cell.
+    std::vector<uint32_t> order(count);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        order[i] = i;
     }
 
-    // Every edge should be shared with exactly two triangles.
-    for (auto count : edge_use_count)
+    ParallelSort(order.begin(), order.end(), threads, [&](uint32_t a, uint32_t b)
     {
-        if (count.second != 2)
+        return cells[a] < cells[b] || (cells[a] == cells[b] && a < b);
+    });
+
+    // Where the points of each occupied cell start in the order.
+    std::vector<size_t> starts;
+
+    for (size_t k = 0; k < count; k++)
+    {
+        if (k == 0 || !(cells[order[k]] == cells[order[k - 1]]))
+        {
+            starts.push_back(k);
+        }
+    }
+
+    auto groups = starts.size();
+    starts.push_back(count);
+
+    auto find_group = [&](const Cell& cell)
+    {
+        size_t low = 0;
+        size_t high = groups;
+
+        while (low < high)
+        {
+            auto middle = (low + high) / 2;
+
+            if (cells[order[starts[middle]]] < cell)
+                low = middle + 1;
+
+            else
+                high = middle;
+        }
+
+        return (low < groups && cells[order[starts[low]]] == cell) ? low : groups;
+    };
+
+    // Find the pairs of points to merge, a block of cells per thread. Each
+    // pair is found from its later point only.
+    typedef std::pair<uint32_t, uint32_t> Pair;
+    std::vector<std::vector<Pair> > pairs(threads);
+
+    auto tolerance_squared = tolerance * tolerance;
+
+    ParallelFor(threads, threads, [&](size_t t)
+    {
+        for (size_t g = groups * t / threads; g < groups * (t + 1) / threads; g++)
+        {
+            for (size_t k = starts[g]; k < starts[g + 1]; k++)
+            {
+                auto i = order[k];
+
+                if (size == 0)
+                {
+                    if (k > starts[g])
+                        pairs[t].push_back(Pair(i, order[starts[g]]));
+
+                    continue;
+                }
+
+                auto cell = cells[i];
+
+                int64_t sides[3] = { 1, 1, 1 };
+                G4double offsets[3] = { x_[i] - *x.first, y_[i] - *y.first, z_[i] - *z.first };
+                int64_t indices[3] = { cell.x, cell.y, cell.z };
+
+                for (size_t axis = 0; axis < 3; axis++)
+                {
+                    if (offsets[axis] - indices[axis] * size < tolerance)
+                        sides[axis] = -1;
+                }
+
+                for (size_t neighbour = 0; neighbour < 8; neighbour++)
+                {
+                    Cell other = { cell.x + ((neighbour & 1) ? sides[0] : 0)
+                                 , cell.y + ((neighbour & 2) ? sides[1] : 0)
+                                 , cell.z + ((neighbour & 4) ? sides[2] : 0) };
+
+                    auto h = neighbour == 0 ? g : find_group(other);
+
+                    if (h == groups)
+                        continue;
+
+                    for (size_t m = starts[h]; m < starts[h + 1]; m++)
+                    {
+                        auto j = order[m];
+
+                        if (j >= i)
+                            continue;
+
+                        auto dx = x_[i] - x_[j];
+                        auto dy = y_[i] - y_[j];
+                        auto dz = z_[i] - z_[j];
+
+                        if (dx * dx + dy * dy + dz * dz <= tolerance_squared)
+                            pairs[t].push_back(Pair(i, j));
+                    }
+                }
+            }
+        }
+    });
+
+    // Join the pairs into groups led by their first point. The groups don't
+    // depend on the order the pairs are joined in.
+    std::vector<uint32_t> parent(count);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        parent[i] = i;
+    }
+
+    auto find = [&](uint32_t i)
+    {
+        while (parent[i] != i)
+        {
+            parent[i] = parent[parent[i]];
+            i = parent[i];
+        }
+
+        return i;
+    };
+
+    for (auto& block : pairs)
+    {
+        for (auto& pair : block)
+        {
+            auto a = find(pair.first);
+            auto b = find(pair.second);
+
+            if (a < b) parent[b] = a;
+            if (b < a) parent[a] = b;
+        }
+    }
+
+    // Renumber the points that lead a group, keeping their order.
+    std::vector<uint32_t> remap(count);
+    uint32_t next = 0;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        auto leader = find(i);
+
+        if (leader == i)
+        {
+            x_[next] = x_[i];
+            y_[next] = y_[i];
+            z_[next] = z_[i];
+
+            remap[i] = next++;
+        }
+
+        else
         {
-            return false;
+            remap[i] = remap[leader];
         }
     }
-   
-    return true; 
 
+    x_.resize(next);
+    y_.resize(next);
+    z_.resize(next);
+
+    x_.shrink_to_fit();
+    y_.shrink_to_fit();
+    z_.shrink_to_fit();
+
+    ParallelFor(indices_.size(), threads, [&](size_t i)
+    {
+        indices_[i] = remap[indices_[i]];
+    });
+
+    // Drop the triangles that lost a corner to the weld, keeping the order
+    // of the rest.
+    size_t kept = 0;
+
+    for (size_t i = 0; i + 2 < indices_.size(); i += 3)
+    {
+        auto a = indices_[i];
+        auto b = indices_[i + 1];
+        auto c = indices_[i + 2];
+
+        if (a == b || b == c || c == a)
+        {
+            continue;
+        }
+
+        indices_[kept++] = a;
+        indices_[kept++] = b;
+        indices_[kept++] = c;
+    }
+
+    indices_.resize(kept);
+
+    modification_count_++;
+}
+
+
+FacetRepair Mesh::RepairDegenerateFacets( G4double minimum_area
+                                        , G4double maximum_aspect_ratio
+                                        , G4double tolerance
+                                        , size_t threads)
+{
+    if (threads == 0)
+    {
+        threads = NumberOfThreads(indices_.size() / 3, 1 << 16);
+    }
+
+    modification_count_++;
+
+    return FacetRepair( x_, y_, z_, indices_
+                      , tolerance, minimum_area, maximum_aspect_ratio, threads);
+}
+
+
+G4double Mesh::Decimate(size_t target, G4double maximum_deviation, size_t threads)
+{
+    if (indices_.empty())
+    {
+        return 0;
+    }
+
+    if (threads == 0)
+    {
+        threads = NumberOfThreads(indices_.size() / 3, 1 << 16);
+    }
+
+    Decimation decimation(GetPoints(), indices_, target, maximum_deviation, threads);
+
+    auto& points = decimation.GetPoints();
+
+    x_.resize(points.size());
+    y_.resize(points.size());
+    z_.resize(points.size());
+
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        x_[i] = points[i].x();
+        y_[i] = points[i].y();
+        z_[i] = points[i].z();
+    }
+
+    indices_ = decimation.GetIndices();
+
+    modification_count_++;
+
+    return decimation.GetHausdorffDistance();
+}
+
+
+void Mesh::Reorder(size_t threads)
+{
+    auto facets = GetNumberOfTriangles();
+
+    if (facets == 0)
+    {
+        return;
+    }
+
+    if (threads == 0)
+    {
+        threads = NumberOfThreads(facets, 1 << 16);
+    }
+
+    auto x = std::minmax_element(x_.begin(), x_.end());
+    auto y = std::minmax_element(y_.begin(), y_.end());
+    auto z = std::minmax_element(z_.begin(), z_.end());
+
+    // The cells are cubes, so that the curve is as local along each axis,
+    // and there are about 64 for each triangle. Finer cells would order the
+    // triangles no better, and take longer to find the distance to.
+    uint32_t levels = 1;
+
+    while (levels < 21 && (uint64_t(1) << (3 * levels)) < 64 * (uint64_t) facets)
+    {
+        levels++;
+    }
+
+    const uint32_t last = (1u << levels) - 1;
+
+    auto range = std::max({ *x.second - *x.first, *y.second - *y.first, *z.second - *z.first });
+    auto scale = range > 0 ? last / range : 0.0;
+
+    auto cell_of = [&](G4double value, G4double origin)
+    {
+        return std::min(last, (uint32_t) ((value - origin) * scale));
+    };
+
+    std::vector<uint64_t> keys(facets);
+    std::vector<uint32_t> order(facets);
+
+    ParallelFor(facets, threads, [&](size_t f)
+    {
+        auto a = indices_[3 * f];
+        auto b = indices_[3 * f + 1];
+        auto c = indices_[3 * f + 2];
+
+        uint32_t cell[3] = { cell_of((x_[a] + x_[b] + x_[c]) / 3, *x.first)
+                           , cell_of((y_[a] + y_[b] + y_[c]) / 3, *y.first)
+                           , cell_of((z_[a] + z_[b] + z_[c]) / 3, *z.first) };
+
+        keys[f] = HilbertIndex(cell, levels);
+        order[f] = f;
+    });
+
+    ParallelRadixSort(keys, order, threads);
+    std::vector<uint64_t>().swap(keys);
+
+    // Points no triangle uses keep their order, after the rest.
+    const auto none = std::numeric_limits<uint32_t>::max();
+
+    std::vector<uint32_t> renumbered(x_.size(), none);
+    Indices indices(indices_.size());
+
+    uint32_t next = 0;
+
+    for (size_t k = 0; k < facets; k++)
+    {
+        for (size_t corner = 0; corner < 3; corner++)
+        {
+            auto& point = renumbered[indices_[3 * order[k] + corner]];
+
+            if (point == none)
+                point = next++;
+
+            indices[3 * k + corner] = point;
+        }
+    }
+
+    for (auto& point : renumbered)
+    {
+        if (point == none)
+            point = next++;
+    }
+
+    std::vector<G4double> moved(x_.size());
+
+    for (auto coordinate : { &x_, &y_, &z_ })
+    {
+        ParallelFor(moved.size(), threads, [&](size_t p)
+        {
+            moved[renumbered[p]] = (*coordinate)[p];
+        });
+
+        coordinate->swap(moved);
+    }
+
+    indices_.swap(indices);
+
+    modification_count_++;
+}
+
+
+uint64_t Mesh::HilbertIndex(uint32_t coordinates[3], uint32_t levels)
+{
+    // Skilling's transform, from "Programming the Hilbert curve" (2004),
+    // turns the coordinates into the bits of the distance, spread across
+    // the three of them. First the rotations are undone, with masks rather
+    // than branches, as the bits are no more likely one than the other.
+    const uint32_t top = 1u << (levels - 1);
+
+    for (uint32_t q = top; q > 1; q >>= 1)
+    {
+        auto p = q - 1;
+
+        for (size_t i = 0; i < 3; i++)
+        {
+            uint32_t set = -(uint32_t) ((coordinates[i] & q) != 0);
+            auto t = (coordinates[0] ^ coordinates[i]) & p & ~set;
+
+            coordinates[0] ^= (p & set) | t;
+            coordinates[i] ^= t;
+        }
+    }
+
+    // Then the Gray code is encoded.
+    coordinates[1] ^= coordinates[0];
+    coordinates[2] ^= coordinates[1];
+
+    uint32_t t = 0;
+
+    for (uint32_t q = top; q > 1; q >>= 1)
+    {
+        t ^= (q - 1) & -(uint32_t) ((coordinates[2] & q) != 0);
+    }
+
+    // The bits of each are spread two apart, and interleaved.
+    auto spread = [](uint64_t bits)
+    {
+        bits &= 0x1fffff;
+        bits = (bits | bits << 32) & 0x1f00000000ffffull;
+        bits = (bits | bits << 16) & 0x1f0000ff0000ffull;
+        bits = (bits | bits << 8) & 0x100f00f00f00f00full;
+        bits = (bits | bits << 4) & 0x10c30c30c30c30c3ull;
+        bits = (bits | bits << 2) & 0x1249249249249249ull;
+
+        return bits;
+    };
+
+    return spread(coordinates[0] ^ t) << 2
+         | spread(coordinates[1] ^ t) << 1
+         | spread(coordinates[2] ^ t);
+}
+
+
+void Mesh::Release()
+{
+    std::vector<G4double>().swap(x_);
+    std::vector<G4double>().swap(y_);
+    std::vector<G4double>().swap(z_);
+
+    Indices().swap(indices_);
+
+    released_ = true;
+}
+
+
+G4bool Mesh::IsReleased()
+{
+    return released_;
+}
+
+
+size_t Mesh::GetModificationCount()
+{
+    return modification_count_;
 }
 
 } // CADMesh namespace
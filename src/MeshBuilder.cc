@@ -0,0 +1,96 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2011-2020 Christopher M. Poole <mail@christopherpoole.net>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// CADMesh //
+#include "MeshBuilder.hh"
+#include "Exceptions.hh"
+
+// STL //
+#include <limits>
+
+
+namespace CADMesh
+{
+
+namespace File
+{
+
+void MeshBuilder::StartMesh(G4String name)
+{
+    name_ = name;
+
+    points_.clear();
+    indices_.clear();
+    point_index_.clear();
+}
+
+
+void MeshBuilder::AddTriangle( const G4ThreeVector& a
+                             , const G4ThreeVector& b
+                             , const G4ThreeVector& c)
+{
+    AddCorner(a);
+    AddCorner(b);
+    AddCorner(c);
+}
+
+
+void MeshBuilder::AddCorner(const G4ThreeVector& corner)
+{
+    auto found = point_index_.find(corner);
+
+    if (found != point_index_.end())
+    {
+        indices_.push_back(found->second);
+        return;
+    }
+
+    if (points_.size() == std::numeric_limits<uint32_t>::max())
+    {
+        Exceptions::InvalidMesh("MeshBuilder::AddTriangle", "The mesh has too many points to index.");
+    }
+
+    indices_.push_back(points_.size());
+    point_index_.emplace(corner, indices_.back());
+    points_.push_back(corner);
+}
+
+
+void MeshBuilder::EndMesh()
+{
+    meshes_.push_back(Mesh::New(std::move(points_), std::move(indices_), name_));
+
+    points_.clear();
+    indices_.clear();
+    point_index_.clear();
+}
+
+
+Meshes MeshBuilder::GetMeshes()
+{
+    return meshes_;
+}
+
+} // File namespace
+
+} // CADMesh namespace
+
@@ -0,0 +1,296 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2011-2020 Christopher M. Poole <mail@christopherpoole.net>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// CADMesh //
+#include "NumberParser.hh"
+
+// STL //
+#include <cfloat>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define CADMESH_LITTLE_ENDIAN
+#endif
+
+
+namespace CADMesh
+{
+
+namespace File
+{
+
+const char* NumberParser::Parse(const char* begin, const char* end, double& value)
+{
+    auto p = begin;
+    auto negative = false;
+
+    if (p < end && (*p == '+' || *p == '-'))
+    {
+        negative = *p == '-';
+        p++;
+    }
+
+    uint64_t mantissa = 0;
+    int digits = 0;
+
+    // The integer part.
+    auto integer = p;
+    p = Digits(p, end, mantissa, digits);
+
+    if (p == integer)
+    {
+        value = 0;
+        return begin;
+    }
+
+    int64_t exponent = 0;
+
+    // The fractional part, which needs at least one digit.
+    if (p + 1 < end && *p == '.' && IsDigit(p[1]))
+    {
+        auto fraction = p + 1;
+        p = Digits(fraction, end, mantissa, digits);
+
+        exponent -= p - fraction;
+    }
+
+    p = Exponent(p, end, exponent);
+
+    // Clinger's fast path: when the mantissa and the power of ten are both
+    // exact doubles, a single multiply or divide is correctly rounded. This
+    // covers the short coordinates meshes are written with.
+    static const double powers[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    const uint64_t max_mantissa = 1ull << 53;
+
+    if (FLT_EVAL_METHOD == 0 && digits <= 19)
+    {
+        if (mantissa == 0)
+        {
+            value = negative ? -0.0 : 0.0;
+            return p;
+        }
+
+        // Move excess powers of ten into the mantissa while it stays exact.
+        while (exponent > 22 && exponent <= 22 + 15 && mantissa <= max_mantissa / 10)
+        {
+            mantissa *= 10;
+            exponent--;
+        }
+
+        if (mantissa <= max_mantissa && exponent >= -22 && exponent <= 22)
+        {
+            value = exponent < 0 ? (double) mantissa / powers[-exponent]
+                                 : (double) mantissa * powers[exponent];
+
+            if (negative)
+                value = -value;
+
+            return p;
+        }
+    }
+
+    // Anything else is rare enough to hand to strtod.
+    auto length = (size_t) (p - begin);
+    char buffer[64];
+
+    if (length < sizeof(buffer))
+    {
+        std::memcpy(buffer, begin, length);
+        buffer[length] = '\0';
+
+        value = std::strtod(buffer, nullptr);
+    }
+
+    else
+    {
+        value = std::strtod(std::string(begin, p).c_str(), nullptr);
+    }
+
+    return p;
+}
+
+
+const char* NumberParser::Parse(const char* begin, const char* end, long& value)
+{
+    auto p = begin;
+    auto negative = false;
+
+    if (p < end && (*p == '+' || *p == '-'))
+    {
+        negative = *p == '-';
+        p++;
+    }
+
+    unsigned long magnitude = 0;
+    auto digits = p;
+
+    while (p < end && IsDigit(*p))
+    {
+        magnitude = magnitude * 10 + (unsigned long) (*p - '0');
+        p++;
+    }
+
+    if (p == digits)
+    {
+        value = 0;
+        return begin;
+    }
+
+    value = negative ? -(long) magnitude : (long) magnitude;
+
+    return p;
+}
+
+
+const char* NumberParser::Match(const char* begin, const char* end)
+{
+    auto p = begin;
+
+    if (p < end && (*p == '+' || *p == '-'))
+        p++;
+
+    auto integer = p;
+
+    while (p < end && IsDigit(*p))
+        p++;
+
+    if (p == integer)
+        return begin;
+
+    if (p + 1 < end && *p == '.' && IsDigit(p[1]))
+    {
+        p++;
+
+        while (p < end && IsDigit(*p))
+            p++;
+    }
+
+    int64_t exponent = 0;
+
+    return Exponent(p, end, exponent);
+}
+
+
+// Accumulates a run of digits into the mantissa. The mantissa is exact while
+// digits, the count of significant digits so far, is at most 19.
+const char* NumberParser::Digits( const char* begin
+                                , const char* end
+                                , uint64_t& mantissa
+                                , int& digits)
+{
+    auto p = begin;
+
+    // Skip leading zeros, they are not significant.
+    if (mantissa == 0)
+    {
+        while (p < end && *p == '0')
+            p++;
+    }
+
+#ifdef CADMESH_LITTLE_ENDIAN
+    // Eight digits at a time, while they fit in the mantissa.
+    while (end - p >= 8 && digits <= 19 - 8)
+    {
+        uint64_t chunk;
+        std::memcpy(&chunk, p, sizeof(chunk));
+
+        // Every byte is in '0'...'9'.
+        if (((chunk & 0xF0F0F0F0F0F0F0F0) |
+            (((chunk + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) >> 4)) != 0x3333333333333333)
+        {
+            break;
+        }
+
+        // Combine pairs of digits, then pairs of pairs, then the two halves.
+        chunk -= 0x3030303030303030;
+        chunk = (chunk * 10) + (chunk >> 8);
+        chunk = (((chunk & 0x000000FF000000FF) * 0x000F424000000064)
+              + (((chunk >> 16) & 0x000000FF000000FF) * 0x0000271000000001)) >> 32;
+
+        mantissa = mantissa * 100000000 + (uint32_t) chunk;
+        digits += 8;
+        p += 8;
+    }
+#endif
+
+    while (p < end && IsDigit(*p))
+    {
+        if (digits < 19)
+        {
+            mantissa = mantissa * 10 + (uint64_t) (*p - '0');
+        }
+
+        digits++;
+        p++;
+    }
+
+    return p;
+}
+
+
+// An optional exponent, which needs at least one digit after the e.
+const char* NumberParser::Exponent(const char* begin, const char* end, int64_t& exponent)
+{
+    auto p = begin;
+
+    if (p >= end || (*p != 'e' && *p != 'E'))
+        return begin;
+
+    p++;
+
+    auto negative = false;
+
+    if (p < end && (*p == '+' || *p == '-'))
+    {
+        negative = *p == '-';
+        p++;
+    }
+
+    if (p >= end || !IsDigit(*p))
+        return begin;
+
+    int64_t value = 0;
+
+    while (p < end && IsDigit(*p))
+    {
+        // Anything this large is handled by strtod anyway.
+        if (value < 100000)
+            value = value * 10 + (*p - '0');
+
+        p++;
+    }
+
+    exponent += negative ? -value : value;
+
+    return p;
+}
+
+} // File namespace
+
+} // CADMesh namespace
+
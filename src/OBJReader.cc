@@ -23,6 +23,12 @@
 // CADMesh //
 #include "OBJReader.hh"
 #include "Exceptions.hh"
+#include "NumberParser.hh"
+#include "Parallel.hh"
+
+// STL //
+#include <algorithm>
+#include <cstring>
 
 
 namespace CADMesh
@@ -36,11 +42,11 @@ State* OBJReader::CADMeshLexerState(StartSolid)
 {
     StartOfA(Solid);
 
-    TryState(Object);
-    TryState(Vertex);
-    TryState(Ignore);
- 
-    Error("Invalid element tag.");
+    // Chunks of a file can start on any line.
+    PredictState(Object, "o ");
+    PredictState(Vertex, "v ");
+    PredictState(Facet, "f ");
+    NextState(Ignore);
 }
 
 
@@ -59,18 +65,16 @@ State* OBJReader::CADMeshLexerState(Ignore)
     if (DidNotSkipLine())
         NextState(EndSolid);
     
-    TryState(Object);
-    TryState(Vertex);
-    TryState(Facet);
-    TryState(Ignore);
-  
-    NextState(EndSolid);
+    PredictState(Object, "o ");
+    PredictState(Vertex, "v ");
+    PredictState(Facet, "f ");
+    NextState(Ignore);
 }
 
 
 State* OBJReader::CADMeshLexerState(Vertex)
 {
-    SkipLineBreaks();
+    SkipWhiteSpaceAndLineBreaks();
 
     if (DoesNotMatchExactly("v "))
         Error("A vertex is indicated by the tag 'v'.");
@@ -100,18 +104,16 @@ State* OBJReader::CADMeshLexerState(Vertex)
 
     SkipLine();   
 
-    TryState(Vertex);
-    TryState(Object);
-    TryState(Facet);
-    TryState(Ignore);
- 
-    NextState(EndSolid);
+    PredictState(Vertex, "v ");
+    PredictState(Object, "o ");
+    PredictState(Facet, "f ");
+    NextState(Ignore);
 }
 
 
 State* OBJReader::CADMeshLexerState(Facet)
 {
-    SkipLineBreaks();
+    SkipWhiteSpaceAndLineBreaks();
 
     if (DoesNotMatchExactly("f "))
         Error("A facet is indicated by the tag 'f'.");
@@ -162,18 +164,16 @@ State* OBJReader::CADMeshLexerState(Facet)
     
     SkipLine();
  
-    TryState(Facet);
-    TryState(Vertex);
-    TryState(Object);
-    TryState(Ignore);
-   
-    NextState(EndSolid);
+    PredictState(Facet, "f ");
+    PredictState(Vertex, "v ");
+    PredictState(Object, "o ");
+    NextState(Ignore);
 }
 
 
 State* OBJReader::CADMeshLexerState(Object)
 {
-    SkipLineBreaks();
+    SkipWhiteSpaceAndLineBreaks();
 
     if (DoesNotMatchExactly("o "))
         Error("An object is indicated by the tag 'o'.");
@@ -188,51 +188,156 @@ State* OBJReader::CADMeshLexerState(Object)
 
     SkipWhiteSpace();
 
-    TryState(Vertex);
-    TryState(Facet);
-    TryState(Object);
-    TryState(Ignore);
-   
-    NextState(EndSolid);
+    PredictState(Vertex, "v ");
+    PredictState(Facet, "f ");
+    PredictState(Object, "o ");
+    NextState(Ignore);
 }
 
 
 // Parser.
 G4bool OBJReader::Read(G4String filepath)
 {
-    // Run the lexer.
-    auto items = RunLexer(filepath, StartSolid);
+    if (GetChunkSize() > 0)
+    {
+        return ReadStreaming(filepath);
+    }
+
+    auto file = std::make_shared<MappedFile>(filepath);
 
-    if (items.size() == 0)
+    // Lex chunks of whole lines in parallel.
+    auto lexers = Lexer::RunInChunks( file
+                                    , 0
+                                    , file->Size()
+                                    , NumberOfChunks(file->Size())
+                                    , StartSolidState::Instance());
+    auto chunks = lexers.size();
+
+    std::vector<std::shared_ptr<Items> > items(chunks);
+    std::vector<size_t> roots(chunks);
+    std::vector<size_t> vertex_counts(chunks, 0);
+
+    ParallelFor(chunks, chunks, [&](size_t i)
+    {
+        items[i] = lexers[i].GetItems();
+        roots[i] = lexers[i].GetRoot();
+
+        for (auto solid : items[i]->ChildrenOf(roots[i]))
+        {
+            for (auto item : items[i]->ChildrenOf(solid))
+            {
+                if ((*items[i])[item].token == VertexToken)
+                    vertex_counts[i]++;
+            }
+        }
+    });
+
+    if (!items[0]->HasChildren(roots[0]))
     {
         Exceptions::ParserError("OBJReader::Read", "The OBJ file appears to be empty.");
     }
 
-    // Start parsing tokens.
-    for (auto item : items)
+    // Vertices are numbered from one across the whole file, so each chunk's
+    // vertices go after those of the chunks before it.
+    std::vector<size_t> vertex_offsets = { 0 };
+
+    for (auto count : vertex_counts)
     {
-        if (item.children.size() == 0)
+        vertex_offsets.push_back(vertex_offsets.back() + count);
+    }
+
+    vertices_.resize(vertex_offsets.back());
+
+    ParallelFor(chunks, chunks, [&](size_t i)
+    {
+        auto next = vertex_offsets[i];
+
+        for (auto solid : items[i]->ChildrenOf(roots[i]))
         {
-            continue;
+            ParseVertices(*items[i], solid, next);
         }
+    });
 
-        auto mesh = ParseMesh(item.children);
+    // With every vertex known, the facets of each solid can be built.
+    std::vector<std::vector<Indices> > facets(chunks);
+
+    ParallelFor(chunks, chunks, [&](size_t i)
+    {
+        for (auto solid : items[i]->ChildrenOf(roots[i]))
+        {
+            facets[i].push_back(ParseFacets(*items[i], solid));
+        }
+    });
+
+    // Stitch the solids back together in order. The first solid of a chunk
+    // continues the object that the chunk before it ended in.
+    std::vector<Indices> objects;
+    std::vector<G4String> names;
+
+    for (size_t i = 0; i < chunks; i++)
+    {
+        size_t s = 0;
+
+        for (auto solid : items[i]->ChildrenOf(roots[i]))
+        {
+            auto& triangles = facets[i][s];
 
+            if (i > 0 && s == 0)
+            {
+                objects.back().insert(objects.back().end(), triangles.begin(), triangles.end());
+            }
+
+            else
+            {
+                // We are expecting the first token to be the mesh/object name.
+                G4String name;
+
+                if (items[i]->HasChildren(solid))
+                {
+                    auto first = (*items[i])[solid].first_child;
+
+                    if ((*items[i])[first].token == WordToken)
+                    {
+                        name = items[i]->Value(first);
+                    }
+                }
+
+                objects.push_back(std::move(triangles));
+                names.push_back(name);
+            }
+
+            s++;
+        }
+    }
+
+    for (size_t i = 0; i < objects.size(); i++)
+    {
         // Only add meshes with faces.
-        if (mesh->GetTriangles().size() == 0)
+        if (objects[i].size() == 0)
         {
             continue;
         }
 
-        // We are expecting the first token to be the mesh/object name.
-        G4String name;
-        
-        if (item.children[0].token == WordToken)
+        // Each object keeps only the vertices it uses, in file order,
+        // rather than a copy of every vertex in the file.
+        Indices used(objects[i]);
+        std::sort(used.begin(), used.end());
+        used.erase(std::unique(used.begin(), used.end()), used.end());
+
+        Points points;
+        points.reserve(used.size());
+
+        for (auto index : used)
         {
-            name = item.children[0].value;
+            points.push_back(vertices_[index]);
         }
 
-        AddMesh(Mesh::New(mesh, name));
+        for (auto& index : objects[i])
+        {
+            index = std::lower_bound(used.begin(), used.end(), index) - used.begin();
+        }
+
+        AddMesh(Mesh::New(std::move(points), std::move(objects[i]), names[i]));
     }
 
     return true;
@@ -245,76 +350,235 @@ G4bool OBJReader::CanRead(Type file_type)
 }
 
 
-std::shared_ptr<Mesh> OBJReader::ParseMesh(Items items)
+G4bool OBJReader::Stream(G4String filepath, MeshSink& sink)
 {
-    Triangles facets;
+    FileStream file(filepath, StreamChunkSize());
+
+    if (!file.IsOpen() || file.Size() == 0)
+    {
+        Exceptions::ParserError("OBJReader::Stream", "The OBJ file appears to be empty.");
+    }
+
+    // Facets refer back to vertices anywhere before them, so the vertices
+    // are kept. Nothing else is.
+    Points vertices;
+
+    G4String name = "";
+    G4bool started = false;
 
-    // Parse vertices first.
-    for (auto item : items)
+    auto error = [&](std::string message)
     {
-        if (item.token != VertexToken)
+        std::stringstream error;
+        error << message << " Error around line " << file.LineNumber() << ".";
+
+        Exceptions::ParserError("OBJReader::Stream", error.str());
+    };
+
+    const char* begin;
+    const char* end;
+
+    while (file.NextLine(begin, end))
+    {
+        auto p = begin;
+
+        auto white_space = [&]()
+        {
+            while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+        };
+
+        white_space();
+
+        if (end - p < 2 || p[1] != ' ')
         {
             continue;
         }
 
-        if (item.children.size() == 0)
+        if (p[0] == 'v')
+        {
+            p += 2;
+
+            G4double numbers[3];
+
+            for (auto& number : numbers)
+            {
+                white_space();
+
+                auto number_end = NumberParser::Parse(p, end, number);
+
+                if (number_end == p)
+                    error("Three vectors in OBJ files require exactly 3 numbers.");
+
+                p = number_end;
+            }
+
+            vertices.push_back(G4ThreeVector(numbers[0], numbers[1], numbers[2]));
+        }
+
+        else if (p[0] == 'f')
+        {
+            p += 2;
+
+            // Three or four vertex indices, ignoring anything after the /'s.
+            long indices[4];
+            size_t count = 0;
+
+            while (count < 4)
+            {
+                white_space();
+
+                auto number_end = NumberParser::Parse(p, end, indices[count]);
+
+                if (number_end == p)
+                    break;
+
+                p = number_end;
+
+                for (size_t i = 0; i < 2 && p < end && *p == '/'; i++)
+                {
+                    p = NumberParser::Match(p + 1, end);
+                }
+
+                if (indices[count] < 1 || (size_t) indices[count] > vertices.size())
+                {
+                    std::stringstream message;
+                    message << "The facet refers to vertex " << indices[count]
+                            << ", but only " << vertices.size() << " vertices come before it.";
+
+                    error(message.str());
+                }
+
+                count++;
+            }
+
+            if (count < 3)
+                error("Facets in OBJ files require at least 3 indicies.");
+
+            if (!started)
+            {
+                sink.StartMesh(name);
+                started = true;
+            }
+
+            sink.AddTriangle( vertices[indices[0] - 1]
+                            , vertices[indices[1] - 1]
+                            , vertices[indices[2] - 1]);
+
+            // Add the upper triangle of the quad.
+            if (count == 4)
+            {
+                sink.AddTriangle( vertices[indices[0] - 1]
+                                , vertices[indices[2] - 1]
+                                , vertices[indices[3] - 1]);
+            }
+        }
+
+        else if (p[0] == 'o')
+        {
+            // Only objects with facets become meshes.
+            if (started)
+            {
+                sink.EndMesh();
+                started = false;
+            }
+
+            p += 2;
+            white_space();
+
+            auto name_end = p;
+            while (name_end < end && *name_end > ' ' && *name_end <= '~') name_end++;
+
+            name = std::string(p, name_end);
+        }
+    }
+
+    if (started)
+    {
+        sink.EndMesh();
+    }
+
+    return true;
+}
+
+
+void OBJReader::ParseVertices(Items& items, size_t solid, size_t& next)
+{
+    for (auto item : items.ChildrenOf(solid))
+    {
+        if (items[item].token != VertexToken)
+        {
+            continue;
+        }
+
+        if (!items.HasChildren(item))
         {
             std::stringstream error;
             error << "The vertex appears to be empty."
-                    << "Error around line " << item.line << ".";
+                    << "Error around line " << items.LineNumber(item) << ".";
 
             Exceptions::ParserError("OBJReader::Mesh", error.str());
         }
 
-        vertices_.push_back(ParseVertex(item.children));
+        vertices_[next++] = ParseVertex(items, item);
     }
+}
+
 
-    for (auto item : items)
+Indices OBJReader::ParseFacets(Items& items, size_t solid)
+{
+    Indices facets;
+
+    for (auto item : items.ChildrenOf(solid))
     {
-        if (item.token != FacetToken)
+        if (items[item].token != FacetToken)
         {
             continue;
         }
 
-        if (item.children.size() == 0)
+        if (!items.HasChildren(item))
         {
             std::stringstream error;
             error << "The facet appears to be empty."
-                    << "Error around line " << item.line << ".";
+                    << "Error around line " << items.LineNumber(item) << ".";
 
             Exceptions::ParserError("OBJReader::Mesh", error.str());
         }
 
-        facets.push_back(ParseFacet(item.children, false));
+        ParseFacet(items, item, false, facets);
 
         // Add the upper triangle of the quad.
-        if (item.children.size() == 4)
+        if (items.NumberOfChildren(item) == 4)
         {
-            facets.push_back(ParseFacet(item.children, true));
+            ParseFacet(items, item, true, facets);
         }
     }
 
-    return Mesh::New(facets);
+    return facets;
 }   
 
 
-G4ThreeVector OBJReader::ParseVertex(Items items)
+G4ThreeVector OBJReader::ParseVertex(Items& items, size_t vertex)
 {
-    std::vector<double> numbers;
+    G4double numbers[3] = { 0, 0, 0 };
+    size_t count = 0;
 
-    for (auto item : items)
+    for (auto item : items.ChildrenOf(vertex))
     {
-        numbers.push_back((double) atof(item.value.c_str()));
+        if (count < 3)
+        {
+            numbers[count] = items.DoubleValue(item);
+        }
+
+        count++;
     }
 
-    if (numbers.size() != 3)
+    if (count != 3)
     {
         std::stringstream error;
         error << "Three vectors in OBJ files require exactly 3 numbers";
 
-        if (items.size() != 0)
+        if (items.HasChildren(vertex))
         {
-            error << "Error around line " << items[0].line << ".";
+            error << "Error around line " << items.LineNumber(items[vertex].first_child) << ".";
         }
 
         Exceptions::ParserError("OBJReader::ParseThreeVector", error.str());
@@ -324,55 +588,73 @@ G4ThreeVector OBJReader::ParseVertex(Items items)
 }
 
 
-G4TriangularFacet* OBJReader::ParseFacet(Items items, G4bool quad)
+void OBJReader::ParseFacet(Items& items, size_t facet, G4bool quad, Indices& facets)
 {
-    std::vector<int> indices;
+    G4int indices[4] = { 0, 0, 0, 0 };
+    size_t count = 0;
 
-    for (auto item : items)
+    for (auto item : items.ChildrenOf(facet))
     {
-        indices.push_back((int) atoi(item.value.c_str()));
+        if (count < 4)
+        {
+            indices[count] = (G4int) items.IntegerValue(item);
+        }
+
+        count++;
     }
 
-    if (indices.size() < 3)
+    if (count < 3)
     {
         std::stringstream error;
         error << "Facets in OBJ files require at least 3 indicies";
 
-        if (items.size() != 0)
+        if (items.HasChildren(facet))
         {
-            error << "Error around line " << items[0].line << ".";
+            error << "Error around line " << items.LineNumber(items[facet].first_child) << ".";
         }
 
         Exceptions::ParserError("OBJReader::ParseFacet", error.str());
     }
 
-    if (quad && indices.size() != 4)
+    if (quad && count != 4)
     {
         std::stringstream error;
         error << "Trying to triangle-ify a facet that isn't a quad";
 
-        if (items.size() != 0)
+        if (items.HasChildren(facet))
         {
-            error << "Error around line " << items[0].line << ".";
+            error << "Error around line " << items.LineNumber(items[facet].first_child) << ".";
         }
 
         Exceptions::ParserError("OBJReader::ParseFacet", error.str());
     }
 
+    for (size_t i = 0; i < std::min<size_t>(count, 4); i++)
+    {
+        if (indices[i] < 1 || (size_t) indices[i] > vertices_.size())
+        {
+            std::stringstream error;
+            error << "The facet refers to vertex " << indices[i]
+                  << ", but there are only " << vertices_.size() << " vertices. "
+                  << "Error around line " << items.LineNumber(items[facet].first_child) << ".";
+
+            Exceptions::ParserError("OBJReader::ParseFacet", error.str());
+        }
+    }
+
+    // Vertices are numbered from one.
     if (quad)
     {
-        return new G4TriangularFacet( vertices_[indices[0] - 1]
-                                    , vertices_[indices[2] - 1]
-                                    , vertices_[indices[3] - 1]
-                                    , ABSOLUTE);
+        facets.push_back(indices[0] - 1);
+        facets.push_back(indices[2] - 1);
+        facets.push_back(indices[3] - 1);
     }
 
     else
     {
-        return new G4TriangularFacet( vertices_[indices[0] - 1]
-                                    , vertices_[indices[1] - 1]
-                                    , vertices_[indices[2] - 1]
-                                    , ABSOLUTE);
+        facets.push_back(indices[0] - 1);
+        facets.push_back(indices[1] - 1);
+        facets.push_back(indices[2] - 1);
     }
 }
 
@@ -23,6 +23,13 @@
 // CADMesh //
 #include "PLYReader.hh"
 #include "Exceptions.hh"
+#include "NumberParser.hh"
+#include "Parallel.hh"
+
+// STL //
+#include <algorithm>
+#include <cstring>
+#include <limits>
 
 
 namespace CADMesh
@@ -41,6 +48,7 @@ State* PLYReader::CADMeshLexerState(StartHeader)
 
     SkipLine();
 
+    TryState(Format);
     TryState(Element);
     TryState(Ignore);
  
@@ -60,6 +68,36 @@ State* PLYReader::CADMeshLexerState(EndHeader)
 }
 
 
+State* PLYReader::CADMeshLexerState(Format)
+{
+    if (DoesNotMatchExactly("format "))
+        Error("The format is indicated by the tag 'format'.");
+
+    SkipWhiteSpace();
+    StartOfA(Format);
+
+    // Expecting ascii, binary_little_endian or binary_big_endian and a version.
+    if (NotManyCharacters())
+        Error("Format type not found.");
+
+    ThisIsA(Word);
+    SkipWhiteSpace();
+
+    if (NotANumber())
+        Error("Format version not found.");
+
+    ThisIsA(Number);
+    EndOfA(Format);
+
+    SkipLine();
+
+    TryState(Element);
+    TryState(Ignore);
+
+    NextState(EndHeader);
+}
+
+
 State* PLYReader::CADMeshLexerState(Element)
 {
     if (DoesNotMatchExactly("element "))
@@ -126,6 +164,7 @@ State* PLYReader::CADMeshLexerState(Ignore)
     if (DidNotSkipLine())
         NextState(EndHeader);
     
+    TryState(Format);
     TryState(Element);
     TryState(Property);
     TryState(EndHeader);
@@ -209,12 +248,23 @@ State* PLYReader::CADMeshLexerState(Facet)
 // Parser.
 G4bool PLYReader::Read(G4String filepath)
 {
-    // Run the lexer on the header.
-    auto lexer = Lexer(filepath, new StartHeaderState);
+    if (GetChunkSize() > 0)
+    {
+        return ReadStreaming(filepath);
+    }
+
+    auto file = std::make_shared<MappedFile>(filepath);
+
+    // Run the lexer on the header alone, so that a binary body is never
+    // scanned as text.
+    auto header_size = std::min(HeaderSize(*file), file->Size());
+
+    auto lexer = Lexer(file, 0, header_size, StartHeaderState::Instance());
     auto items = lexer.GetItems();
+    auto header = lexer.GetRoot();
 
     // Start parsing tokens.
-    if (items.size() == 0)
+    if (!items->HasChildren(header))
     {
         std::stringstream error;
         error << "The header appears to be empty.";
@@ -222,39 +272,77 @@ G4bool PLYReader::Read(G4String filepath)
         Exceptions::ParserError("PLYReader::Read", error.str());
     }
 
-    ParseHeader(items);
+    ParseHeader(*items, header);
+
+    if (format_ != ASCII)
+    {
+        AddMesh(ReadBinary(*file));
+        return true;
+    }
+
+    // The vertices each take one line after the header, and the facets run
+    // to the end of the file.
+    auto line = lexer.LineNumber();
+
+    auto start_of_line = [&](size_t line)
+    {
+        auto end_of_line = file->EndOfLine(line);
+        return end_of_line == std::string::npos ? file->Size() : end_of_line + 1;
+    };
+
+    auto vertices_begin = start_of_line(line);
+    auto facets_begin = start_of_line(line + vertex_count_);
+    auto facets_end = file->Size();
    
-    // Run the lexer on the vertices.
-    lexer.Run(new VertexState, vertex_count_);
-    auto vertex_items = lexer.GetItems();
+    // Run the lexer on chunks of the vertices.
+    auto vertex_chunks = Lexer::RunInChunks( file
+                                           , vertices_begin
+                                           , facets_begin
+                                           , NumberOfChunks(facets_begin - vertices_begin)
+                                           , VertexState::Instance());
+
+    size_t vertices = 0;
 
-    if (vertex_items.size() == 0)
+    for (auto& chunk : vertex_chunks)
+    {
+        vertices += chunk.GetItems()->NumberOfChildren(chunk.GetRoot());
+    }
+
+    if (vertices == 0)
     {
         Exceptions::ParserError("PLYReader::Read", "The PLY file appears to have no vertices.");
     }
 
-    if (vertex_items.size() != vertex_count_)
+    if (vertices != vertex_count_)
     {
         Exceptions::ParserError("PLYReader::Read", "The PLY file appears to be missing vertices.");
     }
 
+    // Run the lexer on chunks of the facets.
+    auto facet_chunks = Lexer::RunInChunks( file
+                                          , facets_begin
+                                          , facets_end
+                                          , NumberOfChunks(facets_end - facets_begin)
+                                          , FacetState::Instance());
 
-    // Run the lexer on the facets.
-    lexer.Run(new FacetState, facet_count_);
-    auto face_items = lexer.GetItems();
+    size_t facets = 0;
 
-    if (face_items.size() == 0)
+    for (auto& chunk : facet_chunks)
+    {
+        facets += chunk.GetItems()->NumberOfChildren(chunk.GetRoot());
+    }
+
+    if (facets == 0)
     {
         Exceptions::ParserError("PLYReader::Read", "The PLY file appears to have no facets.");
     }
 
-    if (face_items.size() != facet_count_)
+    if (facets != facet_count_)
     {
         Exceptions::ParserError("PLYReader::Read", "The PLY file appears to be missing facets");
     }
 
-    auto mesh = ParseMesh(vertex_items, face_items);
-    AddMesh(Mesh::New(mesh));
+    AddMesh(ParseMesh(vertex_chunks, facet_chunks));
     
     return true;
 }
@@ -266,9 +354,319 @@ G4bool PLYReader::CanRead(Type file_type)
 }
 
 
-void PLYReader::ParseHeader(Items items)
+G4bool PLYReader::Stream(G4String filepath, MeshSink& sink)
+{
+    FileStream file(filepath, StreamChunkSize());
+
+    if (!file.IsOpen())
+    {
+        Exceptions::ParserError("PLYReader::Stream", "The PLY file could not be opened.");
+    }
+
+    // Find the end of the header, and lex only that much of the file.
+    size_t header_size = 0;
+    G4bool found = false;
+
+    const char* begin;
+    const char* end;
+
+    while (!found && file.NextLine(begin, end))
+    {
+        header_size += end - begin + 1;
+        found = end - begin >= 10 && std::memcmp(begin, "end_header", 10) == 0;
+    }
+
+    if (!found)
+    {
+        Exceptions::ParserError("PLYReader::Stream", "The end of the header was not found.");
+    }
+
+    auto header_file = std::make_shared<MappedFile>(filepath, header_size);
+
+    auto lexer = Lexer(header_file, 0, header_file->Size(), StartHeaderState::Instance());
+    auto items = lexer.GetItems();
+    auto header = lexer.GetRoot();
+
+    if (!items->HasChildren(header))
+    {
+        Exceptions::ParserError("PLYReader::Stream", "The header appears to be empty.");
+    }
+
+    ParseHeader(*items, header);
+
+    sink.StartMesh("");
+
+    if (format_ == ASCII)
+    {
+        StreamText(file, sink);
+    }
+
+    else
+    {
+        StreamBinary(file, sink);
+    }
+
+    sink.EndMesh();
+
+    return true;
+}
+
+
+void PLYReader::StreamText(FileStream& file, MeshSink& sink)
 {
-    if (items.size() != 1)
+    // Facets refer to vertices by index, so the vertices are kept.
+    Points vertices;
+    vertices.reserve(vertex_count_);
+
+    std::vector<G4double> polygon;
+
+    auto error = [&](std::string message)
+    {
+        std::stringstream error;
+        error << message << " Error around line " << file.LineNumber() << ".";
+
+        Exceptions::ParserError("PLYReader::Stream", error.str());
+    };
+
+    const char* begin;
+    const char* end;
+
+    // The next line with anything on it.
+    auto next_line = [&]()
+    {
+        while (file.NextLine(begin, end))
+        {
+            while (begin < end && (*begin == ' ' || *begin == '\t' || *begin == '\r')) begin++;
+
+            if (begin < end)
+                return true;
+        }
+
+        return false;
+    };
+
+    for (size_t e = 0; e < elements_.size(); e++)
+    {
+        for (size_t i = 0; i < elements_[e].count; i++)
+        {
+            if (!next_line())
+            {
+                if (e == vertex_element_)
+                    error("The PLY file appears to be missing vertices.");
+
+                if (e == facet_element_)
+                    error("The PLY file appears to be missing facets.");
+
+                error("The PLY file appears to be missing elements.");
+            }
+
+            if (e != vertex_element_ && e != facet_element_)
+            {
+                continue;
+            }
+
+            G4double values[3] = { 0, 0, 0 };
+            size_t count = 0;
+
+            // The length of the face's vertex list, then the list itself.
+            G4double length = -1;
+            polygon.clear();
+
+            for (auto p = begin; p < end; count++)
+            {
+                G4double value;
+                auto number_end = NumberParser::Parse(p, end, value);
+
+                if (number_end == p)
+                    error("Expecting only numbers in an element.");
+
+                if (e == vertex_element_)
+                {
+                    if (count == x_index_) values[0] = value;
+                    if (count == y_index_) values[1] = value;
+                    if (count == z_index_) values[2] = value;
+                }
+
+                else if (count == facet_index_)
+                {
+                    length = value;
+                }
+
+                else if (count > facet_index_ && polygon.size() < length)
+                {
+                    polygon.push_back(value);
+                }
+
+                p = number_end;
+                while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+            }
+
+            if (e == vertex_element_)
+            {
+                if (count < 3)
+                    error("Vertices in PLY files require atleast 3 numbers.");
+
+                vertices.push_back(G4ThreeVector(values[0], values[1], values[2]));
+                continue;
+            }
+
+            if (length < 3 || polygon.size() < length)
+                error("Facets in PLY files require atleast 3 indicies.");
+
+            for (auto index : polygon)
+            {
+                if (index < 0 || index >= vertices.size())
+                {
+                    std::stringstream message;
+                    message << "The facet refers to vertex " << index
+                            << ", but there are only " << vertices.size() << " vertices.";
+
+                    error(message.str());
+                }
+            }
+
+            // Faces with more than three vertices are split into a fan of
+            // triangles.
+            for (size_t k = 1; k + 1 < polygon.size(); k++)
+            {
+                sink.AddTriangle( vertices[(size_t) polygon[0]]
+                                , vertices[(size_t) polygon[k]]
+                                , vertices[(size_t) polygon[k + 1]]);
+            }
+        }
+    }
+
+    if (next_line())
+    {
+        error("Unexpected data after the last element.");
+    }
+}
+
+
+void PLYReader::StreamBinary(FileStream& file, MeshSink& sink)
+{
+    Points vertices;
+    vertices.reserve(vertex_count_);
+
+    auto read = [&](size_t size)
+    {
+        auto bytes = file.Read(size);
+
+        if (!bytes)
+        {
+            Exceptions::ParserError("PLYReader::Stream", "The PLY file appears to be truncated.");
+        }
+
+        return bytes;
+    };
+
+    for (size_t e = 0; e < elements_.size(); e++)
+    {
+        auto& element = elements_[e];
+
+        for (size_t i = 0; i < element.count; i++)
+        {
+            // Fixed size elements are read a record at a time.
+            if (element.stride > 0)
+            {
+                auto p = read(element.stride);
+
+                if (e == vertex_element_)
+                {
+                    auto& x = element.properties[x_index_];
+                    auto& y = element.properties[y_index_];
+                    auto& z = element.properties[z_index_];
+
+                    vertices.push_back(G4ThreeVector( ReadValue(p + x.offset, x.type)
+                                                    , ReadValue(p + y.offset, y.type)
+                                                    , ReadValue(p + z.offset, z.type)));
+                }
+
+                continue;
+            }
+
+            G4ThreeVector vertex;
+
+            for (size_t j = 0; j < element.properties.size(); j++)
+            {
+                auto& property = element.properties[j];
+                auto size = SizeOf(property.type);
+
+                if (!property.is_list)
+                {
+                    auto p = read(size);
+
+                    if (e == vertex_element_)
+                    {
+                        if (j == x_index_) vertex.setX(ReadValue(p, property.type));
+                        if (j == y_index_) vertex.setY(ReadValue(p, property.type));
+                        if (j == z_index_) vertex.setZ(ReadValue(p, property.type));
+                    }
+
+                    continue;
+                }
+
+                auto count = ReadValue(read(SizeOf(property.count_type)), property.count_type);
+
+                if (count < 0)
+                {
+                    Exceptions::ParserError("PLYReader::Stream", "Negative list length in the PLY file.");
+                }
+
+                auto p = read((size_t) count * size);
+
+                if (e == facet_element_ && j == facet_index_)
+                {
+                    if (count < 3)
+                    {
+                        Exceptions::ParserError("PLYReader::Stream", "Facets in PLY files require atleast 3 indicies.");
+                    }
+
+                    size_t first = 0;
+                    size_t previous = 0;
+
+                    // Faces with more than three vertices are split into a
+                    // fan of triangles.
+                    for (size_t k = 0; k < (size_t) count; k++)
+                    {
+                        auto index = ReadValue(p + k * size, property.type);
+
+                        if (index < 0 || index >= vertices.size())
+                        {
+                            std::stringstream error;
+                            error << "Facet " << i << " refers to vertex " << index
+                                  << ", but there are only " << vertices.size() << " vertices.";
+
+                            Exceptions::ParserError("PLYReader::Stream", error.str());
+                        }
+
+                        if (k == 0)
+                        {
+                            first = (size_t) index;
+                        }
+
+                        else if (k > 1)
+                        {
+                            sink.AddTriangle(vertices[first], vertices[previous], vertices[(size_t) index]);
+                        }
+
+                        previous = (size_t) index;
+                    }
+                }
+            }
+
+            if (e == vertex_element_)
+            {
+                vertices.push_back(vertex);
+            }
+        }
+    }
+}
+
+
+void PLYReader::ParseHeader(Items& items, size_t root)
+{
+    if (items.NumberOfChildren(root) != 1)
     {
         std::stringstream error;
         error << "The header appears to be invalid or missing."
@@ -277,79 +675,155 @@ void PLYReader::ParseHeader(Items items)
         Exceptions::ParserError("PLYReader::ParseHeader", error.str());
     }
 
-    for (auto item : items[0].children)
+    // Start from nothing, as the reader may have read another file, so that
+    // a missing element or property is not taken from the last one.
+    auto missing = std::numeric_limits<size_t>::max();
+
+    elements_.clear();
+
+    vertex_element_ = missing;
+    facet_element_ = missing;
+
+    vertex_count_ = 0;
+    facet_count_ = 0;
+
+    x_index_ = missing;
+    y_index_ = missing;
+    z_index_ = missing;
+
+    facet_index_ = missing;
+
+    auto header = items[root].first_child;
+
+    for (auto item : items.ChildrenOf(header))
     { 
-        if (item.token == ElementToken)
+        if (items[item].token == FormatToken)
+        {
+            auto format = items.Value(items[item].first_child);
+
+            if (format == "ascii")
+            {
+                format_ = ASCII;
+            }
+
+            else if (format == "binary_little_endian")
+            {
+                format_ = BinaryLittleEndian;
+            }
+
+            else if (format == "binary_big_endian")
+            {
+                format_ = BinaryBigEndian;
+            }
+
+            else
+            {
+                std::stringstream error;
+                error << "Unknown format '" << format << "' in header. "
+                        << "Error around line "<< items.LineNumber(item)  << ".";
+
+                Exceptions::ParserError("PLYReader::ParseHeader", error.str());
+            }
+        }
+
+        if (items[item].token == ElementToken)
         {
-            if (item.children.size() < 2)
+            std::vector<size_t> children;
+
+            for (auto child : items.ChildrenOf(item))
+            {
+                children.push_back(child);
+            }
+
+            if (children.size() < 2)
             {
                 std::stringstream error;
                 error << "Invalid element information in header. Expecting 'vertex' or 'face' and a number."
-                        << "Error around line "<< item.line  << ".";
+                        << "Error around line "<< items.LineNumber(item)  << ".";
 
                 Exceptions::ParserError("PLYReader::ParseHeader", error.str());
             }
             
-            if (item.children[0].token == WordToken && item.children[1].token == NumberToken)
+            if (items[children[0]].token == WordToken && items[children[1]].token == NumberToken)
             {
-                if (item.children[0].value == "vertex")
+                ElementSchema element;
+                element.name = items.Value(children[0]);
+                element.count = items.IntegerValue(children[1]);
+
+                for (size_t i = 2; i < children.size(); i++)
                 {
-                    vertex_count_ = atoi(item.children[1].value.c_str());
+                    element.properties.push_back(ParseProperty(items, children[i]));
+                }
 
-                    // Find the x, y, z indices.
-                    for (size_t i = 2; i < item.children.size(); i++)
-                    {
-                        auto property = item.children[i];
+                elements_.push_back(element);
+            }
+        }
+    }
 
-                        if (property.children.size() > 1)
-                        {
-                            if (property.children[1].token == WordToken)
-                            {
-                                if (property.children[1].value == "x")
-                                {
-                                    x_index_ = i - 2;
-                                }
-
-                                if (property.children[1].value == "y")
-                                {
-                                    y_index_ = i - 2;
-                                }
-
-                                if (property.children[1].value == "z")
-                                {
-                                    z_index_ = i - 2;
-                                }
-                            }
-                        }
-                    }
-                } 
+    // Lay out each element, and find the properties we need.
+    for (size_t e = 0; e < elements_.size(); e++)
+    {
+        auto& element = elements_[e];
 
-                else if (item.children[0].value == "face")
-                {
-                    facet_count_ = atoi(item.children[1].value.c_str());
- 
-                    // Find the facet indices.
-                    for (size_t i = 2; i < item.children.size(); i++)
-                    {
-                        auto property = item.children[i];
+        size_t offset = 0;
+        G4bool fixed = true;
 
-                        if (property.children.size() > 1)
-                        {
-                            if (property.children[1].token == WordToken)
-                            {
-                                if (property.children[1].value == "uchar int vertex_indices")
-                                {
-                                    facet_index_ = i - 2;
-                                }
-                            }
-                        }
-                    }
- 
-                } 
+        for (auto& property : element.properties)
+        {
+            property.offset = offset;
+            offset += SizeOf(property.type);
+
+            if (property.is_list)
+            {
+                fixed = false;
+            }
+        }
+
+        element.stride = fixed ? offset : 0;
+
+        if (element.name == "vertex")
+        {
+            vertex_element_ = e;
+            vertex_count_ = element.count;
+
+            for (size_t i = 0; i < element.properties.size(); i++)
+            {
+                auto& name = element.properties[i].name;
+
+                if (name == "x") x_index_ = i;
+                if (name == "y") y_index_ = i;
+                if (name == "z") z_index_ = i;
+            }
+        }
+
+        else if (element.name == "face")
+        {
+            facet_element_ = e;
+            facet_count_ = element.count;
+
+            for (size_t i = 0; i < element.properties.size(); i++)
+            {
+                auto& property = element.properties[i];
+
+                if (property.is_list && (property.name == "vertex_indices"
+                                      || property.name == "vertex_index"))
+                {
+                    facet_index_ = i;
+                }
             }
         }
     }
 
+    if (vertex_element_ == missing)
+    {
+        Exceptions::ParserError("PLYReader::ParseHeader", "No vertex element was found in the header.");
+    }
+
+    if (facet_element_ == missing)
+    {
+        Exceptions::ParserError("PLYReader::ParseHeader", "No face element was found in the header.");
+    }
+
     if (vertex_count_ == 0)
     {
         std::stringstream error;
@@ -366,112 +840,512 @@ void PLYReader::ParseHeader(Items items)
         Exceptions::ParserError("PLYReader::ParseHeader", error.str());
     }
 
-    if ((x_index_ == y_index_) || (y_index_ == z_index_) || (x_index_ == z_index_))
+    if (x_index_ == missing || y_index_ == missing || z_index_ == missing)
     {
         std::stringstream error;
         error << "The vertex x, y, z indices were not found in the header.";
 
         Exceptions::ParserError("PLYReader::ParseHeader", error.str());
     }
+
+    if (facet_index_ == missing)
+    {
+        std::stringstream error;
+        error << "The face vertex_indices list was not found in the header.";
+
+        Exceptions::ParserError("PLYReader::ParseHeader", error.str());
+    }
 }   
 
 
-std::shared_ptr<Mesh> PLYReader::ParseMesh(Items vertex_items, Items face_items)
+PLYReader::PropertySchema PLYReader::ParseProperty(Items& items, size_t property)
 {
-    Points vertices;
-    Triangles facets;
+    if (items.NumberOfChildren(property) < 2)
+    {
+        std::stringstream error;
+        error << "Invalid property information in header. Expecting a type and a name. "
+                << "Error around line "<< items.LineNumber(property)  << ".";
 
-    // Parse vertices first.
-    for (auto item : vertex_items)
+        Exceptions::ParserError("PLYReader::ParseProperty", error.str());
+    }
+
+    auto type = items[property].first_child;
+    std::stringstream words(items.Value(items[type].next_sibling));
+
+    PropertySchema schema;
+    std::string name;
+
+    if (items.Value(type) == "list")
     {
-        if (item.children.size() == 0)
-        {
-            std::stringstream error;
-            error << "The vertex appears to be empty."
-                    << "Error around line " << item.line << ".";
+        std::string count_type;
+        std::string value_type;
 
-            Exceptions::ParserError("PLYReader::ParseMesh", error.str());
-        }
+        words >> count_type >> value_type >> name;
 
-        if (item.token == VertexToken)
-        {
-            vertices.push_back(ParseVertex(item.children));
-        }
+        schema.is_list = true;
+        schema.count_type = PropertyTypeFromName(count_type);
+        schema.type = PropertyTypeFromName(value_type);
+    }
+
+    else
+    {
+        words >> name;
+
+        schema.type = PropertyTypeFromName(items.Value(type));
+    }
+
+    schema.name = name;
+
+    return schema;
+}
+
+
+std::shared_ptr<Mesh> PLYReader::ParseMesh( std::vector<Lexer>& vertex_chunks
+                                          , std::vector<Lexer>& facet_chunks)
+{
+    // Every facet is resolved by index into this one vertex buffer.
+    Points vertices(vertex_count_);
+
+    // Parse vertices first, each chunk into its own place in the buffer.
+    std::vector<size_t> offsets = { 0 };
+
+    for (auto& chunk : vertex_chunks)
+    {
+        offsets.push_back(offsets.back() + chunk.GetItems()->NumberOfChildren(chunk.GetRoot()));
     }
 
-    for (auto item : face_items)
+    ParallelFor(vertex_chunks.size(), vertex_chunks.size(), [&](size_t i)
     {
-        if (item.children.size() == 0)
+        auto& items = *vertex_chunks[i].GetItems();
+        auto next = offsets[i];
+
+        for (auto item : items.ChildrenOf(vertex_chunks[i].GetRoot()))
         {
-            std::stringstream error;
-            error << "The facet appears to be empty."
-                    << "Error around line " << item.line << ".";
+            if (!items.HasChildren(item))
+            {
+                std::stringstream error;
+                error << "The vertex appears to be empty."
+                        << "Error around line " << items.LineNumber(item) << ".";
+
+                Exceptions::ParserError("PLYReader::ParseMesh", error.str());
+            }
 
-            Exceptions::ParserError("PLYReader::Mesh", error.str());
+            vertices[next++] = ParseVertex(items, item);
         }
+    });
 
-        if (item.token == FacetToken)
+    // Faces with more than three vertices make more than one triangle, so
+    // each chunk fills its own list, and the lists are joined in order.
+    std::vector<Indices> chunk_indices(facet_chunks.size());
+
+    ParallelFor(facet_chunks.size(), facet_chunks.size(), [&](size_t i)
+    {
+        auto& items = *facet_chunks[i].GetItems();
+        auto& indices = chunk_indices[i];
+
+        indices.reserve(3 * items.NumberOfChildren(facet_chunks[i].GetRoot()));
+
+        for (auto item : items.ChildrenOf(facet_chunks[i].GetRoot()))
         {
-            facets.push_back(ParseFacet(item.children, vertices));
+            if (!items.HasChildren(item))
+            {
+                std::stringstream error;
+                error << "The facet appears to be empty."
+                        << "Error around line " << items.LineNumber(item) << ".";
+
+                Exceptions::ParserError("PLYReader::Mesh", error.str());
+            }
+
+            ParseFacet(items, item, vertices, indices);
         }
+    });
+
+    size_t number_of_indices = 0;
+
+    for (auto& indices : chunk_indices)
+    {
+        number_of_indices += indices.size();
     }
 
-    return Mesh::New(facets);
+    Indices indices;
+    indices.reserve(number_of_indices);
+
+    for (auto& chunk : chunk_indices)
+    {
+        indices.insert(indices.end(), chunk.begin(), chunk.end());
+    }
+
+    return Mesh::New(std::move(vertices), std::move(indices));
 }   
 
 
-G4ThreeVector PLYReader::ParseVertex(Items items)
+G4ThreeVector PLYReader::ParseVertex(Items& items, size_t vertex)
 {
-    std::vector<double> numbers;
+    G4double x = 0;
+    G4double y = 0;
+    G4double z = 0;
 
-    for (auto item : items)
+    size_t count = 0;
+
+    for (auto item : items.ChildrenOf(vertex))
     {
-        numbers.push_back((double) atof(item.value.c_str()));
+        if (count == x_index_) x = items.DoubleValue(item);
+        if (count == y_index_) y = items.DoubleValue(item);
+        if (count == z_index_) z = items.DoubleValue(item);
+
+        count++;
     }
 
-    if (numbers.size() < 3)
+    if (count < 3)
     {
         std::stringstream error;
         error << "Vertices in PLY files require atleast 3 numbers. ";
 
-        if (items.size() != 0)
+        if (items.HasChildren(vertex))
         {
-            error << "Error around line " << items[0].line << ".";
+            error << "Error around line " << items.LineNumber(items[vertex].first_child) << ".";
         }
 
         Exceptions::ParserError("PLYReader::ParseVertex", error.str());
     }
 
-    return G4ThreeVector(numbers[x_index_], numbers[y_index_], numbers[z_index_]);
+    return G4ThreeVector(x, y, z);
 }
 
 
-G4TriangularFacet* PLYReader::ParseFacet(Items items, Points vertices)
+void PLYReader::ParseFacet( Items& items
+                          , size_t facet
+                          , const Points& vertices
+                          , Indices& facet_indices)
 {
-    std::vector<int> indices;
+    // The length of the vertex list, then the list itself.
+    std::vector<long> indices;
+    long length = -1;
+    size_t count = 0;
 
-    for (auto item : items)
+    for (auto item : items.ChildrenOf(facet))
     {
-        indices.push_back((int) atoi(item.value.c_str()));
+        if (count == facet_index_)
+        {
+            length = items.IntegerValue(item);
+        }
+
+        else if (count > facet_index_ && indices.size() < (size_t) length)
+        {
+            indices.push_back(items.IntegerValue(item));
+        }
+
+        count++;
     }
 
-    if (indices.size() < 4) // "3" and 3 numbers
+    if (length < 3 || indices.size() < (size_t) length)
     {
         std::stringstream error;
-        error << "Facets in PLY files require 3 indicies";
+        error << "Facets in PLY files require atleast 3 indicies. ";
 
-        if (items.size() != 0)
+        if (items.HasChildren(facet))
         {
-            error << "Error around line " << items[0].line << ".";
+            error << "Error around line " << items.LineNumber(items[facet].first_child) << ".";
         }
 
         Exceptions::ParserError("PLYReader::ParseFacet", error.str());
     }
 
-    return new G4TriangularFacet( vertices[indices[1 + facet_index_]]
-                                , vertices[indices[2 + facet_index_]]
-                                , vertices[indices[3 + facet_index_]]
-                                , ABSOLUTE);
+    for (auto index : indices)
+    {
+        if (index < 0 || (size_t) index >= vertices.size())
+        {
+            std::stringstream error;
+            error << "The facet refers to vertex " << index
+                  << ", but there are only " << vertices.size() << " vertices. "
+                  << "Error around line " << items.LineNumber(items[facet].first_child) << ".";
+
+            Exceptions::ParserError("PLYReader::ParseFacet", error.str());
+        }
+    }
+
+    // Faces with more than three vertices are split into a fan of triangles.
+    for (size_t i = 1; i + 1 < indices.size(); i++)
+    {
+        facet_indices.push_back((uint32_t) indices[0]);
+        facet_indices.push_back((uint32_t) indices[i]);
+        facet_indices.push_back((uint32_t) indices[i + 1]);
+    }
+}
+
+
+size_t PLYReader::HeaderSize(MappedFile& file)
+{
+    auto begin = file.Data();
+    auto end = begin + file.Size();
+
+    // The header ends with the line break after 'end_header'.
+    const std::string marker = "\nend_header";
+    auto header_end = std::search(begin, end, marker.begin(), marker.end());
+    auto line_end = header_end == end ? nullptr
+                  : (const char*) std::memchr(header_end + 1, '\n', end - header_end - 1);
+
+    return line_end ? line_end + 1 - begin : std::string::npos;
+}
+
+
+std::shared_ptr<Mesh> PLYReader::ReadBinary(MappedFile& file)
+{
+    auto begin = file.Data();
+    auto end = begin + file.Size();
+
+    // The body starts on the line after 'end_header'.
+    auto header_size = HeaderSize(file);
+
+    if (header_size == std::string::npos)
+    {
+        Exceptions::ParserError("PLYReader::ReadBinary", "The end of the header was not found.");
+    }
+
+    auto p = (const unsigned char*) begin + header_size;
+    auto p_end = (const unsigned char*) end;
+
+    auto require = [&](size_t count, size_t size)
+    {
+        if (size > 0 && count > (size_t) (p_end - p) / size)
+        {
+            Exceptions::ParserError("PLYReader::ReadBinary", "The PLY file appears to be truncated.");
+        }
+    };
+
+    Points vertices;
+    vertices.reserve(vertex_count_);
+
+    Indices facets;
+    facets.reserve(3 * facet_count_);
+
+    size_t faces = 0;
+
+    for (size_t e = 0; e < elements_.size(); e++)
+    {
+        auto& element = elements_[e];
+
+        if (element.stride > 0)
+        {
+            require(element.count, element.stride);
+
+            // Only the x, y, z columns are read.
+            if (e == vertex_element_)
+            {
+                auto& x = element.properties[x_index_];
+                auto& y = element.properties[y_index_];
+                auto& z = element.properties[z_index_];
+
+                for (size_t i = 0; i < element.count; i++)
+                {
+                    vertices.push_back(G4ThreeVector( ReadValue(p + x.offset, x.type)
+                                                    , ReadValue(p + y.offset, y.type)
+                                                    , ReadValue(p + z.offset, z.type)));
+                    p += element.stride;
+                }
+            }
+
+            // Elements we don't use are skipped in one go.
+            else
+            {
+                p += element.count * element.stride;
+            }
+
+            continue;
+        }
+
+        // Elements with lists have to be walked one property at a time.
+        for (size_t i = 0; i < element.count; i++)
+        {
+            G4ThreeVector vertex;
+
+            for (size_t j = 0; j < element.properties.size(); j++)
+            {
+                auto& property = element.properties[j];
+                auto size = SizeOf(property.type);
+
+                if (!property.is_list)
+                {
+                    require(1, size);
+
+                    if (e == vertex_element_)
+                    {
+                        if (j == x_index_) vertex.setX(ReadValue(p, property.type));
+                        if (j == y_index_) vertex.setY(ReadValue(p, property.type));
+                        if (j == z_index_) vertex.setZ(ReadValue(p, property.type));
+                    }
+
+                    p += size;
+                    continue;
+                }
+
+                require(1, SizeOf(property.count_type));
+
+                auto count = ReadValue(p, property.count_type);
+                p += SizeOf(property.count_type);
+
+                if (count < 0)
+                {
+                    Exceptions::ParserError("PLYReader::ReadBinary", "Negative list length in the PLY file.");
+                }
+
+                require((size_t) count, size);
+
+                if (e == facet_element_ && j == facet_index_)
+                {
+                    if (count < 3)
+                    {
+                        Exceptions::ParserError("PLYReader::ReadBinary", "Facets in PLY files require atleast 3 indicies.");
+                    }
+
+                    uint32_t first = 0;
+                    uint32_t previous = 0;
+
+                    // Faces with more than three vertices are split into a
+                    // fan of triangles.
+                    for (size_t k = 0; k < (size_t) count; k++)
+                    {
+                        auto index = ReadValue(p + k * size, property.type);
+
+                        if (index < 0 || index >= vertices.size())
+                        {
+                            std::stringstream error;
+                            error << "Facet " << i << " refers to vertex " << index
+                                  << ", but there are only " << vertices.size() << " vertices.";
+
+                            Exceptions::ParserError("PLYReader::ReadBinary", error.str());
+                        }
+
+                        if (k == 0)
+                        {
+                            first = (uint32_t) index;
+                        }
+
+                        else if (k > 1)
+                        {
+                            facets.push_back(first);
+                            facets.push_back(previous);
+                            facets.push_back((uint32_t) index);
+                        }
+
+                        previous = (uint32_t) index;
+                    }
+
+                    faces++;
+                }
+
+                p += (size_t) count * size;
+            }
+
+            if (e == vertex_element_)
+            {
+                vertices.push_back(vertex);
+            }
+        }
+    }
+
+    if (vertices.size() != vertex_count_)
+    {
+        Exceptions::ParserError("PLYReader::ReadBinary", "The PLY file appears to be missing vertices.");
+    }
+
+    if (faces != facet_count_)
+    {
+        Exceptions::ParserError("PLYReader::ReadBinary", "The PLY file appears to be missing facets");
+    }
+
+    return Mesh::New(std::move(vertices), std::move(facets));
+}
+
+
+PLYReader::PropertyType PLYReader::PropertyTypeFromName(G4String name)
+{
+    if (name == "char" || name == "int8") return Int8;
+    if (name == "uchar" || name == "uint8") return UInt8;
+    if (name == "short" || name == "int16") return Int16;
+    if (name == "ushort" || name == "uint16") return UInt16;
+    if (name == "int" || name == "int32") return Int32;
+    if (name == "uint" || name == "uint32") return UInt32;
+    if (name == "float" || name == "float32") return Float32;
+    if (name == "double" || name == "float64") return Float64;
+
+    Exceptions::ParserError("PLYReader::PropertyTypeFromName", "Unknown property type '" + name + "'.");
+
+    return Float64;
+}
+
+
+size_t PLYReader::SizeOf(PropertyType type)
+{
+    switch (type)
+    {
+        case Int8:
+        case UInt8:
+            return 1;
+
+        case Int16:
+        case UInt16:
+            return 2;
+
+        case Int32:
+        case UInt32:
+        case Float32:
+            return 4;
+
+        case Float64:
+            return 8;
+    }
+
+    return 0;
+}
+
+
+G4double PLYReader::ReadValue(const unsigned char* bytes, PropertyType type)
+{
+    auto size = SizeOf(type);
+
+    // Assemble the bits in file byte order, independent of the host.
+    uint64_t bits = 0;
+
+    for (size_t i = 0; i < size; i++)
+    {
+        if (format_ == BinaryBigEndian)
+        {
+            bits = (bits << 8) | bytes[i];
+        }
+
+        else
+        {
+            bits |= (uint64_t) bytes[i] << (8 * i);
+        }
+    }
+
+    switch (type)
+    {
+        case Int8: return (int8_t) bits;
+        case UInt8: return (uint8_t) bits;
+        case Int16: return (int16_t) bits;
+        case UInt16: return (uint16_t) bits;
+        case Int32: return (int32_t) bits;
+        case UInt32: return (uint32_t) bits;
+
+        case Float32:
+        {
+            auto value_bits = (uint32_t) bits;
+            float value;
+            std::memcpy(&value, &value_bits, sizeof(float));
+            return value;
+        }
+
+        case Float64:
+        {
+            double value;
+            std::memcpy(&value, &bits, sizeof(double));
+            return value;
+        }
+    }
+
+    return 0;
 }
 
 
@@ -22,6 +22,12 @@
 
 // CADMesh //
 #include "Reader.hh"
+#include "MeshBuilder.hh"
+#include "Parallel.hh"
+
+// STL //
+#include <algorithm>
+#include <thread>
 
 
 namespace CADMesh
@@ -40,6 +46,33 @@ Reader::~Reader()
 }
 
 
+G4bool Reader::Stream(G4String filepath, MeshSink& sink)
+{
+    if (!Read(filepath))
+    {
+        return false;
+    }
+
+    for (auto mesh : meshes_)
+    {
+        sink.StartMesh(mesh->GetName());
+
+        auto& indices = mesh->GetIndices();
+
+        for (size_t i = 0; i < indices.size(); i += 3)
+        {
+            sink.AddTriangle( mesh->GetPoint(indices[i])
+                            , mesh->GetPoint(indices[i + 1])
+                            , mesh->GetPoint(indices[i + 2]));
+        }
+
+        sink.EndMesh();
+    }
+
+    return true;
+}
+
+
 G4String Reader::GetName()
 {
     return name_;
@@ -99,6 +132,34 @@ Meshes Reader::GetMeshes()
 }
 
 
+Validations Reader::Validate()
+{
+    Validations validations(meshes_.size());
+
+    if (meshes_.empty())
+    {
+        return validations;
+    }
+
+    // With no number of threads set, a lone mesh picks its own.
+    size_t threads = number_of_threads_;
+
+    if (threads == 0 && meshes_.size() > 1)
+    {
+        threads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    auto each = std::max<size_t>(threads / meshes_.size(), 1);
+
+    ParallelFor(meshes_.size(), std::max<size_t>(threads / each, 1), [&](size_t i)
+    {
+        validations[i] = meshes_[i]->Validate(threads == 0 ? 0 : each);
+    });
+
+    return validations;
+}
+
+
 size_t Reader::GetNumberOfMeshes()
 {
     return meshes_.size();
@@ -107,6 +168,11 @@ size_t Reader::GetNumberOfMeshes()
 
 size_t Reader::AddMesh(std::shared_ptr<Mesh> mesh)
 {
+    if (weld_)
+    {
+        mesh->Weld(weld_tolerance_, weld_relative_, number_of_threads_);
+    }
+
     meshes_.push_back(mesh);
 
     return meshes_.size();
@@ -119,6 +185,78 @@ void Reader::SetMeshes(Meshes meshes)
 }
 
 
+void Reader::SetNumberOfThreads(size_t number_of_threads)
+{
+    number_of_threads_ = number_of_threads;
+}
+
+
+size_t Reader::GetNumberOfThreads()
+{
+    return number_of_threads_;
+}
+
+
+void Reader::SetChunkSize(size_t chunk_size)
+{
+    chunk_size_ = chunk_size;
+}
+
+
+size_t Reader::GetChunkSize()
+{
+    return chunk_size_;
+}
+
+
+void Reader::SetWeldTolerance(G4double tolerance, G4bool relative)
+{
+    weld_ = true;
+    weld_tolerance_ = tolerance;
+    weld_relative_ = relative;
+}
+
+
+size_t Reader::NumberOfChunks(size_t bytes)
+{
+    if (number_of_threads_ > 0)
+    {
+        return number_of_threads_;
+    }
+
+    // About a megabyte per thread is enough to pay for starting it.
+    size_t hardware = std::max(std::thread::hardware_concurrency(), 1u);
+
+    return std::min(hardware, bytes / (1 << 20) + 1);
+}
+
+
+G4bool Reader::ReadStreaming(G4String filepath)
+{
+    MeshBuilder builder;
+
+    if (!Stream(filepath, builder))
+    {
+        return false;
+    }
+
+    SetMeshes(Meshes());
+
+    for (auto mesh : builder.GetMeshes())
+    {
+        AddMesh(mesh);
+    }
+
+    return true;
+}
+
+
+size_t Reader::StreamChunkSize()
+{
+    return chunk_size_ > 0 ? chunk_size_ : 1 << 20;
+}
+
+
 }
 
 }
@@ -24,6 +24,13 @@
 #include "STLReader.hh"
 #include "Exceptions.hh"
 #include "LexerMacros.hh"
+#include "NumberParser.hh"
+#include "Parallel.hh"
+
+// STL //
+#include <algorithm>
+#include <cstring>
+#include <sstream>
 
 namespace CADMesh
 {
@@ -52,9 +59,7 @@ State* STLReader::CADMeshLexerState(StartSolid)
 
 State* STLReader::CADMeshLexerState(EndSolid)
 {
-    SkipWhiteSpace();
-    SkipLineBreaks();
-    SkipWhiteSpace();
+    SkipWhiteSpaceAndLineBreaks();
    
     if (DoesNotMatchExactly("endsolid"))
         Error("STL files end with 'endsolid'.");
@@ -68,9 +73,7 @@ State* STLReader::CADMeshLexerState(EndSolid)
 
 State* STLReader::CADMeshLexerState(StartFacet)
 {
-    SkipWhiteSpace();
-    SkipLineBreaks();
-    SkipWhiteSpace();
+    SkipWhiteSpaceAndLineBreaks();
 
     if (DoesNotMatchExactly("facet normal"))
         Error("Facets are indicated by the tag 'facet normal'.");
@@ -89,9 +92,7 @@ State* STLReader::CADMeshLexerState(StartFacet)
 
 State* STLReader::CADMeshLexerState(EndFacet)
 {
-    SkipWhiteSpace();
-    SkipLineBreaks();
-    SkipWhiteSpace();
+    SkipWhiteSpaceAndLineBreaks();
    
     if (DoesNotMatchExactly("endfacet"))
         Error("The end of a facets is indicated by the tag 'endfacet'.");
@@ -102,7 +103,7 @@ State* STLReader::CADMeshLexerState(EndFacet)
     EndOfA(Facet);
 
     // Another facet, could be next.
-    TryState(StartFacet);
+    PredictState(StartFacet, "facet normal");
     
     // Otherwise, we must be at the end of the solid.
     NextState(EndSolid);
@@ -111,9 +112,7 @@ State* STLReader::CADMeshLexerState(EndFacet)
 
 State* STLReader::CADMeshLexerState(StartVertices)
 {
-    SkipWhiteSpace();
-    SkipLineBreaks();
-    SkipWhiteSpace();
+    SkipWhiteSpaceAndLineBreaks();
    
     if (DoesNotMatchExactly("outer loop"))
         Error("The start of the vertices is indicated by the tag 'outer loop'.");
@@ -129,9 +128,7 @@ State* STLReader::CADMeshLexerState(StartVertices)
 
 State* STLReader::CADMeshLexerState(EndVertices)
 {
-    SkipWhiteSpace();
-    SkipLineBreaks();
-    SkipWhiteSpace();
+    SkipWhiteSpaceAndLineBreaks();
     
     if (DoesNotMatchExactly("endloop"))
         Error("The end of the vertices is indicated by the tag 'endloop'.");
@@ -147,9 +144,7 @@ State* STLReader::CADMeshLexerState(EndVertices)
 
 State* STLReader::CADMeshLexerState(Vertex)
 {
-    SkipWhiteSpace();
-    SkipLineBreaks();
-    SkipWhiteSpace();
+    SkipWhiteSpaceAndLineBreaks();
 
     if (DoesNotMatchExactly("vertex"))
         Error("A vertex is indicated by the tag 'vertex'.");
@@ -191,10 +186,10 @@ State* STLReader::CADMeshLexerState(ThreeVector)
         Error("Expecting a new line at the end of a three vector.");
 
     // After a three vector we can expect the start of a list of vertices.
-    TryState(StartVertices);
+    PredictState(StartVertices, "outer loop");
 
     // Or we can expect another vertex.
-    TryState(Vertex);
+    PredictState(Vertex, "vertex");
 
     // Or we must be at the end of a list of vertices.
     NextState(EndVertices);
@@ -203,30 +198,51 @@ State* STLReader::CADMeshLexerState(ThreeVector)
 // Parser.
 G4bool STLReader::Read(G4String filepath)
 {
+    if (GetChunkSize() > 0)
+    {
+        return ReadStreaming(filepath);
+    }
+
+    MappedFile file(filepath);
+
+    if (IsBinary(file))
+    {
+        return ReadBinary(file);
+    }
+
+    // Well formed ASCII STL files don't need the lexer.
+    if (Scan(file))
+    {
+        return true;
+    }
+
+    // Otherwise, the lexer and parser produce a detailed error.
     // Run the lexer.
-    auto items = RunLexer(filepath, StartSolid);
+    auto lexer = Lexer(filepath, StartSolidState::Instance());
+    auto items = lexer.GetItems();
+    auto root = lexer.GetRoot();
 
-    if (items.size() == 0)
+    if (!items->HasChildren(root))
     {
         Exceptions::ParserError("STLReader::Read", "The STL file appears to be empty.");
     }
 
     // Start parsing tokens.
-    for (auto item : items)
+    for (auto item : items->ChildrenOf(root))
     {
-        if (item.children.size() == 0)
+        if (!items->HasChildren(item))
         {
             std::stringstream error;
             error << "The mesh appears to be empty."
-                    << "Error around line " << item.line << ".";
+                    << "Error around line " << items->LineNumber(item) << ".";
 
             Exceptions::ParserError("STLReader::Read", error.str());
         }
 
-        auto mesh = ParseMesh(item.children);
+        auto mesh = ParseMesh(*items, item);
 
         // Rename and add the mesh.
-        auto name = G4String(item.value);
+        auto name = G4String(items->Value(item));
         AddMesh(Mesh::New(mesh, name));
     }
 
@@ -234,50 +250,512 @@ G4bool STLReader::Read(G4String filepath)
 }
 
 
+G4bool STLReader::Scan(MappedFile& file)
+{
+    auto data = file.Data();
+    auto end = data + file.Size();
+
+    if (file.Size() < 5 || std::memcmp(data, "solid", 5) != 0)
+    {
+        return false;
+    }
+
+    auto p = data + 5;
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+
+    auto name_start = p;
+    while (p < end && *p != '\n' && *p != '\r') p++;
+
+    auto name = G4String(std::string(name_start, p));
+
+    // The facets run up to the last 'endsolid'.
+    auto body_end = end - std::min<size_t>(end - p, 8);
+
+    while (body_end > p && std::memcmp(body_end, "endsolid", 8) != 0)
+    {
+        body_end--;
+    }
+
+    if (body_end == p)
+    {
+        return false;
+    }
+
+    // Scan chunks of whole facets in parallel, then stitch them in order.
+    auto boundaries = file.Split(p - data, body_end - data, NumberOfChunks(body_end - p), "facet");
+    auto chunks = boundaries.size() - 1;
+
+    std::vector<std::vector<G4double> > coordinates(chunks);
+    std::vector<char> scanned(chunks);
+
+    ParallelFor(chunks, chunks, [&](size_t i)
+    {
+        scanned[i] = ScanFacets(data + boundaries[i], data + boundaries[i + 1], coordinates[i]);
+    });
+
+    std::vector<size_t> offsets = { 0 };
+
+    for (size_t i = 0; i < chunks; i++)
+    {
+        if (!scanned[i])
+        {
+            return false;
+        }
+
+        offsets.push_back(offsets.back() + coordinates[i].size() / 9);
+    }
+
+    if (offsets.back() == 0)
+    {
+        return false;
+    }
+
+    Points corners(3 * offsets.back());
+
+    ParallelFor(chunks, chunks, [&](size_t i)
+    {
+        auto& c = coordinates[i];
+
+        for (size_t j = 0; j < c.size(); j += 3)
+        {
+            corners[3 * offsets[i] + j / 3] = G4ThreeVector(c[j], c[j + 1], c[j + 2]);
+        }
+    });
+
+    AddMesh(Mesh::FromCorners(std::move(corners), name));
+
+    return true;
+}
+
+
+// Scans the facets in [begin, end), which must contain nothing else.
+G4bool STLReader::ScanFacets( const char* begin
+                            , const char* end
+                            , std::vector<G4double>& coordinates)
+{
+    auto p = begin;
+
+    auto white_space = [&]()
+    {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+    };
+
+    auto blank_space = [&]()
+    {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) p++;
+    };
+
+    auto keyword = [&](const char* word, size_t length)
+    {
+        if ((size_t) (end - p) < length || std::memcmp(p, word, length) != 0)
+            return false;
+
+        p += length;
+        return true;
+    };
+
+    // Reserve for the smallest facets we are likely to see; the coordinates
+    // are only touched as they are written.
+    coordinates.reserve(9 * ((end - begin) / 128 + 1));
+
+    blank_space();
+
+    while (p < end)
+    {
+        if (!keyword("facet normal", 12)) return false;
+
+        // Skip the normal...
+        auto line_end = (const char*) std::memchr(p, '\n', end - p);
+
+        if (!line_end) return false;
+        p = line_end + 1;
+
+        blank_space();
+        if (!keyword("outer loop", 10)) return false;
+
+        for (size_t i = 0; i < 3; i++)
+        {
+            blank_space();
+            if (!keyword("vertex", 6)) return false;
+
+            for (size_t j = 0; j < 3; j++)
+            {
+                G4double value;
+
+                white_space();
+
+                auto number_end = NumberParser::Parse(p, end, value);
+                if (number_end == p) return false;
+
+                p = number_end;
+
+                coordinates.push_back(value);
+            }
+
+            // Expecting a new line at the end of a three vector.
+            white_space();
+            if (p >= end || *p != '\n') return false;
+            p++;
+        }
+
+        blank_space();
+        if (!keyword("endloop", 7)) return false;
+
+        blank_space();
+        if (!keyword("endfacet", 8)) return false;
+
+        blank_space();
+    }
+
+    return true;
+}
+
+
+// Binary STL files are an 80 byte header, a little endian 32 bit facet count,
+// and then 50 bytes per facet: a normal, three vertices, and two attribute
+// bytes. The header is free text, and some exporters (SolidWorks among them)
+// start it with "solid", so the size of the file decides.
+G4bool STLReader::IsBinary(MappedFile& file)
+{
+    return IsBinary( (const unsigned char*) file.Data()
+                   , std::min<size_t>(file.Size(), 84)
+                   , file.Size());
+}
+
+
+G4bool STLReader::IsBinary( const unsigned char* header
+                          , size_t header_size
+                          , size_t file_size)
+{
+    if (header_size < 84)
+    {
+        return false;
+    }
+
+    auto count = (uint64_t) ReadUInt32(header + 80);
+
+    if (84 + 50 * count == file_size)
+    {
+        return true;
+    }
+
+    return std::strncmp((const char*) header, "solid", 5) != 0;
+}
+
+
+G4bool STLReader::ReadBinary(MappedFile& file)
+{
+    auto data = (const unsigned char*) file.Data();
+    auto count = (size_t) ReadUInt32(data + 80);
+
+    if (count == 0)
+    {
+        Exceptions::ParserError("STLReader::ReadBinary", "The STL file appears to be empty.");
+    }
+
+    CheckBinarySize(count, file.Size());
+
+    auto name = NameFromHeader(data);
+
+    Points corners(3 * count);
+
+    // Records are independent, so they are split into contiguous ranges.
+    ParallelFor(count, NumberOfChunks(file.Size()), [&](size_t i)
+    {
+        // Skip the normal, it is recomputed by the facet.
+        auto vertices = data + 84 + 50 * i + 12;
+
+        corners[3 * i] = ReadThreeVector(vertices);
+        corners[3 * i + 1] = ReadThreeVector(vertices + 12);
+        corners[3 * i + 2] = ReadThreeVector(vertices + 24);
+    });
+
+    AddMesh(Mesh::FromCorners(std::move(corners), name));
+
+    return true;
+}
+
+
+G4String STLReader::NameFromHeader(const unsigned char* data)
+{
+    // The header up to the first null is the closest thing to a name.
+    auto header = std::string((const char*) data, 80);
+    header = header.substr(0, header.find('\0'));
+    header = header.substr(0, header.find_last_not_of(" \t\r\n") + 1);
+
+    if (header.compare(0, 5, "solid") == 0)
+    {
+        header = header.substr(std::min(header.find_first_not_of(" \t", 5), header.size()));
+    }
+
+    return header;
+}
+
+
+void STLReader::CheckBinarySize(size_t count, size_t file_size)
+{
+    if (84 + 50 * (uint64_t) count > file_size)
+    {
+        std::stringstream error;
+        error << "The binary STL file is truncated. The header lists "
+              << count << " facets, which requires " << 84 + 50 * (uint64_t) count
+              << " bytes, but the file is only " << file_size << " bytes.";
+
+        Exceptions::ParserError("STLReader::ReadBinary", error.str());
+    }
+}
+
+
+uint32_t STLReader::ReadUInt32(const unsigned char* bytes)
+{
+    return  (uint32_t) bytes[0]
+         | ((uint32_t) bytes[1] << 8)
+         | ((uint32_t) bytes[2] << 16)
+         | ((uint32_t) bytes[3] << 24);
+}
+
+
+G4ThreeVector STLReader::ReadThreeVector(const unsigned char* bytes)
+{
+    float x, y, z;
+
+    auto ux = ReadUInt32(bytes);
+    auto uy = ReadUInt32(bytes + 4);
+    auto uz = ReadUInt32(bytes + 8);
+
+    std::memcpy(&x, &ux, sizeof(float));
+    std::memcpy(&y, &uy, sizeof(float));
+    std::memcpy(&z, &uz, sizeof(float));
+
+    return G4ThreeVector(x, y, z);
+}
+
+
 G4bool STLReader::CanRead(Type file_type)
 {
     return (file_type == STL);
 }
 
 
-std::shared_ptr<Mesh> STLReader::ParseMesh(Items items)
+G4bool STLReader::Stream(G4String filepath, MeshSink& sink)
+{
+    FileStream file(filepath, StreamChunkSize());
+
+    if (!file.IsOpen())
+    {
+        Exceptions::ParserError("STLReader::Stream", "The STL file could not be opened.");
+    }
+
+    auto header_size = std::min<size_t>(file.Size(), 84);
+
+    if (IsBinary(file.Peek(header_size), header_size, file.Size()))
+    {
+        return StreamBinary(file, sink);
+    }
+
+    return StreamText(file, sink);
+}
+
+
+G4bool STLReader::StreamText(FileStream& file, MeshSink& sink)
+{
+    G4bool in_solid = false;
+    G4bool in_facet = false;
+    size_t solids = 0;
+
+    G4ThreeVector vertices[3];
+    size_t vertex_count = 0;
+
+    auto error = [&](std::string message)
+    {
+        std::stringstream error;
+        error << message << " Error around line " << file.LineNumber() << ".";
+
+        Exceptions::ParserError("STLReader::Stream", error.str());
+    };
+
+    const char* begin;
+    const char* end;
+
+    // One line at a time, so only the line being parsed needs to be held.
+    while (file.NextLine(begin, end))
+    {
+        auto p = begin;
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+
+        if (p == end)
+        {
+            continue;
+        }
+
+        auto keyword = [&](const char* word)
+        {
+            auto length = std::strlen(word);
+
+            if ((size_t) (end - p) < length || std::memcmp(p, word, length) != 0)
+                return false;
+
+            p += length;
+            return true;
+        };
+
+        if (keyword("endsolid"))
+        {
+            if (!in_solid || in_facet)
+                error("Unexpected 'endsolid'.");
+
+            sink.EndMesh();
+            in_solid = false;
+        }
+
+        else if (keyword("solid"))
+        {
+            if (in_solid)
+                error("Expecting 'endsolid' before the next 'solid'.");
+
+            while (p < end && (*p == ' ' || *p == '\t')) p++;
+
+            auto name_end = p;
+            while (name_end < end && *name_end != '\r') name_end++;
+
+            sink.StartMesh(std::string(p, name_end));
+            in_solid = true;
+            solids++;
+        }
+
+        else if (keyword("facet"))
+        {
+            if (!in_solid || in_facet)
+                error("Unexpected 'facet'.");
+
+            // The normal is recomputed by the facet.
+            in_facet = true;
+            vertex_count = 0;
+        }
+
+        else if (keyword("vertex"))
+        {
+            if (!in_facet)
+                error("Unexpected 'vertex'.");
+
+            if (vertex_count == 3)
+                error("A facet must have exactly three vertices.");
+
+            G4double numbers[3];
+
+            for (auto& number : numbers)
+            {
+                while (p < end && (*p == ' ' || *p == '\t')) p++;
+
+                auto number_end = NumberParser::Parse(p, end, number);
+
+                if (number_end == p)
+                    error("Expecting three numbers after 'vertex'.");
+
+                p = number_end;
+            }
+
+            vertices[vertex_count++] = G4ThreeVector(numbers[0], numbers[1], numbers[2]);
+        }
+
+        else if (keyword("endfacet"))
+        {
+            if (!in_facet || vertex_count != 3)
+                error("A facet must have exactly three vertices.");
+
+            sink.AddTriangle(vertices[0], vertices[1], vertices[2]);
+            in_facet = false;
+        }
+
+        else if (!in_facet || !(keyword("outer loop") || keyword("endloop")))
+        {
+            error("Unexpected '" + std::string(p, end) + "'.");
+        }
+    }
+
+    if (solids == 0)
+    {
+        Exceptions::ParserError("STLReader::Stream", "The STL file appears to be empty.");
+    }
+
+    if (in_solid)
+    {
+        error("Expecting 'endsolid' at the end of the file.");
+    }
+
+    return true;
+}
+
+
+G4bool STLReader::StreamBinary(FileStream& file, MeshSink& sink)
+{
+    auto header = file.Read(84);
+    auto count = (size_t) ReadUInt32(header + 80);
+
+    if (count == 0)
+    {
+        Exceptions::ParserError("STLReader::Stream", "The STL file appears to be empty.");
+    }
+
+    CheckBinarySize(count, file.Size());
+
+    sink.StartMesh(NameFromHeader(header));
+
+    for (size_t i = 0; i < count; i++)
+    {
+        // Skip the normal, it is recomputed by the facet.
+        auto vertices = file.Read(50) + 12;
+
+        sink.AddTriangle( ReadThreeVector(vertices)
+                        , ReadThreeVector(vertices + 12)
+                        , ReadThreeVector(vertices + 24));
+    }
+
+    sink.EndMesh();
+
+    return true;
+}
+
+
+std::shared_ptr<Mesh> STLReader::ParseMesh(Items& items, size_t solid)
 {
-    Triangles triangles;
+    Points corners;
 
-    for (auto item : items)
+    for (auto item : items.ChildrenOf(solid))
     {
-        if (item.children.size() == 0)
+        if (!items.HasChildren(item))
         {
             std::stringstream error;
             error << "The facet appears to be empty."
-                    << "Error around line " << item.line << ".";
+                    << "Error around line " << items.LineNumber(item) << ".";
 
             Exceptions::ParserError("STLReader::Mesh", error.str());
         }
 
-        triangles.push_back(ParseFacet(item.children));
+        auto facet = ParseFacet(items, item);
+        corners.insert(corners.end(), facet.begin(), facet.end());
     }
 
-    return Mesh::New(triangles);
+    return Mesh::FromCorners(std::move(corners));
 }   
 
 
-G4TriangularFacet* STLReader::ParseFacet(Items items)
+Points STLReader::ParseFacet(Items& items, size_t facet)
 {
-    Triangles triangles;
+    std::vector<Points> triangles;
 
-    for (auto item : items)
+    for (auto item : items.ChildrenOf(facet))
     {
-        if (item.children.size() == 0)
+        if (!items.HasChildren(item))
         {
             std::stringstream error;
             error << "The vertex appears to be empty."
-                    << "Error around line " << item.line << ".";
+                    << "Error around line " << items.LineNumber(item) << ".";
 
             Exceptions::ParserError("STLReader::ParseFacet", error.str());
         }
 
-        triangles.push_back(ParseVertices(item.children)); 
+        triangles.push_back(ParseVertices(items, item)); 
     }
 
     if (triangles.size() != 1)
@@ -285,9 +763,9 @@ G4TriangularFacet* STLReader::ParseFacet(Items items)
         std::stringstream error;
         error << "STL files expect exactly 1 triangle per facet.";
 
-        if (items.size() != 0)
+        if (items.HasChildren(facet))
         {
-            error << "Error around line " << items[0].line << ".";
+            error << "Error around line " << items.LineNumber(items[facet].first_child) << ".";
         }
 
         Exceptions::ParserError("STLReader::ParseFacet", error.str());
@@ -297,22 +775,22 @@ G4TriangularFacet* STLReader::ParseFacet(Items items)
 }
 
 
-G4TriangularFacet* STLReader::ParseVertices(Items items)
+Points STLReader::ParseVertices(Items& items, size_t vertices_item)
 {
-    std::vector<G4ThreeVector> vertices; 
+    Points vertices; 
 
-    for (auto item : items)
+    for (auto item : items.ChildrenOf(vertices_item))
     {
-        if (item.children.size() == 0)
+        if (!items.HasChildren(item))
         {
             std::stringstream error;
             error << "The vertex appears to be empty."
-                    << "Error around line " << item.line << ".";
+                    << "Error around line " << items.LineNumber(item) << ".";
 
             Exceptions::ParserError("STLReader::ParseVertices", error.str());
         }
     
-        vertices.push_back(ParseThreeVector(item.children)); 
+        vertices.push_back(ParseThreeVector(items, item)); 
     }
 
     if (vertices.size() != 3)
@@ -320,38 +798,41 @@ G4TriangularFacet* STLReader::ParseVertices(Items items)
         std::stringstream error;
         error << "STL files expect exactly 3 vertices for a triangular facet. ";
 
-        if (items.size() != 0)
+        if (items.HasChildren(vertices_item))
         {
-            error << "Error around line " << items[0].line << ".";
+            error << "Error around line " << items.LineNumber(items[vertices_item].first_child) << ".";
         }
 
         Exceptions::ParserError("STLReader::ParseVertices", error.str());
     }
 
-    return new G4TriangularFacet( vertices[0]
-                                , vertices[1]
-                                , vertices[2]
-                                , ABSOLUTE);
+    return vertices;
 }
 
 
-G4ThreeVector STLReader::ParseThreeVector(Items items)
+G4ThreeVector STLReader::ParseThreeVector(Items& items, size_t three_vector)
 {
-    std::vector<double> numbers;
+    G4double numbers[3] = { 0, 0, 0 };
+    size_t count = 0;
 
-    for (auto item : items)
+    for (auto item : items.ChildrenOf(three_vector))
     {
-        numbers.push_back((double) atof(item.value.c_str()));
+        if (count < 3)
+        {
+            numbers[count] = items.DoubleValue(item);
+        }
+
+        count++;
     }
 
-    if (numbers.size() != 3)
+    if (count != 3)
     {
         std::stringstream error;
         error << "Three vectors in STL files require exactly 3 numbers";
 
-        if (items.size() != 0)
+        if (items.HasChildren(three_vector))
         {
-            error << "Error around line " << items[0].line << ".";
+            error << "Error around line " << items.LineNumber(items[three_vector].first_child) << ".";
         }
 
         Exceptions::ParserError("STLReader::ParseThreeVector", error.str());
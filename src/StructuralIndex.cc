@@ -0,0 +1,257 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2011-2020 Christopher M. Poole <mail@christopherpoole.net>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// CADMesh //
+#include "StructuralIndex.hh"
+
+// STL //
+#include <cstring>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define CADMESH_HAS_X86_SIMD
+#include <immintrin.h>
+#endif
+
+
+namespace CADMesh
+{
+
+namespace File
+{
+
+StructuralIndex::StructuralIndex(const char* data, size_t size, Kernel kernel)
+    : size_(size)
+{
+    if (!IsSupported(kernel))
+    {
+        kernel = Scalar;
+    }
+
+    auto classify = ClassifyScalar;
+
+    if (kernel == SSE2) classify = ClassifySSE2;
+    if (kernel == AVX2) classify = ClassifyAVX2;
+
+    auto words = (size + 63) / 64;
+
+    line_breaks_.resize(words);
+    white_space_.resize(words);
+
+    auto whole = size / 64;
+
+    for (size_t i = 0; i < whole; i++)
+    {
+        classify(data + 64 * i, line_breaks_[i], white_space_[i]);
+    }
+
+    // The tail is padded with nulls, which are neither.
+    if (whole < words)
+    {
+        char block[64] = {};
+        std::memcpy(block, data + 64 * whole, size - 64 * whole);
+
+        classify(block, line_breaks_[whole], white_space_[whole]);
+    }
+}
+
+
+StructuralIndex::Kernel StructuralIndex::Best()
+{
+    if (IsSupported(AVX2)) return AVX2;
+    if (IsSupported(SSE2)) return SSE2;
+
+    return Scalar;
+}
+
+
+bool StructuralIndex::IsSupported(Kernel kernel)
+{
+    if (kernel == Scalar)
+    {
+        return true;
+    }
+
+#ifdef CADMESH_HAS_X86_SIMD
+    // Reads CPUID once, the first time it is asked.
+    static const bool sse2 = __builtin_cpu_supports("sse2");
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+
+    if (kernel == SSE2) return sse2;
+    if (kernel == AVX2) return avx2;
+#endif
+
+    return false;
+}
+
+
+std::string StructuralIndex::KernelName(Kernel kernel)
+{
+    if (kernel == SSE2) return "SSE2";
+    if (kernel == AVX2) return "AVX2";
+
+    return "Scalar";
+}
+
+
+size_t StructuralIndex::NextNonWhiteSpace(size_t position) const
+{
+    return Find(position, [](uint64_t, uint64_t white_space)
+    {
+        return ~white_space;
+    });
+}
+
+
+size_t StructuralIndex::NextNonBlank(size_t position) const
+{
+    return Find(position, [](uint64_t line_breaks, uint64_t white_space)
+    {
+        return ~(line_breaks | white_space);
+    });
+}
+
+
+size_t StructuralIndex::NextLineBreak(size_t position) const
+{
+    return Find(position, [](uint64_t line_breaks, uint64_t)
+    {
+        return line_breaks;
+    });
+}
+
+
+size_t StructuralIndex::CountTrailingZeros(uint64_t word)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(word);
+#else
+    size_t count = 0;
+
+    while (!(word & 1))
+    {
+        word >>= 1;
+        count++;
+    }
+
+    return count;
+#endif
+}
+
+
+void StructuralIndex::ClassifyScalar( const char* block
+                                    , uint64_t& line_breaks
+                                    , uint64_t& white_space)
+{
+    line_breaks = 0;
+    white_space = 0;
+
+    for (size_t i = 0; i < 64; i++)
+    {
+        auto c = block[i];
+
+        if (c == '\n')
+            line_breaks |= 1ull << i;
+
+        else if (c == ' ' || c == '\t' || c == '\r')
+            white_space |= 1ull << i;
+    }
+}
+
+
+#ifdef CADMESH_HAS_X86_SIMD
+__attribute__((target("sse2")))
+void StructuralIndex::ClassifySSE2( const char* block
+                                  , uint64_t& line_breaks
+                                  , uint64_t& white_space)
+{
+    line_breaks = 0;
+    white_space = 0;
+
+    auto line_break = _mm_set1_epi8('\n');
+    auto space = _mm_set1_epi8(' ');
+    auto tab = _mm_set1_epi8('\t');
+    auto carriage_return = _mm_set1_epi8('\r');
+
+    for (size_t i = 0; i < 4; i++)
+    {
+        auto bytes = _mm_loadu_si128((const __m128i*) (block + 16 * i));
+
+        auto is_line_break = _mm_cmpeq_epi8(bytes, line_break);
+        auto is_white_space = _mm_or_si128( _mm_or_si128( _mm_cmpeq_epi8(bytes, space)
+                                                        , _mm_cmpeq_epi8(bytes, tab))
+                                          , _mm_cmpeq_epi8(bytes, carriage_return));
+
+        line_breaks |= (uint64_t) (uint16_t) _mm_movemask_epi8(is_line_break) << (16 * i);
+        white_space |= (uint64_t) (uint16_t) _mm_movemask_epi8(is_white_space) << (16 * i);
+    }
+}
+
+
+__attribute__((target("avx2")))
+void StructuralIndex::ClassifyAVX2( const char* block
+                                  , uint64_t& line_breaks
+                                  , uint64_t& white_space)
+{
+    line_breaks = 0;
+    white_space = 0;
+
+    auto line_break = _mm256_set1_epi8('\n');
+    auto space = _mm256_set1_epi8(' ');
+    auto tab = _mm256_set1_epi8('\t');
+    auto carriage_return = _mm256_set1_epi8('\r');
+
+    for (size_t i = 0; i < 2; i++)
+    {
+        auto bytes = _mm256_loadu_si256((const __m256i*) (block + 32 * i));
+
+        auto is_line_break = _mm256_cmpeq_epi8(bytes, line_break);
+        auto is_white_space = _mm256_or_si256( _mm256_or_si256( _mm256_cmpeq_epi8(bytes, space)
+                                                              , _mm256_cmpeq_epi8(bytes, tab))
+                                             , _mm256_cmpeq_epi8(bytes, carriage_return));
+
+        line_breaks |= (uint64_t) (uint32_t) _mm256_movemask_epi8(is_line_break) << (32 * i);
+        white_space |= (uint64_t) (uint32_t) _mm256_movemask_epi8(is_white_space) << (32 * i);
+    }
+}
+
+#else
+// Without x86 intrinsics every kernel is the scalar one.
+void StructuralIndex::ClassifySSE2( const char* block
+                                  , uint64_t& line_breaks
+                                  , uint64_t& white_space)
+{
+    ClassifyScalar(block, line_breaks, white_space);
+}
+
+
+void StructuralIndex::ClassifyAVX2( const char* block
+                                  , uint64_t& line_breaks
+                                  , uint64_t& white_space)
+{
+    ClassifyScalar(block, line_breaks, white_space);
+}
+#endif
+
+} // File namespace
+
+} // CADMesh namespace
+
@@ -22,8 +22,10 @@
 
 // CADMesh //
 #include "TessellatedMesh.hh"
+#include "Parallel.hh"
 
 // GEANT4 //
+#include "G4GeometryTolerance.hh"
 #include "G4UIcommand.hh"
 #include "Randomize.hh"
 
@@ -33,31 +35,57 @@ namespace CADMesh
 
 G4VSolid* TessellatedMesh::GetSolid()
 {
-    return (G4VSolid*) GetTessellatedSolid();
+    return GetSolid(0);
 }
 
 
 G4VSolid* TessellatedMesh::GetSolid(G4int index)
 {
-    return (G4VSolid*) GetTessellatedSolid(index);
+    return GetCachedSolid(reader_->GetMesh(index), NumberOfThreads(), solid_type_);
 }
 
 
 G4VSolid* TessellatedMesh::GetSolid(G4String name, G4bool exact)
 {
-    return (G4VSolid*) GetTessellatedSolid(name, exact);
+    return GetCachedSolid(reader_->GetMesh(name, exact), NumberOfThreads(), solid_type_);
 }
 
 
 std::vector<G4VSolid*> TessellatedMesh::GetSolids()
 {
-    std::vector<G4VSolid*> solids;
+    auto meshes = reader_->GetMeshes();
+    auto threads = NumberOfThreads();
 
-    for (auto mesh : reader_->GetMeshes())
+    std::vector<size_t> order(meshes.size());
+    size_t facets = 0;
+
+    for (size_t i = 0; i < meshes.size(); i++)
     {
-        solids.push_back(GetTessellatedSolid(mesh)); 
+        order[i] = i;
+        facets += meshes[i]->GetNumberOfTriangles();
+    }
+
+    // The larger meshes are started first, so the smaller ones fill in
+    // around them, and each is given a share of the threads to build its
+    // facets on. The solids come back in the order of the meshes.
+    if (threads > 1)
+    {
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b)
+        {
+            return meshes[a]->GetNumberOfTriangles() > meshes[b]->GetNumberOfTriangles();
+        });
     }
 
+    std::vector<G4VSolid*> solids(meshes.size());
+
+    ParallelForEach(order.size(), threads, [&](size_t k)
+    {
+        auto mesh = meshes[order[k]];
+        auto share = facets > 0 ? threads * mesh->GetNumberOfTriangles() / facets : 0;
+
+        solids[order[k]] = GetCachedSolid(mesh, std::max<size_t>(share, 1), solid_type_);
+    });
+
     return solids;
 }
 
@@ -69,9 +97,15 @@ G4AssemblyVolume* TessellatedMesh::GetAssembly()
         return assembly_;
     }
 
-    for (auto mesh : reader_->GetMeshes())
+    assembly_ = new G4AssemblyVolume();
+
+    auto meshes = reader_->GetMeshes();
+    auto solids = GetSolids();
+
+    for (size_t i = 0; i < meshes.size(); i++)
     {
-        auto solid = GetTessellatedSolid(mesh); 
+        auto mesh = meshes[i];
+        auto solid = solids[i];
 
         // TODO: Determine the material for this solid.
         G4Material* material = nullptr;
@@ -112,31 +146,182 @@ G4TessellatedSolid* TessellatedMesh::GetTessellatedSolid(G4String name, G4bool e
 G4TessellatedSolid* TessellatedMesh::GetTessellatedSolid(
         std::shared_ptr<Mesh> mesh)
 {
-    auto volume_solid = new G4TessellatedSolid(mesh->GetName());
+    return (G4TessellatedSolid*) GetCachedSolid(mesh, NumberOfThreads(), Tessellated);
+}
+
+
+BVHSolid* TessellatedMesh::GetBVHSolid()
+{
+    return GetBVHSolid(0);
+}
+
+
+BVHSolid* TessellatedMesh::GetBVHSolid(G4int index)
+{
+    return GetBVHSolid(reader_->GetMesh(index));
+}
+
+
+BVHSolid* TessellatedMesh::GetBVHSolid(G4String name, G4bool exact)
+{
+    return GetBVHSolid(reader_->GetMesh(name, exact));
+}
+
+
+BVHSolid* TessellatedMesh::GetBVHSolid(std::shared_ptr<Mesh> mesh)
+{
+    return (BVHSolid*) GetCachedSolid(mesh, NumberOfThreads(), BVH);
+}
+
+
+G4VSolid* TessellatedMesh::GetCachedSolid( std::shared_ptr<Mesh> mesh
+                                         , size_t threads
+                                         , SolidType solid_type)
+{
+    std::shared_ptr<CachedSolid> cached;
 
-    for(auto triangle : mesh->GetTriangles())
     {
-        auto a = triangle->GetVertex(0) * scale_ + offset_;
-        auto b = triangle->GetVertex(1) * scale_ + offset_;
-        auto c = triangle->GetVertex(2) * scale_ + offset_;
-       
-        auto t = new G4TriangularFacet(a, b, c, ABSOLUTE);
+        std::lock_guard<std::mutex> lock(solids_mutex_);
 
-        if (reverse_)
+        auto key = SolidKey( mesh
+                           , mesh->GetModificationCount()
+                           , scale_
+                           , offset_.x()
+                           , offset_.y()
+                           , offset_.z()
+                           , reverse_
+                           , solid_type);
+
+        auto& entry = solids_[key];
+
+        if (!entry)
         {
-            volume_solid->AddFacet((G4VFacet*) t->GetFlippedFacet());
+            entry = std::make_shared<CachedSolid>();
         }
-       
+
+        cached = entry;
+    }
+
+    // Built outside the lock, so that different meshes can be built at the
+    // same time, but only once each.
+    std::call_once(cached->built, [&]()
+    {
+        if (solid_type == BVH)
+        {
+            cached->solid = BuildBVHSolid(mesh, threads);
+        }
+
         else
         {
-            volume_solid->AddFacet((G4VFacet*) t);
+            cached->solid = BuildTessellatedSolid(mesh, threads);
         }
+    });
+
+    return cached->solid;
+}
+
+
+void TessellatedMesh::InvalidateSolids()
+{
+    std::lock_guard<std::mutex> lock(solids_mutex_);
+
+    solids_.clear();
+}
+
+
+size_t TessellatedMesh::NumberOfThreads()
+{
+    if (number_of_threads_ > 0)
+    {
+        return number_of_threads_;
+    }
+
+    return std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+
+std::mutex& TessellatedMesh::SolidStoreMutex()
+{
+    static std::mutex mutex;
+
+    return mutex;
+}
+
+
+G4TessellatedSolid* TessellatedMesh::BuildTessellatedSolid(
+        std::shared_ptr<Mesh> mesh, size_t threads)
+{
+    if (mesh->IsReleased())
+    {
+        Exceptions::InvalidMesh( "TessellatedMesh::BuildTessellatedSolid"
+                               , "The mesh '" + mesh->GetName() + "' was released after its solid was built.");
+    }
+
+    G4TessellatedSolid* volume_solid = nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(SolidStoreMutex());
+        volume_solid = new G4TessellatedSolid(mesh->GetName());
+    }
+
+    // Facets are only built here, once each, from the mesh's coordinates and
+    // indices. Reversing swaps two corners rather than flipping a copy.
+    auto& x = mesh->GetX();
+    auto& y = mesh->GetY();
+    auto& z = mesh->GetZ();
+    auto& indices = mesh->GetIndices();
+
+    auto point = [&](uint32_t index)
+    {
+        return G4ThreeVector( x[index] * scale_ + offset_.x()
+                            , y[index] * scale_ + offset_.y()
+                            , z[index] * scale_ + offset_.z());
+    };
+
+    std::vector<G4VFacet*> facets;
+
+    if (coplanar_tolerance_ > 0)
+    {
+        facets = BuildMergedFacets(mesh, threads);
+    }
+
+    else
+    {
+        facets.resize(indices.size() / 3);
+
+        ParallelFor(facets.size(), threads, [&](size_t f)
+        {
+            auto a = point(indices[3 * f]);
+            auto b = point(indices[3 * f + 1]);
+            auto c = point(indices[3 * f + 2]);
+
+            if (reverse_)
+            {
+                facets[f] = (G4VFacet*) new G4TriangularFacet(a, c, b, ABSOLUTE);
+            }
+
+            else
+            {
+                facets[f] = (G4VFacet*) new G4TriangularFacet(a, b, c, ABSOLUTE);
+            }
+        });
+    }
+
+    for (auto facet : facets)
+    {
+        volume_solid->AddFacet(facet);
     }
 
     volume_solid->SetSolidClosed(true);
+
+    if (release_meshes_)
+    {
+        mesh->Release();
+    }
+
     /*
     if (volume_solid->GetNumberOfFacets() == 0) {
-        G4Exception( "TessellatedMesh::GetTessellatedSolid", "The loaded mesh has 0 faces."
+        G4Exception( "TessellatedMesh::BuildTessellatedSolid", "The loaded mesh has 0 faces."
                    , FatalException, "The file may be empty.");
         return nullptr;
     }
@@ -144,5 +329,151 @@ G4TessellatedSolid* TessellatedMesh::GetTessellatedSolid(
     return volume_solid;
 }
 
+
+std::vector<G4VFacet*> TessellatedMesh::BuildMergedFacets(
+        std::shared_ptr<Mesh> mesh, size_t threads)
+{
+    auto& x = mesh->GetX();
+    auto& y = mesh->GetY();
+    auto& z = mesh->GetZ();
+
+    Points points(x.size());
+
+    ParallelFor(points.size(), threads, [&](size_t i)
+    {
+        points[i] = G4ThreeVector( x[i] * scale_ + offset_.x()
+                                 , y[i] * scale_ + offset_.y()
+                                 , z[i] * scale_ + offset_.z());
+    });
+
+    // Merged after scaling, so that the tolerance is in the units of the
+    // solid.
+    CoplanarMerge merge(points, mesh->GetIndices(), coplanar_tolerance_, threads);
+
+    auto& triangles = merge.GetTriangles();
+    auto& quadrangles = merge.GetQuadrangles();
+    auto number_of_triangles = merge.GetNumberOfTriangles();
+
+    std::vector<G4VFacet*> facets(merge.GetNumberOfFacets());
+
+    ParallelFor(facets.size(), threads, [&](size_t f)
+    {
+        if (f < number_of_triangles)
+        {
+            auto& a = points[triangles[3 * f]];
+            auto& b = points[triangles[3 * f + 1]];
+            auto& c = points[triangles[3 * f + 2]];
+
+            if (reverse_)
+            {
+                facets[f] = (G4VFacet*) new G4TriangularFacet(a, c, b, ABSOLUTE);
+            }
+
+            else
+            {
+                facets[f] = (G4VFacet*) new G4TriangularFacet(a, b, c, ABSOLUTE);
+            }
+
+            return;
+        }
+
+        auto q = f - number_of_triangles;
+
+        auto& a = points[quadrangles[4 * q]];
+        auto& b = points[quadrangles[4 * q + 1]];
+        auto& c = points[quadrangles[4 * q + 2]];
+        auto& d = points[quadrangles[4 * q + 3]];
+
+        if (reverse_)
+        {
+            facets[f] = (G4VFacet*) new G4QuadrangularFacet(a, d, c, b, ABSOLUTE);
+        }
+
+        else
+        {
+            facets[f] = (G4VFacet*) new G4QuadrangularFacet(a, b, c, d, ABSOLUTE);
+        }
+    });
+
+    if (verbose_ > 0)
+    {
+        G4cout << "CADMesh: merged the coplanar facets of '" << mesh->GetName()
+               << "' from " << merge.GetNumberOfFacetsBefore()
+               << " to " << merge.GetNumberOfFacets()
+               << " (" << merge.GetNumberOfQuadrangles() << " quadrangular, "
+               << merge.GetNumberOfPointsRemoved() << " points removed)."
+               << G4endl;
+    }
+
+    return facets;
+}
+
+
+BVHSolid* TessellatedMesh::BuildBVHSolid(
+        std::shared_ptr<Mesh> mesh, size_t threads)
+{
+    if (mesh->IsReleased())
+    {
+        Exceptions::InvalidMesh( "TessellatedMesh::BuildBVHSolid"
+                               , "The mesh '" + mesh->GetName() + "' was released after its solid was built.");
+    }
+
+    auto& x = mesh->GetX();
+    auto& y = mesh->GetY();
+    auto& z = mesh->GetZ();
+
+    Points points(x.size());
+
+    ParallelFor(points.size(), threads, [&](size_t i)
+    {
+        points[i] = G4ThreeVector( x[i] * scale_ + offset_.x()
+                                 , y[i] * scale_ + offset_.y()
+                                 , z[i] * scale_ + offset_.z());
+    });
+
+    auto indices = mesh->GetIndices();
+
+    if (reverse_)
+    {
+        for (size_t f = 0; f < indices.size(); f += 3)
+        {
+            std::swap(indices[f + 1], indices[f + 2]);
+        }
+    }
+
+    // The hierarchy is built outside the lock, and has its own copy of the
+    // points, so the mesh can be released straight after.
+    auto hierarchy = std::make_shared<BoundingVolumeHierarchy>( points
+                                                              , indices
+                                                              , G4GeometryTolerance::GetInstance()->GetSurfaceTolerance()
+                                                              , threads);
+
+    std::shared_ptr<DistanceField> distance_field;
+
+    if (distance_field_cell_size_ > 0)
+    {
+        distance_field = std::make_shared<DistanceField>( *hierarchy
+                                                        , distance_field_cell_size_
+                                                        , 4
+                                                        , threads);
+    }
+
+    BVHSolid* volume_solid = nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(SolidStoreMutex());
+        volume_solid = new BVHSolid(mesh->GetName(), hierarchy);
+    }
+
+    volume_solid->SetDistanceField(distance_field);
+
+    if (release_meshes_)
+    {
+        mesh->Release();
+    }
+
+    return volume_solid;
+}
+
 } // CADMesh namespace
 
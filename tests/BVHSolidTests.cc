@@ -0,0 +1,233 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+// CADMesh //
+#include "CADMesh.hh"
+
+#include "Simulator.hh"
+
+#include <random>
+
+
+// Compares a BVHSolid with the G4TessellatedSolid of the same mesh at random
+// points in and around its bounding box, and along random directions.
+// Inside is only compared away from the surface, where the two solids can't
+// disagree by rounding, and normals only on it.
+void Compare(std::shared_ptr<CADMesh::TessellatedMesh> mesh)
+{
+    auto tessellated = mesh->GetTessellatedSolid();
+    auto bvh = mesh->GetBVHSolid();
+
+    G4ThreeVector minimum;
+    G4ThreeVector maximum;
+    bvh->BoundingLimits(minimum, maximum);
+
+    auto size = (maximum - minimum).mag();
+    auto tolerance = 1e-9 * size + 1e-9;
+
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<G4double> uniform(-0.2, 1.2);
+    std::normal_distribution<G4double> normal;
+
+    for (size_t i = 0; i < 2000; i++)
+    {
+        G4ThreeVector p( minimum.x() + uniform(generator) * (maximum.x() - minimum.x())
+                       , minimum.y() + uniform(generator) * (maximum.y() - minimum.y())
+                       , minimum.z() + uniform(generator) * (maximum.z() - minimum.z()));
+
+        G4ThreeVector v(normal(generator), normal(generator), normal(generator));
+        v = v.unit();
+
+        auto safety = tessellated->SafetyFromOutside(p, true);
+        auto inside = tessellated->Inside(p);
+
+        // Each safety is zero on the wrong side of the surface.
+        auto safety_in = inside == kOutside ? safety : 0;
+        auto safety_out = inside == kInside ? tessellated->SafetyFromInside(p, true) : 0;
+
+        REQUIRE( bvh->DistanceToIn(p) == Approx(safety_in).margin(tolerance) );
+        REQUIRE( bvh->DistanceToOut(p) == Approx(safety_out).margin(tolerance) );
+
+        if (safety < 1e-6 * size)
+        {
+            continue;
+        }
+
+        REQUIRE( bvh->Inside(p) == inside );
+
+        if (inside == kOutside)
+        {
+            auto distance = bvh->DistanceToIn(p, v);
+
+            REQUIRE( distance == Approx(tessellated->DistanceToIn(p, v)).margin(tolerance) );
+            REQUIRE( distance >= bvh->DistanceToIn(p) );
+        }
+
+        else
+        {
+            G4bool valid = true;
+            G4ThreeVector n;
+
+            auto distance = bvh->DistanceToOut(p, v, true, &valid, &n);
+
+            REQUIRE( distance == Approx(tessellated->DistanceToOut(p, v)).margin(tolerance) );
+            REQUIRE( distance >= bvh->DistanceToOut(p) );
+
+            // Leaving through the surface, so along its normal.
+            REQUIRE( n.dot(v) > 0 );
+        }
+    }
+
+    // Away from the surface the nearest facet can be a tie at an edge, so
+    // normals are only compared on it.
+    for (size_t i = 0; i < 200; i++)
+    {
+        auto p = bvh->GetPointOnSurface();
+
+        REQUIRE( bvh->Inside(p) == kSurface );
+        REQUIRE( bvh->SurfaceNormal(p).dot(tessellated->SurfaceNormal(p)) == Approx(1).margin(1e-9) );
+    }
+}
+
+
+SCENARIO( "Navigate a mesh through a bounding volume hierarchy." ) {
+
+    GIVEN( "the sphere in the file 'sphere.ply'" ) {
+        auto mesh = CADMesh::TessellatedMesh::FromPLY("../meshes/sphere.ply");
+
+        WHEN( "constructing the solid volume" ) {
+            mesh->SetSolidType(CADMesh::TessellatedMesh::BVH);
+            auto solid = mesh->GetSolid();
+
+            THEN( "the solid is a BVHSolid" ) {
+                REQUIRE( solid->GetEntityType() == "BVHSolid" );
+                REQUIRE( solid == mesh->GetBVHSolid() );
+            }
+
+            THEN( "the point (0, 0, 0) is inside the volume" ) {
+                REQUIRE( solid->Inside(G4ThreeVector(0, 0, 0)) == kInside );
+            }
+
+            THEN( "the point (1, 0, 0) is on the surface of the volume" ) {
+                REQUIRE( solid->Inside(G4ThreeVector(1, 0, 0)) == kSurface );
+            }
+
+            THEN( "the point (2, 0, 0) is outside the volume" ) {
+                REQUIRE( solid->Inside(G4ThreeVector(2, 0, 0)) == kOutside );
+            }
+
+            THEN( "a ray from outside enters at the sphere boundary" ) {
+                auto distance = solid->DistanceToIn( G4ThreeVector(-2, 0, 0)
+                                                   , G4ThreeVector(1, 0, 0));
+
+                REQUIRE( distance == Approx(1) );
+            }
+
+            THEN( "a ray from outside pointing away misses" ) {
+                auto distance = solid->DistanceToIn( G4ThreeVector(-2, 0, 0)
+                                                   , G4ThreeVector(-1, 0, 0));
+
+                REQUIRE( distance == kInfinity );
+            }
+
+            THEN( "it answers the same as a G4TessellatedSolid" ) {
+                Compare(mesh);
+            }
+
+            THEN( "the geometry should be navigable by the Geant4 kernel" ) {
+                REQUIRE_NOTHROW( Simulator(solid) );
+            }
+        }
+    }
+
+    GIVEN( "the box in the file 'box_solidworks.stl'" ) {
+        auto mesh = CADMesh::TessellatedMesh::FromSTL("../meshes/box_solidworks.stl");
+
+        WHEN( "constructing the solid volume" ) {
+            auto solid = mesh->GetBVHSolid();
+
+            THEN( "its volume and area are those of the mesh" ) {
+                G4ThreeVector minimum;
+                G4ThreeVector maximum;
+                solid->BoundingLimits(minimum, maximum);
+
+                auto size = maximum - minimum;
+
+                REQUIRE( solid->GetCubicVolume() == Approx(size.x() * size.y() * size.z()) );
+                REQUIRE( solid->GetSurfaceArea() == Approx(2 * (size.x() * size.y() + size.y() * size.z() + size.z() * size.x())) );
+            }
+
+            THEN( "points on its surface are on its surface" ) {
+                for (size_t i = 0; i < 100; i++)
+                {
+                    REQUIRE( solid->Inside(solid->GetPointOnSurface()) == kSurface );
+                }
+            }
+
+            THEN( "it answers the same as a G4TessellatedSolid" ) {
+                Compare(mesh);
+            }
+
+            THEN( "the geometry should be navigable by the Geant4 kernel" ) {
+                REQUIRE_NOTHROW( Simulator(solid) );
+            }
+        }
+    }
+
+    GIVEN( "the bunny in the file 'bunny.stl'" ) {
+        auto mesh = CADMesh::TessellatedMesh::FromSTL("../meshes/bunny.stl");
+
+        WHEN( "constructing the solid volume on several threads" ) {
+            mesh->SetNumberOfThreads(4);
+            auto solid = mesh->GetBVHSolid();
+
+            THEN( "it answers the same as a G4TessellatedSolid" ) {
+                Compare(mesh);
+            }
+
+            THEN( "the geometry should be navigable by the Geant4 kernel" ) {
+                REQUIRE_NOTHROW( Simulator(solid) );
+            }
+        }
+    }
+}
+
+
+SCENARIO( "Intersect rays with the same triangles on every kernel." ) {
+
+    GIVEN( "the bunny in the file 'bunny.stl'" ) {
+        auto mesh = CADMesh::TessellatedMesh::FromSTL("../meshes/bunny.stl");
+        auto bvh = mesh->GetBVHSolid()->GetHierarchy();
+
+        CADMesh::BoundingVolumeHierarchy scalar( bvh->GetPoints()
+                                               , bvh->GetIndices()
+                                               , 0, 1
+                                               , CADMesh::BoundingVolumeHierarchy::Scalar);
+
+        CADMesh::BoundingVolumeHierarchy best( bvh->GetPoints()
+                                             , bvh->GetIndices()
+                                             , 0, 1
+                                             , CADMesh::BoundingVolumeHierarchy::Best());
+
+        WHEN( "casting rays from the centre of its bounding box" ) {
+            auto centre = (bvh->GetMinimum() + bvh->GetMaximum()) / 2;
+
+            std::mt19937 generator(7);
+            std::normal_distribution<G4double> normal;
+
+            THEN( "every kernel finds the same crossing at the same distance" ) {
+                for (size_t i = 0; i < 1000; i++)
+                {
+                    G4ThreeVector v(normal(generator), normal(generator), normal(generator));
+                    v = v.unit();
+
+                    auto a = scalar.Intersect(centre, v);
+                    auto b = best.Intersect(centre, v);
+
+                    REQUIRE( a.triangle == b.triangle );
+                    REQUIRE( a.distance == b.distance );
+                }
+            }
+        }
+    }
+}
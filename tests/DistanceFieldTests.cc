@@ -0,0 +1,193 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+// CADMesh //
+#include "CADMesh.hh"
+
+#include <algorithm>
+#include <random>
+#include <sstream>
+
+
+SCENARIO( "Look up safety distances in a distance field." ) {
+
+    GIVEN( "the bunny in the file 'bunny.stl' as a BVHSolid" ) {
+        auto mesh = CADMesh::TessellatedMesh::FromSTL("../meshes/bunny.stl");
+        auto solid = mesh->GetBVHSolid();
+        auto hierarchy = solid->GetHierarchy();
+
+        auto minimum = hierarchy->GetMinimum();
+        auto maximum = hierarchy->GetMaximum();
+        auto size = (maximum - minimum).mag();
+
+        std::mt19937 generator(11);
+        std::uniform_real_distribution<G4double> uniform(-0.3, 1.3);
+
+        std::vector<G4ThreeVector> points(5000);
+
+        for (auto& point : points)
+        {
+            point = G4ThreeVector( minimum.x() + uniform(generator) * (maximum.x() - minimum.x())
+                                 , minimum.y() + uniform(generator) * (maximum.y() - minimum.y())
+                                 , minimum.z() + uniform(generator) * (maximum.z() - minimum.z()));
+        }
+
+        WHEN( "building a distance field on several threads" ) {
+            auto field = std::make_shared<CADMesh::DistanceField>(*hierarchy, size / 32, 4, 4);
+
+            THEN( "only the cells near the surface have bricks" ) {
+                REQUIRE( field->GetNumberOfBricks() > 0 );
+                REQUIRE( field->GetNumberOfBricks() < field->GetNumberOfCells() );
+            }
+
+            THEN( "the safety is never more than the distance to the surface" ) {
+                size_t exact = 0;
+
+                for (auto& point : points)
+                {
+                    auto safety = field->Safety(point);
+                    auto distance = std::sqrt(hierarchy->Closest(point).distance_squared);
+
+                    if (safety < 0)
+                    {
+                        exact++;
+                        continue;
+                    }
+
+                    REQUIRE( safety <= distance );
+                }
+
+                // Only those very near the surface are left to search for.
+                REQUIRE( exact < points.size() / 10 );
+            }
+
+            THEN( "the side of the surface a point is on agrees with the solid" ) {
+                for (auto& point : points)
+                {
+                    auto side = field->Side(point);
+
+                    if (side == 0)
+                    {
+                        continue;
+                    }
+
+                    REQUIRE( (side < 0 ? kInside : kOutside) == solid->Inside(point) );
+                }
+            }
+
+            THEN( "it reads back the same as it was written" ) {
+                std::stringstream stream;
+                field->Write(stream);
+
+                auto read = CADMesh::DistanceField::Read(stream);
+
+                REQUIRE( read->IsFor(*hierarchy) );
+                REQUIRE( read->GetNumberOfBricks() == field->GetNumberOfBricks() );
+
+                for (auto& point : points)
+                {
+                    REQUIRE( read->Safety(point) == field->Safety(point) );
+                    REQUIRE( read->Side(point) == field->Side(point) );
+                }
+            }
+
+            THEN( "the solid answers the same with the field as without it" ) {
+                std::vector<EInside> inside;
+                std::vector<G4double> safety;
+
+                for (auto& point : points)
+                {
+                    inside.push_back(solid->Inside(point));
+                    safety.push_back(solid->DistanceToIn(point));
+                }
+
+                solid->SetDistanceField(field);
+
+                for (size_t i = 0; i < points.size(); i++)
+                {
+                    REQUIRE( solid->Inside(points[i]) == inside[i] );
+                    REQUIRE( solid->DistanceToIn(points[i]) <= safety[i] );
+                }
+
+                solid->SetDistanceField(nullptr);
+            }
+
+            THEN( "the solid only searches for points the field can't bound" ) {
+                solid->SetDistanceField(field);
+
+                auto before = solid->GetNumberOfSearches();
+                size_t unbounded = 0;
+
+                for (auto& point : points)
+                {
+                    solid->DistanceToIn(point);
+                    solid->DistanceToOut(point);
+
+                    if (field->Safety(point) < 0)
+                        unbounded++;
+                }
+
+                auto searches = solid->GetNumberOfSearches() - before;
+
+                // Both safeties are looked up wherever the field has a bound,
+                // in cells with bricks too.
+                REQUIRE( searches == 2 * unbounded );
+                REQUIRE( searches < 2 * points.size() / 10 );
+
+                solid->SetDistanceField(nullptr);
+            }
+
+            THEN( "it can't be given to the solid of another mesh" ) {
+                auto sphere = CADMesh::TessellatedMesh::FromPLY("../meshes/sphere.ply");
+
+                REQUIRE_THROWS( sphere->GetBVHSolid()->SetDistanceField(field) );
+            }
+
+            THEN( "it is not for the mesh with one point moved inside its bounding box" ) {
+                auto points = hierarchy->GetPoints();
+                auto centre = (minimum + maximum) / 2;
+
+                // The point nearest the centre, so the box stays the same.
+                auto nearest = std::min_element(points.begin(), points.end(), [&](const G4ThreeVector& a, const G4ThreeVector& b)
+                {
+                    return (a - centre).mag2() < (b - centre).mag2();
+                });
+
+                *nearest += (centre - *nearest) * 0.01;
+
+                CADMesh::BoundingVolumeHierarchy moved(points, hierarchy->GetIndices());
+
+                REQUIRE( moved.GetNumberOfTriangles() == hierarchy->GetNumberOfTriangles() );
+                REQUIRE( moved.GetMinimum() == minimum );
+                REQUIRE( moved.GetMaximum() == maximum );
+
+                REQUIRE( field->IsFor(*hierarchy) );
+                REQUIRE_FALSE( field->IsFor(moved) );
+            }
+        }
+
+        WHEN( "setting a cell size on the mesh" ) {
+            mesh->SetDistanceFieldCellSize(size / 32);
+
+            THEN( "its BVHSolids are built with a distance field" ) {
+                auto with_field = mesh->GetBVHSolid();
+
+                REQUIRE( with_field != solid );
+                REQUIRE( with_field->GetDistanceField() );
+                REQUIRE( with_field->GetDistanceField()->GetCellSize() == size / 32 );
+            }
+        }
+    }
+}
+
+
+SCENARIO( "Read a distance field that isn't one." ) {
+
+    GIVEN( "a stream of text" ) {
+        std::stringstream stream("solid bunny");
+
+        THEN( "it can't be read as a distance field" ) {
+            REQUIRE_THROWS( CADMesh::DistanceField::Read(stream) );
+        }
+    }
+}
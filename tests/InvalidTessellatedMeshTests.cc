@@ -18,3 +18,201 @@ SCENARIO( "Load an invalid PLY file as a tessellated mesh.") {
         }
     }
 }
+
+
+SCENARIO( "Report what is wrong with an invalid mesh.") {
+
+    GIVEN( "the sphere in 'sphere.ply' with its last facet taken out" ) {
+        auto reader = CADMesh::File::BuiltIn();
+        reader->Read("../meshes/sphere.ply");
+
+        auto indices = reader->GetMesh()->GetIndices();
+        indices.resize(indices.size() - 3);
+
+        auto holed = CADMesh::Mesh::New(reader->GetMesh()->GetPoints(), indices);
+
+        WHEN( "validating it" ) {
+            auto validation = holed->Validate();
+
+            THEN( "the three edges around the hole are found" ) {
+                REQUIRE_FALSE( validation.IsValidForNavigation() );
+
+                REQUIRE( validation.boundary_edges.size() == 3 );
+                REQUIRE( validation.non_manifold_edges.empty() );
+                REQUIRE( validation.misoriented_edges.empty() );
+                REQUIRE( validation.degenerate_facets.empty() );
+
+                for (auto edge : validation.boundary_edges)
+                    REQUIRE( edge.facets.size() == 1 );
+            }
+        }
+
+        WHEN( "validating every mesh in the reader" ) {
+            auto validations = reader->Validate();
+
+            THEN( "the whole sphere is valid" ) {
+                REQUIRE( validations.size() == 1 );
+                REQUIRE( validations[0].IsValid() );
+            }
+        }
+    }
+
+    GIVEN( "the sphere in 'sphere.ply' with one facet turned over, one repeated and one flattened" ) {
+        auto reader = CADMesh::File::BuiltIn();
+        reader->Read("../meshes/sphere.ply");
+
+        auto mesh = reader->GetMesh();
+
+        auto points = mesh->GetPoints();
+        auto indices = mesh->GetIndices();
+
+        std::swap(indices[1], indices[2]);
+
+        indices.insert(indices.end(), indices.begin() + 3, indices.begin() + 6);
+        indices.insert(indices.end(), { indices[6], indices[6], indices[7] });
+
+        auto broken = CADMesh::Mesh::New(points, indices);
+
+        WHEN( "validating it" ) {
+            auto validation = broken->Validate();
+
+            THEN( "each defect is found where it is" ) {
+                auto facets = broken->GetNumberOfTriangles();
+
+                REQUIRE( validation.number_of_facets == facets );
+                REQUIRE( validation.boundary_edges.empty() );
+
+                REQUIRE( validation.misoriented_edges.size() == 3 );
+
+                for (auto edge : validation.misoriented_edges)
+                    REQUIRE( std::find(edge.facets.begin(), edge.facets.end(), 0) != edge.facets.end() );
+
+                REQUIRE( validation.non_manifold_edges.size() >= 3 );
+
+                REQUIRE( validation.degenerate_facets.size() == 1 );
+                REQUIRE( validation.degenerate_facets[0].index == facets - 1 );
+                REQUIRE( validation.degenerate_facets[0].a == validation.degenerate_facets[0].b );
+            }
+
+            THEN( "the same defects are found with any number of threads" ) {
+                auto other = broken->Validate(7);
+
+                REQUIRE( other.boundary_edges.size() == validation.boundary_edges.size() );
+                REQUIRE( other.non_manifold_edges.size() == validation.non_manifold_edges.size() );
+
+                for (size_t i = 0; i < validation.non_manifold_edges.size(); i++)
+                    REQUIRE( other.non_manifold_edges[i].facets == validation.non_manifold_edges[i].facets );
+            }
+        }
+    }
+}
+
+
+SCENARIO( "Repair degenerate facets.") {
+
+    auto reader = CADMesh::File::BuiltIn();
+    reader->Read("../meshes/sphere.ply");
+
+    auto points = reader->GetMesh()->GetPoints();
+    auto indices = reader->GetMesh()->GetIndices();
+
+    GIVEN( "the sphere in 'sphere.ply'" ) {
+        auto mesh = CADMesh::Mesh::New(points, indices);
+
+        WHEN( "repairing its degenerate facets" ) {
+            auto repair = mesh->RepairDegenerateFacets();
+
+            THEN( "there are none to repair" ) {
+                REQUIRE( repair.GetNumberOfDegenerateFacets() == 0 );
+                REQUIRE( mesh->GetIndices() == indices );
+            }
+        }
+    }
+
+    GIVEN( "the sphere in 'sphere.ply' with a point moved almost onto the next" ) {
+        auto a = indices[0];
+        auto b = indices[1];
+
+        points[a] = points[b] + 1e-10 * (points[a] - points[b]).unit();
+
+        auto mesh = CADMesh::Mesh::New(points, indices);
+        REQUIRE( mesh->Validate().degenerate_facets.size() == 2 );
+
+        WHEN( "repairing its degenerate facets" ) {
+            auto repair = mesh->RepairDegenerateFacets();
+
+            THEN( "the edge between them is collapsed, leaving the sphere closed" ) {
+                REQUIRE( repair.GetNumberOfDegenerateFacets() == 2 );
+                REQUIRE( repair.GetNumberOfCollapsedEdges() == 1 );
+                REQUIRE( repair.GetNumberOfRemovedFacets() == 2 );
+                REQUIRE( repair.GetNumberOfRemainingFacets() == 0 );
+
+                REQUIRE( mesh->GetNumberOfTriangles() == 1278 );
+                REQUIRE( mesh->GetNumberOfPoints() == points.size() - 1 );
+                REQUIRE( mesh->Validate().IsValid() );
+            }
+        }
+    }
+
+    GIVEN( "the sphere in 'sphere.ply' with a point moved onto the edge opposite it" ) {
+        auto a = indices[0];
+        auto b = indices[1];
+        auto c = indices[2];
+
+        points[c] = (points[a] + points[b]) / 2;
+
+        auto mesh = CADMesh::Mesh::New(points, indices);
+        REQUIRE( mesh->Validate().degenerate_facets.size() == 1 );
+
+        WHEN( "repairing its degenerate facets" ) {
+            auto repair = mesh->RepairDegenerateFacets();
+
+            THEN( "the edge is flipped, leaving the sphere closed" ) {
+                REQUIRE( repair.GetNumberOfDegenerateFacets() == 1 );
+                REQUIRE( repair.GetNumberOfFlippedEdges() == 1 );
+                REQUIRE( repair.GetNumberOfRemovedFacets() == 0 );
+                REQUIRE( repair.GetNumberOfRemainingFacets() == 0 );
+
+                REQUIRE( mesh->GetNumberOfTriangles() == 1280 );
+                REQUIRE( mesh->Validate().IsValid() );
+            }
+        }
+    }
+
+    GIVEN( "the sphere in 'sphere.ply' with a facet that uses a point twice" ) {
+        indices.insert(indices.end(), { indices[6], indices[6], indices[7] });
+
+        auto mesh = CADMesh::Mesh::New(points, indices);
+
+        WHEN( "repairing its degenerate facets" ) {
+            auto repair = mesh->RepairDegenerateFacets();
+
+            THEN( "the facet is removed" ) {
+                REQUIRE( repair.GetNumberOfRemovedFacets() == 1 );
+                REQUIRE( mesh->GetNumberOfTriangles() == 1280 );
+                REQUIRE( mesh->Validate().IsValid() );
+            }
+        }
+    }
+
+    GIVEN( "the sphere in 'sphere.ply' with thin facets" ) {
+        auto mesh = CADMesh::Mesh::New(points, indices);
+
+        WHEN( "repairing facets longer than they are high" ) {
+            auto repair = mesh->RepairDegenerateFacets(0, 1.2);
+
+            THEN( "some are repaired, and the sphere is still closed" ) {
+                REQUIRE( repair.GetNumberOfDegenerateFacets() > 0 );
+                REQUIRE( repair.GetNumberOfRemainingFacets() < repair.GetNumberOfDegenerateFacets() );
+                REQUIRE( mesh->Validate().IsValidForNavigation() );
+            }
+
+            THEN( "the same is done on any number of threads" ) {
+                auto other = CADMesh::Mesh::New(points, indices);
+                other->RepairDegenerateFacets(0, 1.2, kCarTolerance, 3);
+
+                REQUIRE( other->GetIndices() == mesh->GetIndices() );
+            }
+        }
+    }
+}
@@ -0,0 +1,118 @@
+#define CATCH_CONFIG_MAIN 
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "catch2/catch.hpp"
+
+#include "CADMesh.hh"
+#include "Lexer.hh"
+#include "LexerMacros.hh"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+
+// Count every heap allocation made by the test program.
+static std::atomic<size_t> allocations(0);
+
+void* operator new(size_t size)
+{
+    allocations++;
+
+    if (void* pointer = std::malloc(size))
+        return pointer;
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+
+using namespace CADMesh::File;
+
+// A lexer that visits every line of a file, testing the next state before
+// each transition like the built-in readers do.
+struct LineLexer
+{
+    CADMeshLexerStateDefinition(Line);
+    CADMeshLexerStateDefinition(Blank);
+    CADMeshLexerStateDefinition(Word);
+};
+
+State* LineLexer::CADMeshLexerState(Line)
+{
+    if (DidNotSkipLine())
+        FinalState();
+
+    TryState(Blank);
+    TryState(Word);
+    NextState(Line);
+}
+
+State* LineLexer::CADMeshLexerState(Blank)
+{
+    if (DidNotSkipLineBreak())
+        return nullptr;
+
+    NextState(Line);
+}
+
+State* LineLexer::CADMeshLexerState(Word)
+{
+    if (DidNotSkipLineBreak())
+        Error("no word");
+
+    NextState(Line);
+}
+
+
+SCENARIO( "Run the lexer state machine.") {
+
+    GIVEN( "the lines of the file 'bunny.stl'" ) {
+        auto lexer = Lexer("../meshes/bunny.stl");
+
+        // Index the line breaks up front, so only the transitions are counted.
+        lexer.LineNumber();
+
+        WHEN( "running a state for every line" ) {
+            auto before = allocations.load();
+            lexer.Run(LineLexer::LineState::Instance());
+            auto after = allocations.load();
+
+            THEN( "every line is visited" ) {
+                REQUIRE( lexer.AtEndOfFile() );
+                REQUIRE( lexer.LineNumber() == 21003 );
+            }
+
+            THEN( "state transitions do not allocate" ) {
+                // Only the root item of the run is allocated.
+                REQUIRE( after - before <= 1 );
+            }
+        }
+    }
+
+    GIVEN( "the file 'bunny.stl', with no line numbers looked up yet" ) {
+        auto lexer = Lexer("../meshes/bunny.stl");
+
+        WHEN( "running states that fail while they are tried" ) {
+            auto before = allocations.load();
+            lexer.Run(LineLexer::LineState::Instance());
+            auto after = allocations.load();
+
+            THEN( "the failures neither index the lines nor format messages" ) {
+                REQUIRE( lexer.AtEndOfFile() );
+                REQUIRE( after - before <= 1 );
+            }
+        }
+    }
+
+    GIVEN( "the file 'bunny.stl'" ) {
+        BENCHMARK( "state transitions per line" ) {
+            auto lexer = Lexer("../meshes/bunny.stl");
+            lexer.Run(LineLexer::LineState::Instance());
+            return lexer.GetRoot();
+        };
+    }
+}
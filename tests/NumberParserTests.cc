@@ -0,0 +1,201 @@
+#define CATCH_CONFIG_MAIN 
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "catch2/catch.hpp"
+
+#include "CADMesh.hh"
+#include "NumberParser.hh"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+
+
+using namespace CADMesh::File;
+
+// Every number in a mesh file, as it is written.
+static std::vector<std::string> NumbersIn(std::string filepath)
+{
+    std::ifstream file(filepath);
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+
+    auto text = buffer.str();
+    auto p = text.data();
+    auto end = p + text.size();
+
+    std::vector<std::string> numbers;
+
+    while (p < end)
+    {
+        auto number_end = NumberParser::Match(p, end);
+
+        if (number_end == p)
+        {
+            p++;
+            continue;
+        }
+
+        numbers.push_back(std::string(p, number_end));
+        p = number_end;
+    }
+
+    return numbers;
+}
+
+
+// The parser agrees with strtod to the bit, and consumes the whole number.
+static bool MatchesStrtod(std::string number)
+{
+    double value;
+    auto end = NumberParser::Parse(number.data(), number.data() + number.size(), value);
+
+    char* strtod_end;
+    double expected = std::strtod(number.c_str(), &strtod_end);
+
+    return end == number.data() + number.size()
+        && strtod_end == number.c_str() + number.size()
+        && std::memcmp(&value, &expected, sizeof(double)) == 0;
+}
+
+
+SCENARIO( "Parse numbers exactly as strtod does.") {
+
+    GIVEN( "the numbers in the example meshes" ) {
+        std::vector<std::string> numbers;
+
+        for (auto filepath : { "../meshes/bunny.stl"
+                             , "../meshes/box_solidworks.stl"
+                             , "../meshes/cow.obj"
+                             , "../meshes/shapes.obj"
+                             , "../meshes/sphere.ply"
+                             , "../meshes/box_solidworks.ply" })
+        {
+            auto file_numbers = NumbersIn(filepath);
+            numbers.insert(numbers.end(), file_numbers.begin(), file_numbers.end());
+        }
+
+        THEN( "every number is parsed to the same double" ) {
+            REQUIRE( numbers.size() > 50000 );
+
+            size_t mismatches = 0;
+
+            for (auto& number : numbers)
+            {
+                if (!MatchesStrtod(number))
+                    mismatches++;
+            }
+
+            REQUIRE( mismatches == 0 );
+        }
+    }
+
+    GIVEN( "random doubles written in several formats" ) {
+        std::mt19937_64 random(42);
+        std::uniform_real_distribution<double> uniform(-1000, 1000);
+        std::uniform_int_distribution<uint64_t> bits;
+
+        THEN( "every number is parsed to the same double" ) {
+            size_t mismatches = 0;
+            char buffer[64];
+
+            for (size_t i = 0; i < 100000; i++)
+            {
+                auto value = uniform(random);
+
+                snprintf(buffer, sizeof(buffer), "%.6f", value);
+                if (!MatchesStrtod(buffer)) mismatches++;
+
+                snprintf(buffer, sizeof(buffer), "%.6e", value);
+                if (!MatchesStrtod(buffer)) mismatches++;
+
+                snprintf(buffer, sizeof(buffer), "%.17g", value);
+                if (!MatchesStrtod(buffer)) mismatches++;
+
+                // Any finite double, to exercise the slow path too.
+                auto any = bits(random);
+                double any_value;
+                std::memcpy(&any_value, &any, sizeof(double));
+
+                if (std::isfinite(any_value))
+                {
+                    snprintf(buffer, sizeof(buffer), "%.17e", any_value);
+                    if (!MatchesStrtod(buffer)) mismatches++;
+                }
+            }
+
+            REQUIRE( mismatches == 0 );
+        }
+    }
+
+    GIVEN( "numbers at the edges of the fast path" ) {
+        THEN( "every number is parsed to the same double" ) {
+            for (auto number : { "0", "-0", "+0.0", "00012.5000", "9007199254740993"
+                               , "1e22", "1e23", "123e30", "1e-22", "1e-23"
+                               , "4.9e-324", "2.2250738585072014e-308", "1.7976931348623157e308"
+                               , "1e400", "-1e-400", "12345678901234567890"
+                               , "0.0000000000000000000000012345678901234567890"
+                               , "3.14159265358979323846264338327950288"
+                               , "1844674407370955162e23", "1844674407370955162e30"
+                               , "9999999999999999999e25" })
+            {
+                INFO( number );
+                REQUIRE( MatchesStrtod(number) );
+            }
+        }
+    }
+
+    GIVEN( "text that is not entirely a number" ) {
+        THEN( "only the number is consumed" ) {
+            std::string text = "12.5e";
+            double value;
+
+            auto end = NumberParser::Parse(text.data(), text.data() + text.size(), value);
+
+            REQUIRE( end == text.data() + 4 );
+            REQUIRE( value == 12.5 );
+        }
+
+        THEN( "nothing is consumed without digits" ) {
+            std::string text = "-.5";
+            double value;
+
+            auto end = NumberParser::Parse(text.data(), text.data() + text.size(), value);
+
+            REQUIRE( end == text.data() );
+        }
+    }
+}
+
+
+SCENARIO( "Compare the number parser with atof.") {
+
+    GIVEN( "the vertex columns of the file 'bunny.stl'" ) {
+        auto numbers = NumbersIn("../meshes/bunny.stl");
+
+        BENCHMARK( "atof" ) {
+            double sum = 0;
+
+            for (auto& number : numbers)
+                sum += atof(number.c_str());
+
+            return sum;
+        };
+
+        BENCHMARK( "NumberParser::Parse" ) {
+            double sum = 0;
+
+            for (auto& number : numbers)
+            {
+                double value;
+                NumberParser::Parse(number.data(), number.data() + number.size(), value);
+                sum += value;
+            }
+
+            return sum;
+        };
+    }
+}
@@ -0,0 +1,555 @@
+#define CATCH_CONFIG_MAIN 
+#include "catch2/catch.hpp"
+
+#include "CADMesh.hh"
+#include "Parallel.hh"
+#include "PLYReader.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <new>
+#include <set>
+#include <thread>
+
+
+using namespace CADMesh::File;
+
+// A path for a file the test writes, out of the way of the meshes.
+static std::string TemporaryPath(std::string name)
+{
+    for (auto variable : { "TMPDIR", "TMP", "TEMP" })
+    {
+        if (auto directory = std::getenv(variable))
+            return std::string(directory) + "/" + name;
+    }
+
+    return "/tmp/" + name;
+}
+
+
+// Every byte allocated, so that the work a load does can be measured
+// without timing it.
+static std::atomic<size_t> allocated_bytes(0);
+
+void* operator new(size_t size)
+{
+    allocated_bytes += size;
+
+    if (auto pointer = std::malloc(size ? size : 1))
+        return pointer;
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+
+// Write an ASCII PLY grid of n by n vertices, with two facets per square.
+static std::string WriteGrid(size_t n)
+{
+    auto filepath = TemporaryPath("grid_" + std::to_string(n) + ".ply");
+    std::ofstream file(filepath);
+
+    file << "ply\n"
+         << "format ascii 1.0\n"
+         << "element vertex " << n * n << "\n"
+         << "property float x\n"
+         << "property float y\n"
+         << "property float z\n"
+         << "element face " << 2 * (n - 1) * (n - 1) << "\n"
+         << "property list uchar int vertex_indices\n"
+         << "end_header\n";
+
+    for (size_t i = 0; i < n; i++)
+        for (size_t j = 0; j < n; j++)
+            file << i << " " << j << " " << (i * j) % 7 << "\n";
+
+    for (size_t i = 0; i < n - 1; i++)
+    {
+        for (size_t j = 0; j < n - 1; j++)
+        {
+            auto a = i * n + j;
+
+            file << "3 " << a << " " << a + 1 << " " << a + n << "\n";
+            file << "3 " << a + 1 << " " << a + n + 1 << " " << a + n << "\n";
+        }
+    }
+
+    return filepath;
+}
+
+
+// The bytes allocated while reading a file.
+static size_t LoadBytes(std::string filepath, size_t& facets)
+{
+    PLYReader reader;
+
+    auto before = allocated_bytes.load();
+    reader.Read(filepath);
+    auto bytes = allocated_bytes.load() - before;
+
+    facets = reader.GetMesh()->GetNumberOfTriangles();
+
+    return bytes;
+}
+
+
+SCENARIO( "Read PLY files of increasing size.") {
+
+    GIVEN( "grids with about 20k and 80k facets" ) {
+        auto small = WriteGrid(101);
+        auto large = WriteGrid(201);
+
+        WHEN( "reading each file" ) {
+            size_t small_facets = 0;
+            size_t large_facets = 0;
+
+            auto small_bytes = LoadBytes(small, small_facets);
+            auto large_bytes = LoadBytes(large, large_facets);
+
+            THEN( "every facet is read" ) {
+                REQUIRE( small_facets == 20000 );
+                REQUIRE( large_facets == 80000 );
+            }
+
+            THEN( "the memory used scales linearly with the number of facets" ) {
+                // Four times the facets; copying the vertices for each facet
+                // would be sixteen.
+                REQUIRE( large_bytes < 6 * small_bytes );
+            }
+        }
+
+        std::remove(small.c_str());
+        std::remove(large.c_str());
+    }
+}
+
+
+// Every vertex of every mesh, in order.
+static std::vector<G4ThreeVector> VerticesOf(CADMesh::Meshes meshes)
+{
+    std::vector<G4ThreeVector> vertices;
+
+    for (auto mesh : meshes)
+        for (auto index : mesh->GetIndices())
+            vertices.push_back(mesh->GetPoint(index));
+
+    return vertices;
+}
+
+
+SCENARIO( "Read files in parallel chunks.") {
+
+    for (auto filepath : { "../meshes/shapes.obj"
+                         , "../meshes/cow.obj"
+                         , "../meshes/sphere.ply"
+                         , "../meshes/bunny.stl" })
+    {
+        GIVEN( std::string("the file '") + filepath + "'" ) {
+            auto serial = BuiltIn();
+            serial->SetNumberOfThreads(1);
+            serial->Read(filepath);
+
+            WHEN( "reading it with many more chunks than threads" ) {
+                auto parallel = BuiltIn();
+                parallel->SetNumberOfThreads(16);
+                parallel->Read(filepath);
+
+                THEN( "the same meshes are read" ) {
+                    REQUIRE( parallel->GetNumberOfMeshes() == serial->GetNumberOfMeshes() );
+
+                    for (size_t i = 0; i < serial->GetNumberOfMeshes(); i++)
+                    {
+                        REQUIRE( parallel->GetMesh(i)->GetName() == serial->GetMesh(i)->GetName() );
+                    }
+                }
+
+                THEN( "the same vertices are read in the same order" ) {
+                    REQUIRE( VerticesOf(parallel->GetMeshes()) == VerticesOf(serial->GetMeshes()) );
+                }
+            }
+        }
+    }
+}
+
+
+SCENARIO( "Raise errors from worker threads on the calling thread.") {
+
+    GIVEN( "work split over four threads, with errors in two blocks" ) {
+        std::thread::id raised_on;
+        size_t raised_for = 0;
+
+        auto work = [&](size_t i)
+        {
+            if (i == 3 || i == 6)
+            {
+                throw CADMesh::WorkerError([&, i]()
+                {
+                    raised_on = std::this_thread::get_id();
+                    raised_for = i;
+                });
+            }
+        };
+
+        WHEN( "running it" ) {
+            CADMesh::ParallelFor(8, 4, work);
+
+            THEN( "the error from the earliest block is raised once, after the join" ) {
+                REQUIRE( raised_on == std::this_thread::get_id() );
+                REQUIRE( raised_for == 3 );
+                REQUIRE_FALSE( CADMesh::IsWorkerThread() );
+            }
+        }
+
+        WHEN( "running it with each thread taking the next index" ) {
+            CADMesh::ParallelForEach(8, 4, work);
+
+            THEN( "the error from the lowest index is raised after the join" ) {
+                REQUIRE( raised_on == std::this_thread::get_id() );
+                REQUIRE( raised_for == 3 );
+            }
+        }
+    }
+}
+
+
+SCENARIO( "Share threads between nested parallel calls.") {
+
+    GIVEN( "work split over four threads, each splitting its own over eight" ) {
+        std::mutex mutex;
+        std::vector<std::set<std::thread::id> > inner_threads(4);
+
+        WHEN( "running it" ) {
+            CADMesh::ParallelFor(4, 4, [&](size_t t)
+            {
+                CADMesh::ParallelFor(8, 8, [&](size_t)
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    inner_threads[t].insert(std::this_thread::get_id());
+                });
+            });
+
+            THEN( "each inner call uses no more than its share of the threads" ) {
+                size_t hardware = std::thread::hardware_concurrency();
+                auto share = std::max<size_t>(1, std::max<size_t>(4, hardware) / 4);
+
+                for (auto& threads : inner_threads)
+                {
+                    REQUIRE( threads.size() <= share );
+                }
+
+                REQUIRE( CADMesh::ThreadShare() == 0 );
+            }
+        }
+    }
+}
+
+
+// Counts what is streamed to it, keeping nothing.
+class CountingSink : public MeshSink
+{
+  public:
+    void StartMesh(G4String) { meshes++; };
+    void AddTriangle(const G4ThreeVector&, const G4ThreeVector&, const G4ThreeVector&) { triangles++; };
+    void EndMesh() { };
+
+    size_t meshes = 0;
+    size_t triangles = 0;
+};
+
+
+SCENARIO( "Stream files a chunk at a time.") {
+
+    for (auto filepath : { "../meshes/shapes.obj"
+                         , "../meshes/cow.obj"
+                         , "../meshes/sphere.ply"
+                         , "../meshes/sphere_binary.ply"
+                         , "../meshes/box_solidworks_binary.ply"
+                         , "../meshes/bunny.stl"
+                         , "../meshes/box_solidworks_binary.stl" })
+    {
+        GIVEN( std::string("the file '") + filepath + "'" ) {
+            auto whole = BuiltIn();
+            whole->Read(filepath);
+
+            WHEN( "streaming it through chunks smaller than a line" ) {
+                auto streamed = BuiltIn();
+                streamed->SetChunkSize(7);
+                streamed->Read(filepath);
+
+                THEN( "the same meshes are read" ) {
+                    REQUIRE( streamed->GetNumberOfMeshes() == whole->GetNumberOfMeshes() );
+
+                    for (size_t i = 0; i < whole->GetNumberOfMeshes(); i++)
+                    {
+                        REQUIRE( streamed->GetMesh(i)->GetName() == whole->GetMesh(i)->GetName() );
+                    }
+                }
+
+                THEN( "the same vertices are read in the same order" ) {
+                    REQUIRE( VerticesOf(streamed->GetMeshes()) == VerticesOf(whole->GetMeshes()) );
+                }
+            }
+
+            WHEN( "streaming it to a sink" ) {
+                CountingSink sink;
+                BuiltIn()->Stream(filepath, sink);
+
+                THEN( "every triangle arrives" ) {
+                    size_t triangles = 0;
+
+                    for (auto mesh : whole->GetMeshes())
+                        triangles += mesh->GetNumberOfTriangles();
+
+                    REQUIRE( sink.meshes == whole->GetNumberOfMeshes() );
+                    REQUIRE( sink.triangles == triangles );
+                }
+            }
+        }
+    }
+}
+
+
+// Write a unit cube as six square faces, in the given PLY format.
+static std::string WriteCube(std::string format)
+{
+    auto filepath = TemporaryPath("cube_" + format + ".ply");
+    std::ofstream file(filepath, std::ios::binary);
+
+    file << "ply\n"
+         << "format " << format << " 1.0\n"
+         << "element vertex 8\n"
+         << "property float x\n"
+         << "property float y\n"
+         << "property float z\n"
+         << "element face 6\n"
+         << "property list uchar int vertex_indices\n"
+         << "end_header\n";
+
+    float corners[8][3] = { { 0, 0, 0 }, { 1, 0, 0 }, { 1, 1, 0 }, { 0, 1, 0 }
+                          , { 0, 0, 1 }, { 1, 0, 1 }, { 1, 1, 1 }, { 0, 1, 1 } };
+
+    uint32_t faces[6][4] = { { 0, 3, 2, 1 }, { 4, 5, 6, 7 }, { 0, 1, 5, 4 }
+                           , { 1, 2, 6, 5 }, { 2, 3, 7, 6 }, { 3, 0, 4, 7 } };
+
+    // Little endian, whatever the machine is.
+    auto write = [&](uint32_t value)
+    {
+        for (size_t i = 0; i < 4; i++)
+            file.put((char) ((value >> (8 * i)) & 0xff));
+    };
+
+    for (auto& corner : corners)
+    {
+        if (format == "ascii")
+        {
+            file << corner[0] << " " << corner[1] << " " << corner[2] << "\n";
+            continue;
+        }
+
+        for (auto value : corner)
+        {
+            uint32_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            write(bits);
+        }
+    }
+
+    for (auto& face : faces)
+    {
+        if (format == "ascii")
+        {
+            file << "4 " << face[0] << " " << face[1] << " " << face[2] << " " << face[3] << "\n";
+            continue;
+        }
+
+        file.put(4);
+
+        for (auto index : face)
+            write(index);
+    }
+
+    return filepath;
+}
+
+
+SCENARIO( "Read PLY faces with more than three vertices.") {
+
+    for (auto format : { "ascii", "binary_little_endian" })
+    {
+        GIVEN( std::string("a cube of six square faces in ") + format ) {
+            auto filepath = WriteCube(format);
+
+            WHEN( "reading it" ) {
+                PLYReader reader;
+                reader.Read(filepath);
+
+                THEN( "each face is split into two triangles" ) {
+                    REQUIRE( reader.GetMesh()->GetNumberOfTriangles() == 12 );
+                    REQUIRE( reader.GetMesh()->Validate().IsValid() );
+                }
+            }
+
+            WHEN( "streaming it to a sink" ) {
+                CountingSink sink;
+                PLYReader().Stream(filepath, sink);
+
+                THEN( "each face arrives as two triangles" ) {
+                    REQUIRE( sink.triangles == 12 );
+                }
+            }
+
+            std::remove(filepath.c_str());
+        }
+    }
+
+    GIVEN( "a header with no face element" ) {
+        auto filepath = TemporaryPath("no_faces.ply");
+
+        std::ofstream(filepath) << "ply\n"
+                                << "format ascii 1.0\n"
+                                << "element vertex 3\n"
+                                << "property float x\n"
+                                << "property float y\n"
+                                << "property float z\n"
+                                << "end_header\n"
+                                << "0 0 0\n1 0 0\n0 1 0\n";
+
+        THEN( "reading it fails" ) {
+            PLYReader reader;
+            REQUIRE_THROWS( reader.Read(filepath) );
+        }
+
+        std::remove(filepath.c_str());
+    }
+}
+
+
+SCENARIO( "Read meshes into shared, indexed points.") {
+
+    GIVEN( "the four objects in the file 'shapes.obj'" ) {
+        auto reader = BuiltIn();
+        reader->Read("../meshes/shapes.obj");
+
+        THEN( "each object keeps only the points it uses" ) {
+            size_t points = 0;
+
+            for (auto mesh : reader->GetMeshes())
+            {
+                std::set<uint32_t> used(mesh->GetIndices().begin(), mesh->GetIndices().end());
+
+                REQUIRE( used.size() == mesh->GetNumberOfPoints() );
+                REQUIRE( *used.rbegin() == mesh->GetNumberOfPoints() - 1 );
+
+                points += mesh->GetNumberOfPoints();
+            }
+
+            REQUIRE( reader->GetNumberOfMeshes() == 4 );
+            // Every vertex in the file belongs to one of the objects.
+            REQUIRE( points == 248 );
+        }
+    }
+
+    GIVEN( "the closed mesh in the file 'sphere.ply'" ) {
+        auto reader = BuiltIn();
+        reader->Read("../meshes/sphere.ply");
+
+        auto mesh = reader->GetMesh();
+
+        THEN( "each point is shared by the facets around it" ) {
+            // A closed mesh with no holes has two more points than half its facets.
+            REQUIRE( mesh->GetNumberOfPoints() == mesh->GetNumberOfTriangles() / 2 + 2 );
+            REQUIRE( mesh->GetIndices().size() == 3 * mesh->GetNumberOfTriangles() );
+        }
+
+        THEN( "the same facets are built from the corners" ) {
+            // The new mesh deletes the facets.
+            auto rebuilt = CADMesh::Mesh::New(mesh->GetTriangles());
+
+            REQUIRE( rebuilt->GetNumberOfPoints() == mesh->GetNumberOfPoints() );
+            REQUIRE( rebuilt->GetNumberOfTriangles() == mesh->GetNumberOfTriangles() );
+
+            for (size_t i = 0; i < mesh->GetIndices().size(); i++)
+            {
+                REQUIRE( rebuilt->GetPoint(rebuilt->GetIndices()[i]) == mesh->GetPoint(mesh->GetIndices()[i]) );
+            }
+        }
+    }
+}
+
+
+SCENARIO( "Weld points that are near each other.") {
+
+    GIVEN( "the facets of 'sphere.ply' with every corner moved a little" ) {
+        auto reader = BuiltIn();
+        reader->Read("../meshes/sphere.ply");
+
+        auto mesh = reader->GetMesh();
+
+        CADMesh::Points corners;
+
+        for (size_t i = 0; i < mesh->GetIndices().size(); i++)
+        {
+            // Moves of up to 1e-6, different for each corner.
+            auto shift = ((i * 7919) % 1000) * 1e-9;
+            corners.push_back(mesh->GetPoint(mesh->GetIndices()[i]) + G4ThreeVector(shift, -shift, shift));
+        }
+
+        WHEN( "the corners are made into a mesh" ) {
+            auto moved = CADMesh::Mesh::FromCorners(corners);
+
+            THEN( "only corners at the same position are joined" ) {
+                REQUIRE( moved->GetNumberOfPoints() > mesh->GetNumberOfPoints() );
+            }
+
+            THEN( "welding with a tolerance gives back the shared points" ) {
+                moved->Weld(1e-5);
+
+                REQUIRE( moved->GetNumberOfPoints() == mesh->GetNumberOfPoints() );
+                REQUIRE( moved->IsValidForNavigation() );
+            }
+
+            THEN( "welding with a relative tolerance does the same" ) {
+                moved->Weld(1e-5, true);
+
+                REQUIRE( moved->GetNumberOfPoints() == mesh->GetNumberOfPoints() );
+            }
+
+            THEN( "the same points are welded with any number of threads" ) {
+                auto other = CADMesh::Mesh::New(moved);
+
+                moved->Weld(1e-5, false, 1);
+                other->Weld(1e-5, false, 7);
+
+                REQUIRE( moved->GetIndices() == other->GetIndices() );
+                REQUIRE( moved->GetPoints() == other->GetPoints() );
+            }
+        }
+    }
+
+    GIVEN( "a triangle beside a sliver whose short edge is within the tolerance" ) {
+        CADMesh::Points corners = {
+            G4ThreeVector(0, 0, 0), G4ThreeVector(1, 0, 0), G4ThreeVector(0, 1, 0),
+            G4ThreeVector(1, 0, 0), G4ThreeVector(1, 1e-7, 0), G4ThreeVector(0, 1, 0)
+        };
+
+        auto mesh = CADMesh::Mesh::FromCorners(corners);
+
+        WHEN( "welding it" ) {
+            mesh->Weld(1e-6);
+
+            THEN( "the sliver collapses and is dropped" ) {
+                REQUIRE( mesh->GetNumberOfPoints() == 3 );
+                REQUIRE( mesh->GetNumberOfTriangles() == 1 );
+                REQUIRE( mesh->GetIndices() == CADMesh::Indices({ 0, 1, 2 }) );
+            }
+        }
+    }
+}
@@ -0,0 +1,356 @@
+#define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "catch2/catch.hpp"
+
+// CADMesh //
+#include "CADMesh.hh"
+#include "Parallel.hh"
+
+#include "Simulator.hh"
+
+#include <algorithm>
+#include <random>
+
+
+// The corners of each triangle, starting from the lowest point so that the
+// way round is kept, sorted, to compare meshes numbered differently.
+std::vector<std::vector<G4double> > SortedTriangles(std::shared_ptr<CADMesh::Mesh> mesh)
+{
+    std::vector<std::vector<G4double> > triangles;
+
+    auto& indices = mesh->GetIndices();
+
+    for (size_t t = 0; t < indices.size(); t += 3)
+    {
+        std::vector<G4ThreeVector> corners;
+
+        for (size_t corner = 0; corner < 3; corner++)
+            corners.push_back(mesh->GetPoint(indices[t + corner]));
+
+        auto lowest = std::min_element(corners.begin(), corners.end(), [](const G4ThreeVector& a, const G4ThreeVector& b)
+        {
+            return a.x() < b.x() || (a.x() == b.x() && (a.y() < b.y() || (a.y() == b.y() && a.z() < b.z())));
+        });
+
+        std::rotate(corners.begin(), lowest, corners.end());
+
+        std::vector<G4double> triangle;
+
+        for (auto& corner : corners)
+            triangle.insert(triangle.end(), { corner.x(), corner.y(), corner.z() });
+
+        triangles.push_back(triangle);
+    }
+
+    std::sort(triangles.begin(), triangles.end());
+
+    return triangles;
+}
+
+
+// How far apart the centres of consecutive triangles are, on average.
+G4double MeanStep(std::shared_ptr<CADMesh::Mesh> mesh)
+{
+    auto& indices = mesh->GetIndices();
+
+    auto centre = [&](size_t t)
+    {
+        return ( mesh->GetPoint(indices[3 * t])
+               + mesh->GetPoint(indices[3 * t + 1])
+               + mesh->GetPoint(indices[3 * t + 2])) / 3;
+    };
+
+    G4double total = 0;
+
+    for (size_t t = 1; t < mesh->GetNumberOfTriangles(); t++)
+        total += (centre(t) - centre(t - 1)).mag();
+
+    return total / (mesh->GetNumberOfTriangles() - 1);
+}
+
+
+// A torus of 2 sides squared facets, numbered in no order, as some
+// exporters write them.
+std::shared_ptr<CADMesh::Mesh> ShuffledTorus(uint32_t sides)
+{
+    CADMesh::Points points;
+    CADMesh::Indices indices;
+
+    for (uint32_t i = 0; i < sides; i++)
+    {
+        for (uint32_t j = 0; j < sides; j++)
+        {
+            auto u = 2 * M_PI * i / sides;
+            auto v = 2 * M_PI * j / sides;
+
+            points.push_back(G4ThreeVector( (200 + 100 * std::cos(v)) * std::cos(u)
+                                          , (200 + 100 * std::cos(v)) * std::sin(u)
+                                          , 100 * std::sin(v)));
+        }
+    }
+
+    std::vector<uint32_t> order(2 * sides * sides);
+
+    for (size_t t = 0; t < order.size(); t++)
+        order[t] = t;
+
+    std::shuffle(order.begin(), order.end(), std::mt19937(42));
+
+    for (auto t : order)
+    {
+        uint32_t i = t / 2 / sides;
+        uint32_t j = t / 2 % sides;
+
+        uint32_t a = i * sides + j;
+        uint32_t b = ((i + 1) % sides) * sides + j;
+        uint32_t c = ((i + 1) % sides) * sides + (j + 1) % sides;
+        uint32_t d = i * sides + (j + 1) % sides;
+
+        if (t % 2 == 0)
+            indices.insert(indices.end(), { a, b, c });
+
+        else
+            indices.insert(indices.end(), { a, c, d });
+    }
+
+    return CADMesh::Mesh::New(points, indices, "torus");
+}
+
+
+// A solid with the facets of a mesh added in its order, and closed, which
+// is when Geant4 voxelises it.
+G4TessellatedSolid* Voxelise(std::shared_ptr<CADMesh::Mesh> mesh)
+{
+    auto solid = new G4TessellatedSolid(mesh->GetName());
+
+    for (auto triangle : mesh->GetTriangles())
+        solid->AddFacet(triangle);
+
+    solid->SetSolidClosed(true);
+
+    return solid;
+}
+
+
+// Times building and navigating a solid of the mesh in its own order and
+// reordered, at the same points and directions.
+void Benchmark(std::shared_ptr<CADMesh::Mesh> mesh, size_t number_of_points)
+{
+    auto reordered = CADMesh::Mesh::New(mesh);
+    reordered->Reorder();
+
+    auto x = std::minmax_element(mesh->GetX().begin(), mesh->GetX().end());
+    auto y = std::minmax_element(mesh->GetY().begin(), mesh->GetY().end());
+    auto z = std::minmax_element(mesh->GetZ().begin(), mesh->GetZ().end());
+
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<G4double> uniform(0, 1);
+    std::normal_distribution<G4double> normal;
+
+    std::vector<G4ThreeVector> points;
+    std::vector<G4ThreeVector> directions;
+
+    for (size_t i = 0; i < number_of_points; i++)
+    {
+        points.push_back(G4ThreeVector( *x.first + (*x.second - *x.first) * uniform(generator)
+                                      , *y.first + (*y.second - *y.first) * uniform(generator)
+                                      , *z.first + (*z.second - *z.first) * uniform(generator)));
+
+        directions.push_back(G4ThreeVector( normal(generator)
+                                          , normal(generator)
+                                          , normal(generator)).unit());
+    }
+
+    BENCHMARK( "voxelise, in file order" ) {
+        auto solid = Voxelise(mesh);
+        auto facets = solid->GetNumberOfFacets();
+        delete solid;
+        return facets;
+    };
+
+    BENCHMARK( "voxelise, reordered" ) {
+        auto solid = Voxelise(reordered);
+        auto facets = solid->GetNumberOfFacets();
+        delete solid;
+        return facets;
+    };
+
+    for (auto order : { mesh, reordered })
+    {
+        auto solid = Voxelise(order);
+        auto name = std::string(order == mesh ? ", in file order" : ", reordered");
+
+        // Only points outside can be moved in from.
+        std::vector<size_t> outside;
+
+        for (size_t i = 0; i < points.size(); i++)
+        {
+            if (solid->Inside(points[i]) == kOutside)
+                outside.push_back(i);
+        }
+
+        BENCHMARK( "Inside" + name ) {
+            size_t inside = 0;
+
+            for (auto& point : points)
+                inside += solid->Inside(point) == kInside;
+
+            return inside;
+        };
+
+        BENCHMARK( "DistanceToIn" + name ) {
+            G4double total = 0;
+
+            for (auto i : outside)
+            {
+                auto distance = solid->DistanceToIn(points[i], directions[i]);
+
+                if (distance != kInfinity)
+                    total += distance;
+            }
+
+            return total;
+        };
+
+        delete solid;
+    }
+}
+
+
+SCENARIO( "Sort keys with a radix sort.") {
+
+    GIVEN( "keys with many repeated and some bytes all the same" ) {
+        std::mt19937_64 generator(42);
+
+        std::vector<uint64_t> keys(100000);
+        std::vector<uint32_t> values(keys.size());
+
+        for (size_t i = 0; i < keys.size(); i++)
+        {
+            keys[i] = (generator() % 1000) << 24 | 0xab;
+            values[i] = i;
+        }
+
+        std::vector<std::pair<uint64_t, uint32_t> > expected;
+
+        for (size_t i = 0; i < keys.size(); i++)
+            expected.push_back({ keys[i], values[i] });
+
+        std::stable_sort(expected.begin(), expected.end(), [](const std::pair<uint64_t, uint32_t>& a, const std::pair<uint64_t, uint32_t>& b)
+        {
+            return a.first < b.first;
+        });
+
+        for (size_t threads : { 1, 3, 8 })
+        {
+            WHEN( "sorting them on " + std::to_string(threads) + " threads" ) {
+                auto sorted_keys = keys;
+                auto sorted_values = values;
+
+                CADMesh::ParallelRadixSort(sorted_keys, sorted_values, threads);
+
+                THEN( "they are in order, and equal keys keep their order" ) {
+                    for (size_t i = 0; i < expected.size(); i++)
+                    {
+                        REQUIRE( sorted_keys[i] == expected[i].first );
+                        REQUIRE( sorted_values[i] == expected[i].second );
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+SCENARIO( "Reorder the facets of a mesh.") {
+
+    GIVEN( "the bunny in 'bunny.stl'" ) {
+        auto reader = CADMesh::File::BuiltIn();
+        reader->Read("../meshes/bunny.stl");
+
+        auto original = reader->GetMesh();
+
+        WHEN( "reordering it" ) {
+            auto mesh = CADMesh::Mesh::New(original);
+            mesh->Reorder();
+
+            THEN( "it has the same triangles, the same way round" ) {
+                REQUIRE( mesh->GetNumberOfPoints() == original->GetNumberOfPoints() );
+                REQUIRE( SortedTriangles(mesh) == SortedTriangles(original) );
+                REQUIRE( mesh->Validate().IsValid() );
+            }
+
+            THEN( "the points are numbered in the order the triangles use them" ) {
+                uint32_t next = 0;
+
+                for (auto index : mesh->GetIndices())
+                {
+                    REQUIRE( index <= next );
+
+                    if (index == next)
+                        next++;
+                }
+            }
+
+            THEN( "triangles next to each other are nearer in space" ) {
+                REQUIRE( MeanStep(mesh) < MeanStep(original) / 2 );
+            }
+
+            THEN( "the order is the same on any number of threads" ) {
+                auto other = CADMesh::Mesh::New(original);
+                other->Reorder(5);
+
+                REQUIRE( other->GetIndices() == mesh->GetIndices() );
+                REQUIRE( other->GetX() == mesh->GetX() );
+            }
+        }
+    }
+
+    GIVEN( "the bunny in 'bunny.stl' as a tessellated mesh" ) {
+        auto mesh = CADMesh::TessellatedMesh::FromSTL("../meshes/bunny.stl");
+        auto solid = mesh->GetSolid();
+
+        WHEN( "reordering it" ) {
+            mesh->Reorder();
+
+            THEN( "a new solid is built" ) {
+                REQUIRE( mesh->GetSolid() != solid );
+            }
+
+            THEN( "the geometry should be navigable by the Geant4 kernel" ) {
+                REQUIRE_NOTHROW( Simulator(mesh->GetSolid()) );
+            }
+        }
+    }
+}
+
+
+SCENARIO( "Compare voxelising and navigating reordered facets.") {
+
+    GIVEN( "the bunny in 'bunny.stl'" ) {
+        auto reader = CADMesh::File::BuiltIn();
+        reader->Read("../meshes/bunny.stl");
+
+        Benchmark(reader->GetMesh(), 10000);
+    }
+}
+
+
+// Slow, so only run when asked for, with fewer samples:
+//     ReorderTests "[benchmark]" --benchmark-samples 5
+SCENARIO( "Compare voxelising and navigating a large mesh reordered.", "[.][benchmark]") {
+
+    GIVEN( "a torus of five million facets in no order" ) {
+        auto mesh = ShuffledTorus(1582);
+
+        REQUIRE( mesh->GetNumberOfTriangles() > 5000000 );
+
+        BENCHMARK( "reorder" ) {
+            auto reordered = CADMesh::Mesh::New(mesh);
+            reordered->Reorder();
+            return reordered;
+        };
+
+        Benchmark(mesh, 100000);
+    }
+}
@@ -23,10 +23,10 @@
 class DetectorConstruction : public G4VUserDetectorConstruction
 {
   private:
-      G4TessellatedSolid* solid_;
+      G4VSolid* solid_;
 
   public:
-    DetectorConstruction(G4TessellatedSolid* solid) : solid_(solid)
+    DetectorConstruction(G4VSolid* solid) : solid_(solid)
     {
     };
 
@@ -36,9 +36,13 @@ class DetectorConstruction : public G4VUserDetectorConstruction
         G4Material * air = nist_manager->FindOrBuildMaterial("G4_AIR");
         G4Material * water = nist_manager->FindOrBuildMaterial("G4_WATER");
 
-        double x = solid_->GetMaxXExtent() - solid_->GetMinXExtent();
-        double y = solid_->GetMaxYExtent() - solid_->GetMinYExtent();
-        double z = solid_->GetMaxZExtent() - solid_->GetMinZExtent();
+        G4ThreeVector minimum;
+        G4ThreeVector maximum;
+        solid_->BoundingLimits(minimum, maximum);
+
+        double x = maximum.x() - minimum.x();
+        double y = maximum.y() - minimum.y();
+        double z = maximum.z() - minimum.z();
 
         // Set world half lengths to the extent of the test solid.
         auto world_solid = new G4Box("world_solid", x, y, z);
@@ -124,7 +128,7 @@ class ExceptionHandler : public G4VExceptionHandler
 class Simulator
 {
   public:
-    Simulator(G4TessellatedSolid* solid, bool vis = false, bool cli = false)
+    Simulator(G4VSolid* solid, bool vis = false, bool cli = false)
     {
         auto run_manager = new G4RunManager();
 
@@ -156,17 +160,21 @@ class Simulator
         session->ApplyCommand("/gps/pos/confine world_physical");
         session->ApplyCommand("/gps/ang/type iso");
  
-        double x = solid->GetMaxXExtent() - solid->GetMinXExtent();
+        G4ThreeVector minimum;
+        G4ThreeVector maximum;
+        solid->BoundingLimits(minimum, maximum);
+
+        double x = maximum.x() - minimum.x();
         std::stringstream command_x;
         command_x << "/gps/pos/halfx " << x << " mm"; 
         session->ApplyCommand(command_x.str());
  
-        double y = solid->GetMaxYExtent() - solid->GetMinYExtent();
+        double y = maximum.y() - minimum.y();
         std::stringstream command_y;
         command_y << "/gps/pos/halfy " << y << " mm"; 
         session->ApplyCommand(command_y.str());
 
-        double z = solid->GetMaxZExtent() - solid->GetMinZExtent();
+        double z = maximum.z() - minimum.z();
         std::stringstream command_z;
         command_z << "/gps/pos/halfz " << z << " mm"; 
         session->ApplyCommand(command_z.str());
@@ -0,0 +1,168 @@
+#define CATCH_CONFIG_MAIN 
+#include "catch2/catch.hpp"
+
+#include "CADMesh.hh"
+#include "StructuralIndex.hh"
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+
+using namespace CADMesh::File;
+
+static std::string Contents(std::string filepath)
+{
+    std::ifstream file(filepath);
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+
+    return buffer.str();
+}
+
+
+static std::vector<StructuralIndex::Kernel> SupportedKernels()
+{
+    std::vector<StructuralIndex::Kernel> kernels;
+
+    for (auto kernel : { StructuralIndex::Scalar
+                       , StructuralIndex::SSE2
+                       , StructuralIndex::AVX2 })
+    {
+        if (StructuralIndex::IsSupported(kernel))
+            kernels.push_back(kernel);
+    }
+
+    return kernels;
+}
+
+
+// Each kernel agrees with a byte at a time walk of the text.
+static bool MatchesBytes(const std::string& text, StructuralIndex::Kernel kernel)
+{
+    StructuralIndex index(text.data(), text.size(), kernel);
+
+    for (size_t i = 0; i < text.size(); i++)
+    {
+        auto c = text[i];
+
+        bool line_break = (index.LineBreaks()[i / 64] >> (i % 64)) & 1;
+        bool white_space = (index.WhiteSpace()[i / 64] >> (i % 64)) & 1;
+
+        if (line_break != (c == '\n'))
+            return false;
+
+        if (white_space != (c == ' ' || c == '\t' || c == '\r'))
+            return false;
+    }
+
+    return true;
+}
+
+
+static const char* meshes[] = { "../meshes/bunny.stl"
+                              , "../meshes/box_solidworks.stl"
+                              , "../meshes/box_solidworks_binary.stl"
+                              , "../meshes/cow.obj"
+                              , "../meshes/shapes.obj"
+                              , "../meshes/sphere.ply"
+                              , "../meshes/sphere_binary.ply" };
+
+
+SCENARIO( "Index the white space and line breaks of a file.") {
+
+    GIVEN( "the example meshes" ) {
+        THEN( "every supported kernel gives the same bitmaps" ) {
+            for (auto filepath : meshes)
+            {
+                auto text = Contents(filepath);
+
+                for (auto kernel : SupportedKernels())
+                {
+                    INFO( filepath << " " << StructuralIndex::KernelName(kernel) );
+                    REQUIRE( MatchesBytes(text, kernel) );
+                }
+            }
+        }
+    }
+
+    GIVEN( "random bytes of every length up to a few blocks" ) {
+        std::mt19937 random(42);
+        std::uniform_int_distribution<int> pick(0, 7);
+
+        const char alphabet[] = { ' ', '\t', '\r', '\n', 'a', '1', '\0', '\x80' };
+
+        THEN( "every supported kernel gives the same bitmaps" ) {
+            for (size_t length = 0; length < 300; length++)
+            {
+                std::string text;
+
+                for (size_t i = 0; i < length; i++)
+                    text += alphabet[pick(random)];
+
+                for (auto kernel : SupportedKernels())
+                {
+                    INFO( length << " " << StructuralIndex::KernelName(kernel) );
+                    REQUIRE( MatchesBytes(text, kernel) );
+                }
+            }
+        }
+    }
+
+    GIVEN( "some text with long runs of blank space" ) {
+        std::string text = "solid" + std::string(100, ' ') + "\r\n\n\t\t" + std::string(70, ' ') + "x\n";
+        StructuralIndex index(text.data(), text.size());
+
+        THEN( "positions are found across word boundaries" ) {
+            REQUIRE( index.NextNonWhiteSpace(0) == 0 );
+            REQUIRE( index.NextNonWhiteSpace(5) == 106 );
+            REQUIRE( index.NextNonBlank(5) == text.size() - 2 );
+            REQUIRE( index.NextLineBreak(0) == 106 );
+            REQUIRE( index.NextLineBreak(107) == 107 );
+            REQUIRE( index.NextLineBreak(108) == text.size() - 1 );
+        }
+
+        THEN( "searches past the end stop at the size" ) {
+            REQUIRE( index.NextLineBreak(text.size()) == text.size() );
+            REQUIRE( index.NextNonBlank(text.size() - 1) == text.size() );
+        }
+    }
+}
+
+
+SCENARIO( "Measure the throughput of each kernel.") {
+
+    GIVEN( "the example meshes" ) {
+        std::string text;
+
+        for (auto filepath : meshes)
+            text += Contents(filepath);
+
+        THEN( "each kernel indexes them" ) {
+            for (auto kernel : SupportedKernels())
+            {
+                size_t repeats = 20;
+                size_t words = 0;
+
+                auto start = std::chrono::steady_clock::now();
+
+                for (size_t i = 0; i < repeats; i++)
+                {
+                    StructuralIndex index(text.data(), text.size(), kernel);
+                    words += index.LineBreaks().size();
+                }
+
+                std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+
+                std::cout << std::setw(8) << StructuralIndex::KernelName(kernel) << ": "
+                          << std::fixed << std::setprecision(2)
+                          << repeats * text.size() / seconds.count() / 1e9 << " GB/s" << std::endl;
+
+                REQUIRE( words == repeats * ((text.size() + 63) / 64) );
+            }
+        }
+    }
+}
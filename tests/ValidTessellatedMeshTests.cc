@@ -6,6 +6,10 @@
 
 #include "Simulator.hh"
 
+#include <algorithm>
+#include <set>
+#include <thread>
+
 SCENARIO( "Load a PLY file as a tessellated mesh.") {
 
     GIVEN( "the sphere in the file 'sphere.ply'" ) {
@@ -68,6 +72,42 @@ SCENARIO( "Load a PLY file as a tessellated mesh.") {
         }
     }
 
+    GIVEN( "the sphere in the little endian binary file 'sphere_binary.ply'" ) {
+        auto mesh = CADMesh::TessellatedMesh::FromPLY("../meshes/sphere_binary.ply");
+
+        WHEN( "constructing the solid volume" ) {
+            auto solid = (G4TessellatedSolid*) mesh->GetSolid();
+
+            THEN( "CADMesh should report that the volume is navigable" ) {
+                REQUIRE( mesh->IsValidForNavigation() );
+            }
+
+            THEN( "the number of facets should equal that in the file" ) {
+                REQUIRE( solid->GetNumberOfFacets() == 1280 );
+            }
+
+            THEN( "the point (0, 0, 0) is inside the volume" ) {
+                REQUIRE( solid->Inside(G4ThreeVector(0, 0, 0)) == kInside );
+            }
+        }
+    }
+
+    GIVEN( "the box in the big endian binary file 'box_solidworks_binary.ply'" ) {
+        auto mesh = CADMesh::TessellatedMesh::FromPLY("../meshes/box_solidworks_binary.ply");
+
+        WHEN( "constructing the solid volume" ) {
+            auto solid = (G4TessellatedSolid*) mesh->GetSolid();
+
+            THEN( "CADMesh should report that the volume is navigable" ) {
+                REQUIRE( mesh->IsValidForNavigation() );
+            }
+
+            THEN( "the number of facets should equal that in the file" ) {
+                REQUIRE( solid->GetNumberOfFacets() == 12 );
+            }
+        }
+    }
+
     GIVEN( "the box in the file 'box_solidworks.ply'" ) {
         auto mesh = CADMesh::TessellatedMesh::FromPLY("../meshes/box_solidworks.ply");
 
@@ -92,5 +132,421 @@ SCENARIO( "Load a PLY file as a tessellated mesh.") {
         }
     }
 
+    GIVEN( "the box in the binary file 'box_solidworks_binary.stl'" ) {
+        auto mesh = CADMesh::TessellatedMesh::FromSTL("../meshes/box_solidworks_binary.stl");
+
+        WHEN( "constructing the solid volume" ) {
+            auto solid = (G4TessellatedSolid*) mesh->GetSolid();
+
+            THEN( "CADMesh should report that the volume is navigable" ) {
+                REQUIRE( mesh->IsValidForNavigation() );
+            }
+
+            THEN( "the number of facets should equal that in the file" ) {
+                REQUIRE( solid->GetNumberOfFacets() == 12 );
+            }
+        }
+    }
+
+}
+
+
+
+SCENARIO( "Build each facet of a solid once.") {
+
+    GIVEN( "the sphere in the file 'sphere.ply'" ) {
+        auto reader = CADMesh::File::BuiltIn();
+        auto mesh = CADMesh::TessellatedMesh::FromPLY("../meshes/sphere.ply", reader);
+
+        WHEN( "constructing the solid volume turned inside out" ) {
+            auto solid = (G4TessellatedSolid*) mesh->GetSolid();
+
+            mesh->SetReverse(true);
+            auto reversed = (G4TessellatedSolid*) mesh->GetSolid();
+
+            THEN( "every facet faces the other way" ) {
+                REQUIRE( reversed->GetNumberOfFacets() == solid->GetNumberOfFacets() );
+
+                for (G4int i = 0; i < solid->GetNumberOfFacets(); i++)
+                {
+                    auto normal = solid->GetFacet(i)->GetSurfaceNormal();
+                    auto flipped = reversed->GetFacet(i)->GetSurfaceNormal();
+
+                    REQUIRE( (normal + flipped).mag() < 1e-12 );
+                }
+            }
+        }
+
+        WHEN( "releasing the meshes once their solids are built" ) {
+            mesh->SetReleaseMeshes(true);
+            auto solid = (G4TessellatedSolid*) mesh->GetSolid();
+
+            THEN( "the solid has every facet" ) {
+                REQUIRE( solid->GetNumberOfFacets() == 1280 );
+            }
+
+            THEN( "the mesh read is emptied" ) {
+                REQUIRE( reader->GetMesh()->IsReleased() );
+                REQUIRE( reader->GetMesh()->GetNumberOfTriangles() == 0 );
+                REQUIRE( reader->GetMesh()->GetNumberOfPoints() == 0 );
+            }
+        }
+    }
+}
+
+
+SCENARIO( "Merge coplanar facets.") {
+
+    GIVEN( "the box in the file 'box_solidworks.stl'" ) {
+        auto mesh = CADMesh::TessellatedMesh::FromSTL("../meshes/box_solidworks.stl");
+        auto solid = (G4TessellatedSolid*) mesh->GetSolid();
+
+        WHEN( "constructing the solid volume with a coplanar tolerance" ) {
+            mesh->SetCoplanarTolerance(1e-6);
+            auto merged = (G4TessellatedSolid*) mesh->GetSolid();
+
+            THEN( "each side is a single quadrangle" ) {
+                REQUIRE( merged != solid );
+                REQUIRE( merged->GetNumberOfFacets() == 6 );
+
+                for (G4int i = 0; i < merged->GetNumberOfFacets(); i++)
+                {
+                    REQUIRE( merged->GetFacet(i)->GetNumberOfVertices() == 4 );
+                }
+            }
+
+            THEN( "the surface area is the same" ) {
+                G4double area = 0;
+                G4double merged_area = 0;
+
+                for (G4int i = 0; i < solid->GetNumberOfFacets(); i++)
+                    area += solid->GetFacet(i)->GetArea();
+
+                for (G4int i = 0; i < merged->GetNumberOfFacets(); i++)
+                    merged_area += merged->GetFacet(i)->GetArea();
+
+                REQUIRE( merged_area == Approx(area) );
+            }
+
+            THEN( "the geometry should be navigable by the Geant4 kernel" ) {
+                REQUIRE_NOTHROW( Simulator(merged) );
+            }
+        }
+    }
+
+    GIVEN( "the sphere in the file 'sphere.ply'" ) {
+        auto mesh = CADMesh::TessellatedMesh::FromPLY("../meshes/sphere.ply");
+
+        WHEN( "constructing the solid volume with a coplanar tolerance" ) {
+            mesh->SetCoplanarTolerance(1e-6);
+            auto solid = (G4TessellatedSolid*) mesh->GetSolid();
+
+            THEN( "no facets are merged, as none are coplanar" ) {
+                REQUIRE( solid->GetNumberOfFacets() == 1280 );
+            }
+        }
+    }
+
+    GIVEN( "a square cut into a grid of triangles" ) {
+        CADMesh::Points points;
+        CADMesh::Indices indices;
+
+        for (uint32_t i = 0; i <= 4; i++)
+            for (uint32_t j = 0; j <= 4; j++)
+                points.push_back(G4ThreeVector(i, j, 0));
+
+        for (uint32_t i = 0; i < 4; i++)
+        {
+            for (uint32_t j = 0; j < 4; j++)
+            {
+                uint32_t a = 5 * i + j;
+
+                indices.insert(indices.end(), { a, a + 5, a + 6 });
+                indices.insert(indices.end(), { a, a + 6, a + 1 });
+            }
+        }
+
+        WHEN( "merging its coplanar triangles" ) {
+            CADMesh::CoplanarMerge merge(points, indices, 1e-6, 2);
+
+            THEN( "the points inside the square are removed" ) {
+                REQUIRE( merge.GetNumberOfFacetsBefore() == 32 );
+                REQUIRE( merge.GetNumberOfPointsRemoved() == 9 );
+            }
+
+            THEN( "the points on its boundary are all kept" ) {
+                std::set<uint32_t> used( merge.GetTriangles().begin()
+                                       , merge.GetTriangles().end());
+
+                used.insert(merge.GetQuadrangles().begin(), merge.GetQuadrangles().end());
+
+                REQUIRE( used.size() == 16 );
+            }
+
+            THEN( "fewer facets cover the same area" ) {
+                auto& triangles = merge.GetTriangles();
+                auto& quadrangles = merge.GetQuadrangles();
+
+                G4double area = 0;
+
+                for (size_t t = 0; t < triangles.size(); t += 3)
+                {
+                    auto& a = points[triangles[t]];
+                    auto& b = points[triangles[t + 1]];
+                    auto& c = points[triangles[t + 2]];
+
+                    REQUIRE( (b - a).cross(c - a).z() > 0 );
+                    area += (b - a).cross(c - a).z() / 2;
+                }
+
+                for (size_t q = 0; q < quadrangles.size(); q += 4)
+                {
+                    auto& a = points[quadrangles[q]];
+                    auto& b = points[quadrangles[q + 1]];
+                    auto& c = points[quadrangles[q + 2]];
+                    auto& d = points[quadrangles[q + 3]];
+
+                    REQUIRE( (c - a).cross(d - b).z() > 0 );
+                    area += (c - a).cross(d - b).z() / 2;
+                }
+
+                REQUIRE( merge.GetNumberOfFacets() < 16 );
+                REQUIRE( area == Approx(16) );
+            }
+        }
+
+        WHEN( "merging with the middle point lifted out of the plane" ) {
+            points[12] += G4ThreeVector(0, 0, 0.1);
+
+            CADMesh::CoplanarMerge merge(points, indices, 1e-6, 2);
+
+            THEN( "it and the points next to it are kept" ) {
+                auto& triangles = merge.GetTriangles();
+
+                for (uint32_t point : { 7, 11, 12, 13, 17 })
+                {
+                    REQUIRE( std::count(triangles.begin(), triangles.end(), point) > 0 );
+                }
+
+                REQUIRE( merge.GetNumberOfPointsRemoved() < 9 );
+            }
+        }
+    }
+}
+
+
+SCENARIO( "Decimate a mesh.") {
+
+    GIVEN( "the bunny in the file 'bunny.stl'" ) {
+        auto mesh = CADMesh::TessellatedMesh::FromSTL("../meshes/bunny.stl");
+        auto original = mesh->GetBVHSolid();
+
+        WHEN( "decimating it to a third of its triangles" ) {
+            auto hausdorff_distance = mesh->Decimate(1000);
+            auto solid = mesh->GetBVHSolid();
+
+            THEN( "it has that many triangles" ) {
+                REQUIRE( solid != original );
+                REQUIRE( solid->GetHierarchy()->GetNumberOfTriangles() <= 1000 );
+                REQUIRE( solid->GetHierarchy()->GetNumberOfTriangles() > 900 );
+            }
+
+            THEN( "it is still closed and valid for navigation" ) {
+                REQUIRE( mesh->IsValidForNavigation() );
+            }
+
+            THEN( "no point of the surface moved further than reported" ) {
+                REQUIRE( hausdorff_distance > 0 );
+
+                for (size_t i = 0; i < 1000; i++)
+                {
+                    auto p = original->GetPointOnSurface();
+                    auto distance = std::min(solid->DistanceToIn(p), solid->DistanceToOut(p));
+
+                    REQUIRE( distance <= hausdorff_distance );
+
+                    auto q = solid->GetPointOnSurface();
+                    distance = std::min(original->DistanceToIn(q), original->DistanceToOut(q));
+
+                    REQUIRE( distance <= hausdorff_distance );
+                }
+            }
+        }
+
+        WHEN( "decimating it with a maximum deviation" ) {
+            auto hausdorff_distance = mesh->Decimate(0, 2);
+            auto solid = mesh->GetBVHSolid();
+
+            THEN( "the surface moved no further than that" ) {
+                REQUIRE( hausdorff_distance <= 2 );
+                REQUIRE( solid->GetHierarchy()->GetNumberOfTriangles() < 3000 );
+                REQUIRE( mesh->IsValidForNavigation() );
+            }
+        }
+
+        WHEN( "decimating it at a larger scale" ) {
+            mesh->SetScale(10);
+            auto hausdorff_distance = mesh->Decimate(0, 20);
+
+            THEN( "the maximum deviation is at that scale" ) {
+                REQUIRE( hausdorff_distance <= 20 );
+                REQUIRE( hausdorff_distance > 2 );
+            }
+        }
+    }
+
+    GIVEN( "the sphere in the file 'sphere.ply'" ) {
+        auto mesh = CADMesh::TessellatedMesh::FromPLY("../meshes/sphere.ply");
+
+        WHEN( "decimating it to very few triangles" ) {
+            mesh->Decimate(20);
+
+            THEN( "it is still closed and valid for navigation" ) {
+                REQUIRE( mesh->IsValidForNavigation() );
+                REQUIRE( mesh->GetTessellatedSolid()->GetNumberOfFacets() <= 20 );
+            }
+
+            THEN( "the geometry should be navigable by the Geant4 kernel" ) {
+                REQUIRE_NOTHROW( Simulator(mesh->GetSolid()) );
+            }
+        }
+
+        WHEN( "decimating it after its meshes are released" ) {
+            mesh->SetReleaseMeshes(true);
+            auto solid = mesh->GetSolid();
+
+            THEN( "there is nothing to decimate, and the solid is kept" ) {
+                REQUIRE( mesh->Decimate(20) == 0 );
+                REQUIRE( mesh->Decimate(0, 2) == 0 );
+                REQUIRE( mesh->GetSolid() == solid );
+            }
+        }
+    }
+}
+
+
+SCENARIO( "Reuse solids already built.") {
+
+    GIVEN( "the meshes in the file 'shapes.obj'" ) {
+        auto mesh = CADMesh::TessellatedMesh::FromOBJ("../meshes/shapes.obj");
+
+        auto solid = mesh->GetSolid(0);
+
+        WHEN( "asking for the same solid again" ) {
+            THEN( "the same solid is handed out" ) {
+                REQUIRE( mesh->GetSolid(0) == solid );
+                REQUIRE( mesh->GetSolids()[0] == solid );
+            }
+        }
+
+        WHEN( "changing the scale, offset or reverse" ) {
+            THEN( "a new solid is built" ) {
+                mesh->SetScale(2.0);
+                auto scaled = mesh->GetSolid(0);
+                REQUIRE( scaled != solid );
+
+                mesh->SetOffset(1.0, 0, 0);
+                auto moved = mesh->GetSolid(0);
+                REQUIRE( moved != scaled );
+
+                mesh->SetReverse(true);
+                REQUIRE( mesh->GetSolid(0) != moved );
+            }
+        }
+
+        WHEN( "setting the same scale again" ) {
+            mesh->SetScale(1.0);
+
+            THEN( "the solid is kept" ) {
+                REQUIRE( mesh->GetSolid(0) == solid );
+            }
+        }
+
+        WHEN( "asking for every solid from several threads at once" ) {
+            mesh->SetScale(3.0);
+
+            std::vector<std::vector<G4VSolid*> > solids(4);
+            std::vector<std::thread> threads;
+
+            for (size_t t = 0; t < solids.size(); t++)
+                threads.emplace_back([&, t]() { solids[t] = mesh->GetSolids(); });
+
+            for (auto& thread : threads)
+                thread.join();
+
+            THEN( "each solid is built once" ) {
+                for (auto& other : solids)
+                    REQUIRE( other == solids[0] );
+            }
+        }
+    }
+}
+
+
+SCENARIO( "Rebuild solids when their mesh is changed directly.") {
+
+    GIVEN( "the meshes in the file 'shapes.obj', read by a reader we keep" ) {
+        auto reader = CADMesh::File::BuiltIn();
+        auto mesh = CADMesh::TessellatedMesh::FromOBJ("../meshes/shapes.obj", reader);
+
+        auto solid = mesh->GetSolid(0);
+
+        WHEN( "reordering the mesh itself, not through the tessellated mesh" ) {
+            reader->GetMesh(0)->Reorder();
+
+            THEN( "a new solid is built" ) {
+                REQUIRE( mesh->GetSolid(0) != solid );
+            }
+        }
+
+        WHEN( "welding the mesh itself" ) {
+            reader->GetMesh(0)->Weld(0);
+
+            THEN( "a new solid is built" ) {
+                REQUIRE( mesh->GetSolid(0) != solid );
+            }
+        }
+    }
 }
 
+
+SCENARIO( "Build solids on several threads.") {
+
+    GIVEN( "the meshes in the file 'shapes.obj'" ) {
+        auto serial = CADMesh::TessellatedMesh::FromOBJ("../meshes/shapes.obj");
+        auto parallel = CADMesh::TessellatedMesh::FromOBJ("../meshes/shapes.obj");
+
+        parallel->SetNumberOfThreads(4);
+
+        WHEN( "getting every solid" ) {
+            auto expected = serial->GetSolids();
+            auto solids = parallel->GetSolids();
+
+            THEN( "the solids come back in the order of the meshes" ) {
+                REQUIRE( solids.size() == expected.size() );
+
+                for (size_t i = 0; i < solids.size(); i++)
+                {
+                    auto solid = (G4TessellatedSolid*) solids[i];
+                    auto other = (G4TessellatedSolid*) expected[i];
+
+                    REQUIRE( solid->GetName() == other->GetName() );
+                    REQUIRE( solid->GetNumberOfFacets() == other->GetNumberOfFacets() );
+                    REQUIRE( solid->GetSolidClosed() );
+
+                    for (G4int f = 0; f < solid->GetNumberOfFacets(); f++)
+                        REQUIRE( solid->GetFacet(f)->GetVertex(0) == other->GetFacet(f)->GetVertex(0) );
+                }
+            }
+        }
+
+        WHEN( "getting the assembly" ) {
+            auto assembly = parallel->GetAssembly();
+
+            THEN( "every mesh is placed" ) {
+                REQUIRE( assembly != nullptr );
+                REQUIRE( assembly->TotalTriplets() == parallel->GetSolids().size() );
+            }
+        }
+    }
+}